@@ -10,11 +10,11 @@
 #include "conf_common.h"
 
 #include "AES_crypto.h"
+#include "HashChainBuilder.h"
 
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
-#include <thread>
 #include <chrono>
 
 #include <cstring>
@@ -24,8 +24,10 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 
 #define MAX_MESSAGE_LENGTH  256
+#define RESPONSE_TIMEOUT_MS 3000    // time a node has to respond, the former tty read timeout
 
 /**
  * @brief Write buffer to file. In case of error, print error message and return false.
@@ -89,7 +91,17 @@ bool Configurator::generateuTESLAKeys(std::ifstream &random_file)
     random_file.read(reinterpret_cast<char*>(m_uTESLA_key), m_key_size);
     memcpy(tmp_hash, m_uTESLA_key, m_key_size);
 
-    // compute last hash chain value
+    // compute last hash chain value, the AES hash chain of 16-byte keys is computed by the specialized builder
+    if(m_key_size == AES_HASH_SIZE){
+        HashChainJob job = { m_uTESLA_key, (uint32_t) m_uTESLA_rounds, m_uTESLA_last_element, NULL, 0, NULL };
+        HashChainBuilder builder(1);
+        if(builder.build(&job, 1) != SUCCESS){
+            std::cerr << "Failed to compute hash" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     for(int i=1;i<m_uTESLA_rounds + 1;i++){
         if(!hash.hash(tmp_hash, m_key_size, m_uTESLA_last_element, MAX_KEY_SIZE)){
             std::cerr << "Failed to compute hash" << std::endl;
@@ -467,31 +479,114 @@ void set_blocking (int fd, int should_block)
     }
 }
 
-int openSerialPort(std::string path)
+/**
+ * @brief Convert baud rate to termios speed
+ * 
+ * @param baud_rate Baud rate
+ * @return speed_t  Speed or B0 if the baud rate is not supported
+ */
+static speed_t baudToSpeed(uint32_t baud_rate)
 {
+    switch(baud_rate){
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 500000:    return B500000;
+        case 921600:    return B921600;
+        case 1000000:   return B1000000;
+        case 2000000:   return B2000000;
+        default:        return B0;
+    }
+}
+
+int openSerialPort(std::string path, uint32_t baud_rate)
+{
+    speed_t speed = baudToSpeed(baud_rate);
+    if(speed == B0){
+        std::cerr << "Unsupported baud rate " << baud_rate << std::endl;
+        return -1;
+    }
+
     int serial_fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
     if (serial_fd < 0){
         std::cerr << "Failed to open serial port " << path << ", errno: " << errno << std::endl;
         return serial_fd;
     }
-    set_interface_attribs(serial_fd, B115200, 0);
+    set_interface_attribs(serial_fd, speed, 0);
     set_blocking(serial_fd, 0); // set not blocking
 
     return serial_fd;
 }
 
+/**
+ * @brief Wait until the node sends something
+ * 
+ * @param fd            Serial port of the node
+ * @param timeout_ms    Maximum time to wait
+ * @return true         Data are available
+ * @return false        Timeout or error
+ */
+static bool waitResponse(int fd, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN);
+}
+
+/**
+ * @brief Read the node's response until at least expected bytes arrive. The port does not block,
+ * so a single read() may return just the first bytes of the response.
+ * 
+ * @param fd            Serial port of the node
+ * @param buffer        Buffer for the response
+ * @param size          Size of the buffer
+ * @param expected      Minimum number of bytes of the response
+ * @param timeout_ms    Maximum time to wait for the whole response
+ * @return int          Number of bytes read (less than expected on timeout), -1 on error
+ */
+static int readResponse(int fd, uint8_t *buffer, int size, int expected, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int received = 0;
+
+    while(received < expected){
+        int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(remaining <= 0 || !waitResponse(fd, remaining)){
+            break;
+        }
+
+        int rval = read(fd, buffer + received, size - received);
+        if(rval < 0){
+            if(errno == EAGAIN || errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        if(rval == 0){  // hangup
+            break;
+        }
+        received += rval;
+    }
+
+    return received;
+}
+
 bool checkResponse(int fd)
 {
     uint8_t buffer[MAX_MESSAGE_LENGTH];
     int rval;
 
-    if((rval = read(fd, buffer, MAX_MESSAGE_LENGTH)) < 1){
-        // wait and try again
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-        if((rval = read(fd, buffer, MAX_MESSAGE_LENGTH)) < 1){
-            std::cerr << "Failed to receive response from the node" << std::endl;
-            return false;
-        }
+    // returns as soon as the node responds instead of sleeping for the worst case
+    if((rval = readResponse(fd, buffer, MAX_MESSAGE_LENGTH, 1, RESPONSE_TIMEOUT_MS)) < 1){
+        std::cerr << "Failed to receive response from the node" << std::endl;
+        return false;
     }
 
     if(rval != 1){
@@ -541,9 +636,8 @@ bool Configurator::requestKey(int fd, uint8_t node_id)
 
     write(fd, buffer, 4);
     tcdrain(fd);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-    int rsplen = read(fd, buffer, 32);
+    int rsplen = readResponse(fd, buffer, 32, 16, RESPONSE_TIMEOUT_MS);
     if(rsplen < 0){
         std::cerr << "Failed to read key" << std::endl;
         return false;
@@ -597,7 +691,6 @@ bool Configurator::uploadBuffer(int device_fd, uint8_t msg_type, const uint8_t *
     }
 
     tcdrain(device_fd);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
     if(!checkResponse(device_fd)){
         std::cerr << "Response failure when configuring node " << node.device << std::endl;
         close(device_fd);
@@ -614,7 +707,7 @@ bool Configurator::uploadSingle(const Node &node, int node_index)   // TODO remo
     std::cout << std::endl << "Configuring " << node.device << std::endl;
 #endif
 
-    int fd = openSerialPort(node.device);
+    int fd = openSerialPort(node.device, BAUD_RATE);
     if(fd < 0){
         std::cerr << "Failed to open serial port " << node.device << std::endl;
         return false;
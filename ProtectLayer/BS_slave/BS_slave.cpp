@@ -12,74 +12,136 @@
 
 #include "common.h"
 #include "ProtectLayerGlobals.h"
-
-#define BUFFER_SIZE 80
+#include "SerialLink.h"
 
 uint8_t node_id = BS_NODE_ID;
 uint8_t header = 0;
 
 uint8_t rcvd_len;
 uint8_t rcvd_hdr;
-uint8_t rcvd_buff[MAX_MSG_SIZE];
+uint8_t rcvd_buff[MAX_MSG_SIZE + 1];    // LINK_FRAME record - type followed by the frame
+
+// messages from the host waiting for the radio
+uint8_t queue_buff[SLAVE_QUEUE_LEN][MAX_MSG_SIZE];
+uint8_t queue_len[SLAVE_QUEUE_LEN];
+uint8_t queue_seq[SLAVE_QUEUE_LEN];
+uint8_t queue_head = 0;
+uint8_t queue_count = 0;
+
+LinkDecoder decoder;    // records from the host
 
 void setup()
 {
-    Serial.begin(BAUD_RATE);
+    Serial.begin(SLAVE_BAUD_RATE);
 
     header = createHeader(node_id, MODE_SRC, 0);
 
     rf12_initialize(node_id, RADIO_FREQ, RADIO_GROUP);
 }
 
+/**
+ * @brief Encode record and send it to the host
+ * 
+ * @param record    Record starting with its type
+ * @param len       Record length
+ */
+void sendRecord(const uint8_t *record, uint8_t len)
+{
+    uint8_t encoded[LINK_MAX_ENCODED];
+    uint8_t encoded_len = linkEncode(record, len, encoded);
 
-// TODO! "unicast" - only broadcast now
-void loop()
+    Serial.write(encoded, encoded_len);
+    Serial.flush();
+}
+
+/**
+ * @brief Send status of a message to the host
+ * 
+ * @param status    ERR_OK or error code
+ * @param seq       Sequence number of the message
+ */
+void replyStatus(uint8_t status, uint8_t seq)
 {
-    char buffer[BUFFER_SIZE];
-    if(Serial.available() > 0){
-        // read 1st length byte
-        uint8_t len1 = Serial.read();
-
-        // read 2nd length byte
-        while(Serial.available() < 1);
-        uint8_t len2 = Serial.read();
-
-        // compare length bytes
-        if(len1 != len2){
-            printError(ERR_MSG_SIZE);
-            return;
+    uint8_t record[3] = { LINK_STATUS, status, seq };
+
+    sendRecord(record, sizeof(record));
+}
+
+/**
+ * @brief Read available bytes from the host without blocking, complete messages are queued for the radio
+ * 
+ */
+void readHost()
+{
+    while(Serial.available() > 0){
+        // corrupted records are dropped by the decoder, the host times them out
+        if(!decoder.push(Serial.read())){
+            continue;
         }
 
-        // read data
-        while(Serial.available() < 1);
-        if(Serial.readBytes(buffer, len1) != len1){
-            printError(ERR_SERIAL_RD);
-            return;
+        uint8_t *record = decoder.record();
+        uint8_t len = decoder.recordLen();
+        if(record[0] != LINK_MSG || len < 3){
+            continue;
         }
 
-        // send
-        rf12_sendNow(header, buffer, len1);
+        // the host keeps at most SLAVE_QUEUE_LEN messages in flight, so a full queue is an error
+        if(queue_count >= SLAVE_QUEUE_LEN){
+            replyStatus(ERR_MSG_ADD, record[1]);
+            continue;
+        }
 
-        // ack
-        printError(ERR_OK);
+        uint8_t tail = (queue_head + queue_count) % SLAVE_QUEUE_LEN;
+        memcpy(queue_buff[tail], record + 2, len - 2);
+        queue_len[tail] = len - 2;
+        queue_seq[tail] = record[1];
+        queue_count++;
+    }
+}
+
+void loop()
+{
+    // read from host, but never wait for it
+    readHost();
+
+    // send the oldest message as soon as the radio is free and let the host send another one
+    if(queue_count && rf12_canSend()){
+        rf12_sendStart(header, queue_buff[queue_head], queue_len[queue_head]);
+        replyStatus(ERR_OK, queue_seq[queue_head]);
+
+        queue_head = (queue_head + 1) % SLAVE_QUEUE_LEN;
+        queue_count--;
     }
 
     // receive from radio
     if(rf12_recvDone() && !rf12_crc){
-        if((rf12_hdr & RF12_HDR_MASK) != BS_NODE_ID){
+        // acknowledgements of nodes are not passed to the host, they carry just a header of another message
+        if((rf12_hdr & RF12_HDR_MASK) != BS_NODE_ID || (rf12_hdr & RF12_HDR_CTL)){
             rf12_recvDone();
             return;
         }
 
+        // targeted beacons only check the link, the node waits for the acknowledgement
         if(rf12_data[0] == MSG_CTP){
+            replyAck();
+            return;
+        }
+
+        // frames longer than any protected message cannot be valid, the node does not get an acknowledgement
+        if(rf12_len > MAX_MSG_SIZE){
+            rf12_recvDone();
             return;
         }
 
-        copy_rf12_to_buffer();
+        // record is built directly in the receive buffer
+        rcvd_buff[0] = LINK_FRAME;
+        rcvd_len = rf12_len;
+        rcvd_hdr = rf12_hdr;
+        memcpy(rcvd_buff + 1, (const void*) rf12_data, rcvd_len);
+        replyAck();
+        rf12_recvDone();
 
         // send to host
-        Serial.write(rcvd_len);
-        Serial.write(rcvd_buff, rcvd_len);
-        Serial.flush();
+        sendRecord(rcvd_buff, rcvd_len + 1);
     }
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+/**
+ * @brief Benchmark of hash chain computation - AEShash::hash() element by element compared to HashChainBuilder
+ * with a single chain, interleaved chains and threads
+ *
+ * @file    bench_chainbuild.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "AES_crypto.h"
+#include "AESNI.h"
+#include "HashChainBuilder.h"
+
+#define CHAIN_LENGTH    100000  // length of each chain
+#define CHECK_LENGTH    1000    // length of chains compared with AEShash::hash()
+#define CHECK_CHAINS    5       // chains compared, not a multiple of CHAIN_BUILDER_LANES
+
+using namespace std;
+
+/**
+ * @brief Build chains and measure time per hash
+ *
+ * @param builder       Builder
+ * @param chains_num    Number of chains
+ * @return double       Time per hash in nanoseconds
+ */
+static double measureBuild(HashChainBuilder &builder, uint32_t chains_num)
+{
+    vector<uint8_t> seeds(chains_num * AES_HASH_SIZE, 0x3C);
+    vector<uint8_t> last(chains_num * AES_HASH_SIZE);
+    vector<HashChainJob> jobs(chains_num);
+
+    for(uint32_t i=0;i<chains_num;i++){
+        seeds[i * AES_HASH_SIZE] = i;
+        jobs[i] = { &seeds[i * AES_HASH_SIZE], CHAIN_LENGTH, &last[i * AES_HASH_SIZE], NULL, 0, NULL };
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    builder.build(jobs.data(), chains_num);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    return chrono::duration<double, nano>(end - start).count() / ((double) chains_num * CHAIN_LENGTH);
+}
+
+/**
+ * @brief Compare chains of the builder with AEShash::hash() of the portable AES, which the nodes use to verify keys
+ *
+ * @param builder   Builder
+ * @return true     Outputs are identical
+ * @return false    Outputs differ
+ */
+static bool compareChains(HashChainBuilder &builder)
+{
+    AES aes;
+    AEShash hash(&aes);
+
+    vector<uint8_t> seeds(CHECK_CHAINS * AES_HASH_SIZE, 0x5A);
+    vector<uint8_t> expected(CHECK_CHAINS * (CHECK_LENGTH + 1) * AES_HASH_SIZE);   // every element of every chain
+    vector<uint32_t> positions;
+    for(uint32_t i=0;i<=CHECK_LENGTH;i+=7){
+        positions.push_back(i);
+    }
+
+    for(uint32_t c=0;c<CHECK_CHAINS;c++){
+        uint8_t *chain = &expected[c * (CHECK_LENGTH + 1) * AES_HASH_SIZE];
+        seeds[c * AES_HASH_SIZE] = c;
+        memcpy(chain, &seeds[c * AES_HASH_SIZE], AES_HASH_SIZE);
+        for(uint32_t i=1;i<=CHECK_LENGTH;i++){
+            hash.hash(chain + (i - 1) * AES_HASH_SIZE, AES_HASH_SIZE, chain + i * AES_HASH_SIZE, AES_HASH_SIZE);
+        }
+    }
+
+    // steps() of a single chain
+    uint8_t value[AES_HASH_SIZE];
+    memcpy(value, &seeds[0], AES_HASH_SIZE);
+    builder.steps(value, CHECK_LENGTH);
+    if(memcmp(value, &expected[CHECK_LENGTH * AES_HASH_SIZE], AES_HASH_SIZE)){
+        cerr << "HashChainBuilder::steps() differs from AEShash::hash()" << endl;
+        return false;
+    }
+
+    // build() of interleaved chains with stored elements
+    vector<uint8_t> last(CHECK_CHAINS * AES_HASH_SIZE);
+    vector<uint8_t> values(CHECK_CHAINS * positions.size() * AES_HASH_SIZE);
+    vector<HashChainJob> jobs(CHECK_CHAINS);
+    for(uint32_t c=0;c<CHECK_CHAINS;c++){
+        jobs[c] = { &seeds[c * AES_HASH_SIZE], CHECK_LENGTH, &last[c * AES_HASH_SIZE], positions.data(), (uint32_t) positions.size(), &values[c * positions.size() * AES_HASH_SIZE] };
+    }
+    if(builder.build(jobs.data(), CHECK_CHAINS) != SUCCESS){
+        cerr << "HashChainBuilder::build() failed" << endl;
+        return false;
+    }
+
+    for(uint32_t c=0;c<CHECK_CHAINS;c++){
+        const uint8_t *chain = &expected[c * (CHECK_LENGTH + 1) * AES_HASH_SIZE];
+        if(memcmp(&last[c * AES_HASH_SIZE], chain + CHECK_LENGTH * AES_HASH_SIZE, AES_HASH_SIZE)){
+            cerr << "HashChainBuilder::build() differs from AEShash::hash() in the last element of chain " << c << endl;
+            return false;
+        }
+        for(uint32_t p=0;p<positions.size();p++){
+            if(memcmp(&values[(c * positions.size() + p) * AES_HASH_SIZE], chain + positions[p] * AES_HASH_SIZE, AES_HASH_SIZE)){
+                cerr << "HashChainBuilder::build() differs from AEShash::hash() in element " << positions[p] << " of chain " << c << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    AES aes;
+    AEShash hash(selectCipher(&aes));
+
+    uint8_t value[AES_HASH_SIZE];
+    uint8_t next[AES_HASH_SIZE];
+    memset(value, 0x3C, AES_HASH_SIZE);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(uint32_t i=0;i<CHAIN_LENGTH;i++){
+        hash.hash(value, AES_HASH_SIZE, next, AES_HASH_SIZE);
+        memcpy(value, next, AES_HASH_SIZE);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double hash_ns = chrono::duration<double, nano>(end - start).count() / CHAIN_LENGTH;
+
+    HashChainBuilder single(1);
+    HashChainBuilder parallel;
+    uint32_t cores = max(1u, thread::hardware_concurrency());
+
+    if(!compareChains(single) || !compareChains(parallel)){
+        return 1;
+    }
+
+    cout << "HashChainBuilder and AEShash::hash() produce identical chains" << endl;
+    cout << "chains of " << CHAIN_LENGTH << " elements, " << (single.usesAESNI() ? "AES-NI" : "portable AES") << ", " << cores << " cores" << endl;
+    cout << "AEShash::hash: " << fixed << setprecision(1) << hash_ns << " ns/hash" << endl << endl;
+    cout << setw(8) << "chains" << setw(20) << "1 thread [ns/hash]" << setw(22) << "all cores [ns/hash]" << endl;
+
+    const uint32_t chains[] = { 1, 4, 16 };
+    for(uint32_t chains_num: chains){
+        cout << setw(8) << chains_num << setw(20) << measureBuild(single, chains_num) << setw(22) << measureBuild(parallel, chains_num) << endl;
+    }
+
+    return 0;
+}
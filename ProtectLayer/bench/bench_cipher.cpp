@@ -0,0 +1,153 @@
+/**
+ * @brief Benchmark of AES implementations - portable (TI) and AES-NI. Also checks that both of them produce
+ * identical CTR encryption and CBC-MAC of messages of all sizes.
+ * 
+ * @file    bench_cipher.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#include "bench_common.h"
+#include "AESNI.h"
+#include "AES_crypto.h"
+#include "Crypto.h"
+#include "KeyDistrib.h"
+
+#define ITERATIONS  5000
+#define NODE_ID     MIN_NODE_ID
+
+using namespace std;
+
+/**
+ * @brief Protect messages of all sizes with both ciphers and compare the results
+ * 
+ * @param key_path  Key file
+ * @param portable  Portable cipher
+ * @param fast      Selected cipher
+ * @return true     Outputs are identical
+ * @return false    Otherwise
+ */
+static bool compareOutputs(string &key_path, Cipher *portable, Cipher *fast)
+{
+    KeyDistrib portable_keydistrib(key_path);
+    KeyDistrib fast_keydistrib(key_path);
+    AEShash portable_hash(portable);
+    AEShash fast_hash(fast);
+    AESMAC portable_mac(portable);
+    AESMAC fast_mac(fast);
+    Crypto portable_crypto(portable, &portable_mac, &portable_hash, &portable_keydistrib);
+    Crypto fast_crypto(fast, &fast_mac, &fast_hash, &fast_keydistrib);
+
+    for(uint8_t size = SPHEADER_SIZE; size + AES_MAC_SIZE <= MAX_MSG_SIZE; size++){
+        uint8_t portable_buffer[MAX_MSG_SIZE];
+        uint8_t fast_buffer[MAX_MSG_SIZE];
+        uint8_t portable_len = size;
+        uint8_t fast_len = size;
+
+        for(int i=0;i<MAX_MSG_SIZE;i++){
+            portable_buffer[i] = fast_buffer[i] = i * 7 + size;
+        }
+
+        // key cache is shared, make both ciphers expand the key
+        aes_key_cache.invalidate(NODE_ID);
+        portable_crypto.protectBufferForNodeB(NODE_ID, portable_buffer, SPHEADER_SIZE, &portable_len);
+        aes_key_cache.invalidate(NODE_ID);
+        fast_crypto.protectBufferForNodeB(NODE_ID, fast_buffer, SPHEADER_SIZE, &fast_len);
+
+        if(portable_len != fast_len || memcmp(portable_buffer, fast_buffer, portable_len)){
+            cerr << "Outputs differ for message size " << (int) size << endl;
+            return false;
+        }
+
+        // hash is computed with the same cipher
+        portable_hash.hashDataB(portable_buffer, 0, size, portable_buffer);
+        fast_hash.hashDataB(fast_buffer, 0, size, fast_buffer);
+        if(memcmp(portable_buffer, fast_buffer, AES_HASH_SIZE)){
+            cerr << "Hashes differ for message size " << (int) size << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    string key_path = generateKeyFile(4, 1);
+    AES portable;
+    Cipher *fast = selectCipher(&portable);
+
+    if(fast == &portable){
+        cout << "AES-NI is not available, only portable implementation is measured" << endl;
+    } else if(!compareOutputs(key_path, &portable, fast)){
+        removeKeyFile(key_path);
+        return 1;
+    } else {
+        cout << "AES-NI and portable implementation produce identical CTR, CBC-MAC and hash outputs" << endl;
+    }
+
+    KeyDistrib keydistrib(key_path);
+    KeyDistrib receiver_keydistrib(key_path);
+    removeKeyFile(key_path);
+
+    uint8_t key[AES_KEY_SIZE];
+    uint8_t exp_key[AES_EXP_KEY_SIZE];
+    uint8_t block[AES_BLOCK_SIZE];
+    memset(key, 0xA5, AES_KEY_SIZE);
+    memset(block, 0x5A, AES_BLOCK_SIZE);
+
+    Cipher *ciphers[] = { &portable, fast };
+    const char *names[] = { "portable", "AES-NI" };
+
+    cout << endl << setw(10) << "cipher" << setw(20) << "keyExpansion [ns]" << setw(16) << "encrypt [ns]" 
+         << setw(24) << "protect 50 B [ns]" << setw(34) << "protect + unprotect 50 B [ns]" << endl;
+    for(int c=0;c<(fast == &portable ? 1 : 2);c++){
+        Cipher *cipher = ciphers[c];
+        AEShash hash(cipher);
+        AESMAC mac(cipher);
+        Crypto crypto(cipher, &mac, &hash, &keydistrib);
+        Crypto receiver_crypto(cipher, &mac, &hash, &receiver_keydistrib);
+        uint8_t buffer[MAX_MSG_SIZE];
+        uint8_t len;
+        PL_key_t *sender_key;
+        PL_key_t *receiver_key;
+        bool failed = false;
+
+        cipher->keyExpansion(exp_key, key);
+
+        double expansion_ns = measureNs(ITERATIONS, [&](){ cipher->keyExpansion(exp_key, key); });
+        double encrypt_ns = measureNs(ITERATIONS, [&](){ cipher->encrypt(block, exp_key, block); });
+        double protect_ns = measureNs(ITERATIONS, [&](){
+            len = MAX_MSG_SIZE - AES_MAC_SIZE;
+            crypto.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        });
+
+        // receiver's counter is behind after the previous measurement, let it synchronize
+        len = MAX_MSG_SIZE - AES_MAC_SIZE;
+        crypto.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        receiver_keydistrib.getKeyToNodeB(NODE_ID, &receiver_key);
+        keydistrib.getKeyToNodeB(NODE_ID, &sender_key);
+        *receiver_key->counter = *sender_key->counter;
+
+        double roundtrip_ns = measureNs(ITERATIONS, [&](){
+            len = MAX_MSG_SIZE - AES_MAC_SIZE;
+            crypto.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+            if(receiver_crypto.unprotectBufferFromNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len) != SUCCESS){
+                failed = true;
+            }
+        });
+
+        cout << setw(10) << names[c] << fixed << setprecision(1) << setw(20) << expansion_ns 
+             << setw(16) << encrypt_ns << setw(24) << protect_ns << setw(34) << roundtrip_ns << endl;
+        if(failed){
+            cerr << "Unprotect failed" << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @brief Helpers shared by the benchmarks
+ * 
+ * @file    bench_common.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+#include <unistd.h>
+
+// benchmarks of the node code are built without __linux__ and need no key files
+#ifdef __linux__
+
+#include "configurator.h"
+
+#define BENCH_KEY_SIZE  16
+
+/**
+ * @brief Generate a key file for nodes with IDs from MIN_NODE_ID to MIN_NODE_ID + nodes_num - 1, as configurator would do
+ * 
+ * @param nodes_num     Number of nodes
+ * @param rounds_num    Number of uTESLA rounds
+ * @return std::string  Path to the key file, removed by removeKeyFile()
+ */
+static inline std::string generateKeyFile(const int nodes_num, const int rounds_num)
+{
+    std::string config_path = "/tmp/pl_bench_config_" + std::to_string(getpid());
+    std::string key_path = "/tmp/pl_bench_keys_" + std::to_string(getpid());
+
+    std::ofstream config_file(config_path);
+    for(int i=0;i<nodes_num;i++){
+        config_file << "/dev/null " << MIN_NODE_ID + i << std::endl;
+    }
+    config_file.close();
+
+    Configurator configurator(config_path, rounds_num, BENCH_KEY_SIZE);
+    unlink(config_path.c_str());
+    if(!configurator.saveToFile(key_path)){
+        throw std::runtime_error("Failed to save keys");
+    }
+
+    return key_path;
+}
+
+/**
+ * @brief Remove key file created by generateKeyFile()
+ * 
+ * @param key_path  Path to the key file
+ */
+static inline void removeKeyFile(const std::string &key_path)
+{
+    unlink(key_path.c_str());
+}
+
+#endif // __linux__
+
+#define BENCH_REPEATS   5
+
+/**
+ * @brief Run function repeatedly and measure average time of a single run. The measurement is repeated
+ * BENCH_REPEATS times and the fastest one is taken to filter out noise.
+ * 
+ * @param iterations    Number of runs
+ * @param fn            Function to be measured
+ * @return double       Average time in nanoseconds
+ */
+template<typename F>
+static double measureNs(const uint32_t iterations, F fn)
+{
+    double best = -1;
+
+    for(int r=0;r<BENCH_REPEATS;r++){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(uint32_t i=0;i<iterations;i++){
+            fn();
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+        if(best < 0 || ns < best){
+            best = ns;
+        }
+    }
+
+    return best;
+}
+
+#endif // BENCH_COMMON_H
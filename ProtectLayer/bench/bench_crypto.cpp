@@ -0,0 +1,169 @@
+/**
+ * @brief Microbenchmarks of the crypto hot paths of the base station code for all message sizes. Results are printed
+ * as CSV or JSON (-f json) so they can be compared between runs and cipher implementations.
+ *
+ * @file    bench_crypto.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <cstring>
+#include <vector>
+
+#include "bench_common.h"
+#include "bench_report.h"
+#include "AESNI.h"
+#include "AES_crypto.h"
+#include "Crypto.h"
+#include "KeyDistrib.h"
+
+#define ITERATIONS          200
+#define BLOCK_ITERATIONS    20000   // single block operations are too fast for ITERATIONS
+#define NODE_ID             MIN_NODE_ID
+
+using namespace std;
+
+/**
+ * @brief Measure the cipher and the functions built on it
+ *
+ * @param cipher        Cipher implementation
+ * @param backend       Name of the implementation
+ * @param key_path      Key file
+ * @param results       Output, results are appended
+ * @return true         Success
+ * @return false        Unprotect failed
+ */
+static bool measureCipher(Cipher *cipher, const char *backend, string &key_path, vector<BenchResult> &results)
+{
+    KeyDistrib keydistrib(key_path);
+    KeyDistrib receiver_keydistrib(key_path);
+    AEShash hash(cipher);
+    AESMAC mac(cipher);
+    Crypto crypto(cipher, &mac, &hash, &keydistrib);
+    Crypto receiver_crypto(cipher, &mac, &hash, &receiver_keydistrib);
+    PL_key_t *sender_key;
+    PL_key_t *receiver_key;
+
+    uint8_t key[AES_KEY_SIZE];
+    uint8_t exp_key[AES_EXP_KEY_SIZE];
+    uint8_t block[AES_BLOCK_SIZE];
+    uint8_t data[MAX_MSG_SIZE];
+    uint8_t protected_data[MAX_MSG_SIZE];
+    uint8_t buffer[MAX_MSG_SIZE];
+    uint8_t output[AES_HASH_SIZE];
+    uint8_t len;
+    uint8_t protected_len;
+    bool failed = false;
+
+    memset(key, 0xA5, AES_KEY_SIZE);
+    memset(block, 0x5A, AES_BLOCK_SIZE);
+    for(int i=0;i<MAX_MSG_SIZE;i++){
+        data[i] = i * 7;
+    }
+
+    keydistrib.getKeyToNodeB(NODE_ID, &sender_key);
+    receiver_keydistrib.getKeyToNodeB(NODE_ID, &receiver_key);
+
+    // block operations do not depend on the message size
+    results.push_back({ "AES::keyExpansion", backend, AES_KEY_SIZE, BLOCK_ITERATIONS,
+                        measureNs(BLOCK_ITERATIONS, [&](){ cipher->keyExpansion(exp_key, key); }) });
+    results.push_back({ "AES::encrypt", backend, AES_BLOCK_SIZE, BLOCK_ITERATIONS,
+                        measureNs(BLOCK_ITERATIONS, [&](){ cipher->encrypt(block, exp_key, block); }) });
+
+    for(uint8_t size=1;size<=MAX_MSG_SIZE;size++){
+        results.push_back({ "AESMAC::macBuffer", backend, size, ITERATIONS, measureNs(ITERATIONS, [&](){
+            len = size;
+            mac.macBuffer(key, data, 0, &len, output);
+        }) });
+    }
+
+    for(uint8_t size=1;size<=MAX_MSG_SIZE;size++){
+        results.push_back({ "AEShash::hashDataB", backend, size, ITERATIONS, measureNs(ITERATIONS, [&](){
+            hash.hashDataB(data, 0, size, output);
+        }) });
+    }
+
+    // size is the payload after SPHeader_t, the header gives the receiver a hint of the counter
+    for(uint8_t size=1;SPHEADER_SIZE + size + AES_MAC_SIZE<=MAX_MSG_SIZE;size++){
+        results.push_back({ "Crypto::protectBufferForNodeB", backend, size, ITERATIONS, measureNs(ITERATIONS, [&](){
+            memcpy(buffer, data, SPHEADER_SIZE + size);
+            len = SPHEADER_SIZE + size;
+            crypto.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        }) });
+    }
+
+    // receiver expects the counter of the message, the same message is unprotected repeatedly
+    for(uint8_t size=1;SPHEADER_SIZE + size + AES_MAC_SIZE<=MAX_MSG_SIZE;size++){
+        uint32_t counter = *sender_key->counter;
+
+        memcpy(protected_data, data, SPHEADER_SIZE + size);
+        protected_len = SPHEADER_SIZE + size;
+        crypto.protectBufferForNodeB(NODE_ID, protected_data, SPHEADER_SIZE, &protected_len);
+
+        results.push_back({ "Crypto::unprotectBufferFromNodeB", backend, size, ITERATIONS, measureNs(ITERATIONS, [&](){
+            memcpy(buffer, protected_data, protected_len);
+            len = protected_len;
+            *receiver_key->counter = counter;
+            if(receiver_crypto.unprotectBufferFromNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len) != SUCCESS){
+                failed = true;
+            }
+        }) });
+    }
+
+    // worst case of counter synchronization - no header with the hint and the sender is ahead by the whole window,
+    // the receiver tries all counters in the window and the last one succeeds
+    for(uint8_t size=1;size + AES_MAC_SIZE<=MAX_MSG_SIZE;size++){
+        uint32_t counter = *sender_key->counter;
+
+        *sender_key->counter = counter + COUNTER_SYNCHRONIZATION_WINDOW;
+        memcpy(protected_data, data, size);
+        protected_len = size;
+        crypto.protectBufferForNodeB(NODE_ID, protected_data, 0, &protected_len);
+
+        results.push_back({ "Crypto::unprotectBufferFromNodeB/resync", backend, size, ITERATIONS,
+                            measureNs(ITERATIONS, [&](){
+            memcpy(buffer, protected_data, protected_len);
+            len = protected_len;
+            *receiver_key->counter = counter;
+            if(receiver_crypto.unprotectBufferFromNodeB(NODE_ID, buffer, 0, &len) != SUCCESS){
+                failed = true;
+            }
+        }) });
+    }
+
+    if(failed){
+        cerr << "Unprotect failed with " << backend << " cipher" << endl;
+    }
+
+    return !failed;
+}
+
+int main(int argc, char **argv)
+{
+    vector<BenchResult> results;
+    bool json;
+
+    if(!parseReportFormat(argc, argv, &json)){
+        cerr << "Usage: " << argv[0] << " [-f csv|json]" << endl;
+        return 1;
+    }
+
+    string key_path = generateKeyFile(4, 1);
+    AES portable;
+    Cipher *fast = selectCipher(&portable);
+    bool success = measureCipher(&portable, "portable", key_path, results);
+
+    if(success && fast != &portable){
+        success = measureCipher(fast, "AES-NI", key_path, results);
+    }
+    removeKeyFile(key_path);
+
+    if(!success){
+        return 1;
+    }
+
+    writeReport(results, json);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @brief Benchmark of reassembling frames from the serial byte stream - the original std::deque based
+ * reassembly and FrameRing. Both are fed by the same recorded stream in chunks as returned by read().
+ * 
+ * @file    bench_framing.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <cstring>
+
+#include "bench_common.h"
+#include "FrameRing.h"
+#include "ProtectLayerGlobals.h"
+
+#define FRAMES_NUM      10000   // number of frames in the recorded stream
+#define ITERATIONS      5       // stream is processed this many times per measurement
+
+using namespace std;
+
+/**
+ * @brief Original reassembly from ProtectLayer::receive() - bytes are appended to std::deque, each frame is copied out and erased
+ * 
+ * @param stream    Recorded stream
+ * @param chunk     Number of bytes returned by a single read()
+ * @return uint32_t Checksum of the frames
+ */
+static uint32_t dequePath(const vector<uint8_t> &stream, const size_t chunk)
+{
+    deque<uint8_t> queue;
+    uint8_t frame[MAX_MSG_SIZE + 10];
+    uint32_t checksum = 0;
+
+    for(size_t pos=0;pos<stream.size();pos+=chunk){
+        size_t len = min(chunk, stream.size() - pos);
+        queue.insert(queue.end(), stream.begin() + pos, stream.begin() + pos + len);
+
+        while(!queue.empty() && queue.size() > queue.front()){
+            uint8_t frame_len = queue.front();
+            queue.pop_front();
+            copy(queue.begin(), queue.begin() + frame_len, frame);
+            queue.erase(queue.begin(), queue.begin() + frame_len);
+            checksum += frame_len + frame[0] + frame[frame_len - 1];
+        }
+    }
+
+    return checksum;
+}
+
+/**
+ * @brief Reassembly by FrameRing - bytes are written into the ring, frames are handed out as views
+ * 
+ * @param stream    Recorded stream
+ * @param chunk     Number of bytes returned by a single read()
+ * @return uint32_t Checksum of the frames
+ */
+static uint32_t ringPath(const vector<uint8_t> &stream, const size_t chunk)
+{
+    FrameRing ring;
+    FrameView frame;
+    uint32_t checksum = 0;
+
+    for(size_t pos=0;pos<stream.size();pos+=chunk){
+        size_t len = min(chunk, stream.size() - pos);
+        ring.push(stream.data() + pos, len);
+
+        while(ring.nextFrame(&frame)){
+            checksum += frame.len + frame.data[0] + frame.data[frame.len - 1];
+        }
+    }
+
+    return checksum;
+}
+
+int main()
+{
+    // frames of various sizes as the slave device sends them - [length][message]
+    vector<uint8_t> stream;
+    uint32_t seed = 1;
+    for(int i=0;i<FRAMES_NUM;i++){
+        seed = seed * 1103515245 + 12345;
+        uint8_t len = SPHEADER_SIZE + AES_MAC_SIZE + 1 + (seed >> 16) % (MAX_MSG_SIZE - SPHEADER_SIZE - AES_MAC_SIZE);
+        stream.push_back(len);
+        for(int j=0;j<len;j++){
+            stream.push_back(i + j);
+        }
+    }
+
+    cout << "stream of " << FRAMES_NUM << " frames, " << stream.size() << " B" << endl;
+    cout << setw(12) << "read [B]" << setw(20) << "deque [ns/frame]" << setw(20) << "ring [ns/frame]" << endl;
+
+    // single byte, a short read from a serial port, a whole message and many messages at once
+    const size_t chunks[] = { 1, 16, MAX_MSG_SIZE, 512 };
+    for(size_t chunk: chunks){
+        if(dequePath(stream, chunk) != ringPath(stream, chunk)){
+            cerr << "Frames differ for reads of " << chunk << " B" << endl;
+            return 1;
+        }
+
+        volatile uint32_t sink = 0;
+        double deque_ns = measureNs(ITERATIONS, [&](){ sink += dequePath(stream, chunk); }) / FRAMES_NUM;
+        double ring_ns = measureNs(ITERATIONS, [&](){ sink += ringPath(stream, chunk); }) / FRAMES_NUM;
+
+        cout << setw(12) << chunk << fixed << setprecision(1) << setw(20) << deque_ns << setw(20) << ring_ns << endl;
+    }
+
+    return 0;
+}
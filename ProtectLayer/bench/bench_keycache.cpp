@@ -0,0 +1,114 @@
+/**
+ * @brief Benchmark of key handling - cost of protecting and unprotecting a message with keys expanded in the key table,
+ * with cached keys and without them, and cost of a key lookup
+ * 
+ * @file    bench_keycache.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#include "bench_common.h"
+#include "AES_crypto.h"
+#include "Crypto.h"
+#include "KeyDistrib.h"
+
+#define ITERATIONS  5000
+#define NODE_ID     MIN_NODE_ID
+
+using namespace std;
+
+#define LOOKUP_NODES    200     // number of nodes for the key lookup benchmark
+
+int main()
+{
+    string key_path = generateKeyFile(4, 1);
+
+    // separate key distributions so counters of sender and receiver stay synchronized
+    KeyDistrib sender_keydistrib(key_path);
+    KeyDistrib receiver_keydistrib(key_path);
+    removeKeyFile(key_path);
+
+    AES aes;
+    AEShash hash(&aes);
+    AESMAC mac(&aes);
+    Crypto sender(&aes, &mac, &hash, &sender_keydistrib);
+    Crypto receiver(&aes, &mac, &hash, &receiver_keydistrib);
+
+    uint8_t key[AES_KEY_SIZE];
+    uint8_t exp_key[AES_EXP_KEY_SIZE];
+    memset(key, 0xA5, AES_KEY_SIZE);
+
+    double expansion_ns = measureNs(ITERATIONS, [&](){ aes.keyExpansion(exp_key, key); });
+
+    // key lookup in a network with many nodes, the last node is the worst case for a linear search
+    key_path = generateKeyFile(LOOKUP_NODES, 1);
+    KeyDistrib lookup_keydistrib(key_path);
+    removeKeyFile(key_path);
+    PL_key_t *lookup_key;
+    volatile uint8_t lookup_status = SUCCESS;
+    double lookup_ns = measureNs(ITERATIONS, [&](){
+        lookup_status |= lookup_keydistrib.getKeyToNodeB(MIN_NODE_ID + LOOKUP_NODES - 1, &lookup_key);
+    });
+
+    cout << "keyExpansion: " << fixed << setprecision(1) << expansion_ns << " ns" << endl;
+    cout << "getKeyToNodeB (" << LOOKUP_NODES << " nodes): " << lookup_ns << " ns" << endl << endl;
+    cout << setw(8) << "size" << setw(16) << "table [ns]" << setw(16) << "cache [ns]" << setw(16) << "cold [ns]" << endl;
+
+    // message sizes including header - shortest, one and two blocks and the longest possible
+    const uint8_t sizes[] = { SPHEADER_SIZE + 1, AES_BLOCK_SIZE, 2 * AES_BLOCK_SIZE, MAX_MSG_SIZE - AES_MAC_SIZE };
+    uint8_t buffer[MAX_MSG_SIZE];
+    PL_key_t *sender_key;
+    PL_key_t *receiver_key;
+
+    sender_keydistrib.getKeyToNodeB(NODE_ID, &sender_key);
+    receiver_keydistrib.getKeyToNodeB(NODE_ID, &receiver_key);
+    uint8_t *sender_exp_key = sender_key->expKey;
+    uint8_t *receiver_exp_key = receiver_key->expKey;
+
+    for(uint8_t size: sizes){
+        uint8_t len;
+        uint8_t status = SUCCESS;
+
+        memset(buffer, 0, MAX_MSG_SIZE);
+
+        // protect and unprotect with keys expanded in the key table (BS)
+        sender_key->expKey = sender_exp_key;
+        receiver_key->expKey = receiver_exp_key;
+        double table_ns = measureNs(ITERATIONS, [&](){
+            len = size;
+            status |= sender.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+            status |= receiver.unprotectBufferFromNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        });
+
+        // protect and unprotect with keys staying in the cache (node)
+        sender_key->expKey = NULL;
+        receiver_key->expKey = NULL;
+        double cache_ns = measureNs(ITERATIONS, [&](){
+            len = size;
+            status |= sender.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+            status |= receiver.unprotectBufferFromNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        });
+
+        // every call has to expand the key once
+        double cold_ns = measureNs(ITERATIONS, [&](){
+            len = size;
+            aes_key_cache.invalidate(NODE_ID);
+            status |= sender.protectBufferForNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+            aes_key_cache.invalidate(NODE_ID);
+            status |= receiver.unprotectBufferFromNodeB(NODE_ID, buffer, SPHEADER_SIZE, &len);
+        });
+
+        if(status != SUCCESS || lookup_status != SUCCESS){
+            cerr << "Failed to protect/unprotect message" << endl;
+            return 1;
+        }
+
+        cout << setw(8) << (int) size << setw(16) << table_ns << setw(16) << cache_ns << setw(16) << cold_ns << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @brief Benchmark of concurrent unprotecting - throughput of a base station decrypting messages
+ * from several nodes in several threads that share a single Crypto and KeyDistrib
+ * 
+ * @file    bench_parallel.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+#include "bench_common.h"
+#include "AESNI.h"
+#include "AES_crypto.h"
+#include "Crypto.h"
+#include "KeyDistrib.h"
+
+#define NODES_NUM       8       // number of nodes sending messages
+#define MESSAGES_NUM    20000   // messages from every node
+#define MAX_THREADS     8       // maximum number of threads
+
+using namespace std;
+
+struct Message {
+    uint8_t data[MAX_MSG_SIZE];
+    uint8_t len;
+};
+
+int main()
+{
+    string key_path = generateKeyFile(NODES_NUM, 1);
+    unique_ptr<KeyDistrib> sender_keydistrib(new KeyDistrib(key_path));
+
+    AES portable;
+    Cipher *cipher = selectCipher(&portable);
+    AEShash hash(cipher);
+    AESMAC mac(cipher);
+    Crypto sender(cipher, &mac, &hash, sender_keydistrib.get());
+
+    // messages protected in advance, only unprotecting is measured
+    vector< vector<Message> > messages(NODES_NUM, vector<Message>(MESSAGES_NUM));
+    for(int n=0;n<NODES_NUM;n++){
+        for(int i=0;i<MESSAGES_NUM;i++){
+            Message &msg = messages[n][i];
+            memset(msg.data, i, MAX_MSG_SIZE);
+            SPHeader_t *header = reinterpret_cast<SPHeader_t*>(msg.data);
+            header->msgType = MSG_APP;
+            header->sender = MIN_NODE_ID + n;
+            header->receiver = BS_NODE_ID;
+            msg.len = MAX_MSG_SIZE - AES_MAC_SIZE;
+            sender.protectBufferForNodeB(MIN_NODE_ID + n, msg.data, SPHEADER_SIZE, &msg.len);
+        }
+    }
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << endl;
+    cout << "unprotecting " << NODES_NUM * MESSAGES_NUM << " messages of " << MAX_MSG_SIZE << " B from " << NODES_NUM << " nodes" << endl;
+    cout << setw(10) << "threads" << setw(16) << "time [ms]" << setw(20) << "messages/s" << endl;
+
+    for(int threads_num=1;threads_num<=MAX_THREADS;threads_num*=2){
+        // fresh receiver so the counters start from zero, shared by all threads
+        unique_ptr<KeyDistrib> receiver_keydistrib(new KeyDistrib(key_path));
+        Crypto receiver(cipher, &mac, &hash, receiver_keydistrib.get());
+        vector< vector<Message> > received = messages;
+        atomic<int> failed(0);
+        vector<thread> threads;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(int t=0;t<threads_num;t++){
+            // messages of a node are always handled by the same thread, so its counter is not shared
+            threads.push_back(thread([&, t](){
+                for(int n=t;n<NODES_NUM;n+=threads_num){
+                    for(Message &msg: received[n]){
+                        if(receiver.unprotectBufferFromNodeB(MIN_NODE_ID + n, msg.data, SPHEADER_SIZE, &msg.len) != SUCCESS){
+                            failed++;
+                        }
+                    }
+                }
+            }));
+        }
+        for(thread &th: threads){
+            th.join();
+        }
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+        if(failed){
+            cerr << failed << " messages failed to unprotect" << endl;
+            removeKeyFile(key_path);
+            return 1;
+        }
+
+        double ms = chrono::duration<double, milli>(end - start).count();
+        cout << setw(10) << threads_num << fixed << setprecision(1) << setw(16) << ms 
+             << setw(20) << setprecision(0) << NODES_NUM * MESSAGES_NUM / (ms / 1000) << endl;
+    }
+
+    removeKeyFile(key_path);
+
+    return 0;
+}
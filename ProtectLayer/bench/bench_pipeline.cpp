@@ -0,0 +1,163 @@
+/**
+ * @brief Benchmark of the receive pipeline - throughput of decrypting frames from a replay source and from the event
+ * loop with different numbers of workers. Also checks that messages of every node are delivered in order.
+ * 
+ * @file    bench_pipeline.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "AESNI.h"
+#include "AES_crypto.h"
+#include "Crypto.h"
+#include "EventLoop.h"
+#include "KeyDistrib.h"
+#include "ReceivePipeline.h"
+#include "SerialLink.h"
+
+#define NODES_NUM       16      // number of nodes sending messages
+#define MESSAGES_NUM    10000   // messages from every node
+#define MAX_WORKERS     8       // maximum number of workers
+
+using namespace std;
+
+int main()
+{
+    string key_path = generateKeyFile(NODES_NUM, 1);
+    unique_ptr<KeyDistrib> sender_keydistrib(new KeyDistrib(key_path));
+
+    AES portable;
+    Cipher *cipher = selectCipher(&portable);
+    AEShash hash(cipher);
+    AESMAC mac(cipher);
+    Crypto sender(cipher, &mac, &hash, sender_keydistrib.get());
+
+    // frames as [length][message] for the replay source and serial stream of LINK_FRAME records as the slave
+    // device would send it, nodes interleaved
+    vector<uint8_t> frames;
+    vector<uint8_t> stream;
+    for(uint32_t i=0;i<MESSAGES_NUM;i++){
+        for(int n=0;n<NODES_NUM;n++){
+            uint8_t msg[MAX_MSG_SIZE];
+            uint8_t len = MAX_MSG_SIZE - AES_MAC_SIZE;
+            SPHeader_t *header = reinterpret_cast<SPHeader_t*>(msg);
+
+            header->msgType = MSG_APP;
+            header->sender = MIN_NODE_ID + n;
+            header->receiver = BS_NODE_ID;
+            memset(msg + SPHEADER_SIZE, 0, len - SPHEADER_SIZE);
+            memcpy(msg + SPHEADER_SIZE, &i, sizeof(i));     // sequence number to check the order
+            sender.protectBufferForNodeB(MIN_NODE_ID + n, msg, SPHEADER_SIZE, &len);
+
+            frames.push_back(len);
+            frames.insert(frames.end(), msg, msg + len);
+
+            uint8_t record[LINK_MAX_RECORD];
+            uint8_t encoded[LINK_MAX_ENCODED];
+            record[0] = LINK_FRAME;
+            memcpy(record + 1, msg, len);
+            uint8_t encoded_len = linkEncode(record, len + 1, encoded);
+            stream.insert(stream.end(), encoded, encoded + encoded_len);
+        }
+    }
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << endl;
+    cout << "receiving " << NODES_NUM * MESSAGES_NUM << " messages of " << MAX_MSG_SIZE << " B from " << NODES_NUM << " nodes" << endl;
+    cout << setw(10) << "workers" << setw(16) << "submit [ms]" << setw(16) << "loop [ms]" << setw(20) << "messages/s" << endl;
+
+    for(int workers_num=1;workers_num<=MAX_WORKERS;workers_num*=2){
+        double times[2];
+
+        // frames submitted directly by a replay source and frames passed by the event loop serving a slave device
+        for(int source=0;source<2;source++){
+            unique_ptr<KeyDistrib> receiver_keydistrib(new KeyDistrib(key_path));
+            Crypto receiver(cipher, &mac, &hash, receiver_keydistrib.get());
+            vector<uint32_t> next_seq(NODES_NUM, 0);    // each node is handled by a single worker
+            vector<uint32_t> out_of_order(NODES_NUM, 0);
+
+            ReceivePipeline pipeline(&receiver, mac.macSize(), [&](const uint8_t *data, uint8_t size){
+                int n = reinterpret_cast<const SPHeader_t*>(data)->sender - MIN_NODE_ID;
+                uint32_t seq;
+                memcpy(&seq, data + SPHEADER_SIZE, sizeof(seq));
+                if(seq != next_seq[n] || size != MAX_MSG_SIZE - AES_MAC_SIZE){
+                    out_of_order[n]++;
+                }
+                next_seq[n] = seq + 1;
+            }, workers_num);
+
+            // sources are faster than the radio, they wait for workers instead of dropping frames
+            auto submit = [&](const uint8_t *data, uint8_t len){
+                while(pipeline.submit(data, len) == ERR_BUFFSIZE){
+                    this_thread::yield();
+                }
+            };
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if(source == 0){
+                for(size_t pos=0;pos<frames.size();pos+=frames[pos] + 1){
+                    submit(&frames[pos + 1], frames[pos]);
+                }
+            } else {
+                // the writer plays the slave device, the loop runs until every frame is submitted, stop() waits for workers
+                int fds[2];
+                if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0){
+                    cerr << "Failed to create socket pair" << endl;
+                    return 1;
+                }
+                EventLoop loop;
+                if(loop.addDevice(fds[0]) < 0){
+                    cerr << "Failed to add device to event loop" << endl;
+                    return 1;
+                }
+                uint32_t submitted = 0;
+                loop.setFrameCallback([&](uint8_t, uint8_t *data, uint8_t len){ submit(data, len); submitted++; });
+                thread writer([&](){
+                    for(size_t pos=0;pos<stream.size();){
+                        ssize_t written = write(fds[1], &stream[pos], stream.size() - pos);
+                        if(written <= 0){
+                            break;
+                        }
+                        pos += written;
+                    }
+                    close(fds[1]);
+                });
+                loop.runUntil([&](){ return submitted >= NODES_NUM * MESSAGES_NUM; }, 60000);
+                writer.join();
+                pipeline.stop();
+                close(fds[0]);
+            }
+            pipeline.stop();
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            times[source] = chrono::duration<double, milli>(end - start).count();
+
+            uint32_t disordered = 0;
+            for(uint32_t count: out_of_order){
+                disordered += count;
+            }
+            if(pipeline.getReceivedCount() != NODES_NUM * MESSAGES_NUM || pipeline.getFailedCount() || disordered){
+                cerr << "Received " << pipeline.getReceivedCount() << ", failed " << pipeline.getFailedCount() 
+                     << ", out of order " << disordered << endl;
+                removeKeyFile(key_path);
+                return 1;
+            }
+        }
+
+        cout << setw(10) << workers_num << fixed << setprecision(1) << setw(16) << times[0] << setw(16) << times[1]
+             << setw(20) << setprecision(0) << NODES_NUM * MESSAGES_NUM / (times[0] / 1000) << endl;
+    }
+
+    removeKeyFile(key_path);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @brief Machine-readable results of the benchmarks - CSV or JSON in the format of Google Benchmark, so the results
+ * can be compared between runs and backends by the usual tools
+ *
+ * @file    bench_report.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * @brief Result of a single measurement
+ *
+ */
+struct BenchResult {
+    std::string     function;       // measured function
+    std::string     backend;        // cipher implementation or variant
+    uint32_t        size;           // payload size in bytes
+    uint32_t        iterations;     // runs of the function in a single measurement
+    double          ns;             // average time of a single run
+};
+
+/**
+ * @brief Parse the output format from the command line
+ *
+ * @param argc      Number of arguments
+ * @param argv      Arguments, "-f csv" or "-f json"
+ * @param json      Output, true for JSON
+ * @return true     Success
+ * @return false    Unknown argument
+ */
+static inline bool parseReportFormat(int argc, char **argv, bool *json)
+{
+    *json = false;
+
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i], "-f") && i + 1 < argc){
+            i++;
+            if(!strcmp(argv[i], "json")){
+                *json = true;
+            } else if(strcmp(argv[i], "csv")){
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write results as CSV, one measurement per line
+ *
+ * @param results   Results
+ */
+static inline void writeCsv(const std::vector<BenchResult> &results)
+{
+    printf("name,function,backend,size,iterations,real_time,time_unit\n");
+    for(const BenchResult &result: results){
+        printf("%s/%s/%u,%s,%s,%u,%u,%.2f,ns\n", result.function.c_str(), result.backend.c_str(), result.size,
+               result.function.c_str(), result.backend.c_str(), result.size, result.iterations, result.ns);
+    }
+}
+
+/**
+ * @brief Write results as JSON with the context and benchmarks arrays of Google Benchmark
+ *
+ * @param results   Results
+ */
+static inline void writeJson(const std::vector<BenchResult> &results)
+{
+    char host[256] = "";
+    char date[64] = "";
+    time_t now = time(NULL);
+
+    gethostname(host, sizeof(host) - 1);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    printf("{\n  \"context\": {\n");
+    printf("    \"date\": \"%s\",\n", date);
+    printf("    \"host_name\": \"%s\",\n", host);
+    printf("    \"num_cpus\": %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  },\n  \"benchmarks\": [\n");
+    for(size_t i=0;i<results.size();i++){
+        const BenchResult &result = results[i];
+        printf("    {\"name\": \"%s/%s/%u\", \"function\": \"%s\", \"backend\": \"%s\", \"size\": %u, "
+               "\"iterations\": %u, \"real_time\": %.2f, \"time_unit\": \"ns\"}%s\n",
+               result.function.c_str(), result.backend.c_str(), result.size, result.function.c_str(),
+               result.backend.c_str(), result.size, result.iterations, result.ns, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+/**
+ * @brief Write results in the selected format
+ *
+ * @param results   Results
+ * @param json      JSON if true, CSV otherwise
+ */
+static inline void writeReport(const std::vector<BenchResult> &results, bool json)
+{
+    if(json){
+        writeJson(results);
+    } else {
+        writeCsv(results);
+    }
+}
+
+#endif // BENCH_REPORT_H
@@ -0,0 +1,101 @@
+/**
+ * @brief Benchmark of the uTESLA hash chain - startup time, memory and cost of a new round with checkpoints
+ * compared to storing the whole chain, and restart from a checkpoint file
+ *
+ * @file    bench_utesla.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "AES_crypto.h"
+#include "HashChain.h"
+
+#define RESTART_ROUNDS  10      // rounds before the restart
+
+using namespace std;
+
+int main()
+{
+    const uint32_t lengths[] = { 1000, 10000, 100000, 1000000 };
+
+    AES aes;
+    AEShash hash(&aes);
+
+    uint8_t seed[AES_HASH_SIZE];
+    memset(seed, 0x5A, AES_HASH_SIZE);
+
+    cout << setw(10) << "rounds" << setw(14) << "init [ms]" << setw(14) << "chain [B]" << setw(18) << "checkpoints [B]"
+         << setw(16) << "hashes/round" << setw(18) << "max hashes" << setw(16) << "round [us]" << setw(18) << "max round [us]" << setw(16) << "restart [us]" << endl;
+
+    string checkpoint_path = "/tmp/pl_bench_utesla_" + to_string(getpid());
+
+    for(uint32_t length: lengths){
+        HashChain chain(&hash);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if(chain.init(seed, length) != SUCCESS){
+            cerr << "Failed to initialize hash chain" << endl;
+            return 1;
+        }
+        double init_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        uint64_t init_hashes = chain.hashCount();
+
+        // traverse the whole chain as newRound() does
+        uint32_t max_checkpoints = 0;
+        uint64_t max_hashes = 0;
+        double max_round_us = 0;
+        start = chrono::steady_clock::now();
+        while(chain.index() >= 0){
+            max_checkpoints = max(max_checkpoints, chain.checkpointCount());
+
+            uint64_t hashes = chain.hashCount();
+            chrono::steady_clock::time_point round_start = chrono::steady_clock::now();
+            if(chain.next() != SUCCESS){
+                cerr << "Failed to compute next key" << endl;
+                return 1;
+            }
+            max_round_us = max(max_round_us, chrono::duration<double, micro>(chrono::steady_clock::now() - round_start).count());
+            max_hashes = max(max_hashes, chain.hashCount() - hashes);
+        }
+        double traversal_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        // restart from a checkpoint file after a few rounds, every round is synced to disk
+        double restart_us;
+        {
+            HashChain persistent(&hash);
+            if(persistent.open(checkpoint_path, seed, length) != SUCCESS){
+                cerr << "Failed to create checkpoint file" << endl;
+                return 1;
+            }
+            for(uint32_t i=0;i<RESTART_ROUNDS;i++){
+                persistent.next();
+            }
+        }
+        {
+            HashChain restarted(&hash);
+            start = chrono::steady_clock::now();
+            if(restarted.open(checkpoint_path, seed, length) != SUCCESS || restarted.index() != (int32_t) (length - RESTART_ROUNDS - 1)){
+                cerr << "Failed to restart from checkpoint file" << endl;
+                return 1;
+            }
+            restart_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        }
+        unlink(checkpoint_path.c_str());
+
+        cout << setw(10) << length << fixed << setprecision(1) << setw(14) << init_ms
+             << setw(14) << (uint64_t) (length + 1) * AES_HASH_SIZE << setw(18) << max_checkpoints * AES_HASH_SIZE
+             << setprecision(2) << setw(16) << (double) (chain.hashCount() - init_hashes) / length << setw(18) << max_hashes
+             << setw(16) << traversal_us / length << setw(18) << max_round_us << setw(16) << restart_us << endl;
+    }
+
+    return 0;
+}
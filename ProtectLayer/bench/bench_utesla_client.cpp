@@ -0,0 +1,113 @@
+/**
+ * @brief Microbenchmark of uTESLA key update on nodes - verification of a disclosed key after 1 to
+ * MAX_NUM_MISSED_ROUNDS missed rounds and rejection of a forged key. uTeslaClient is node code, so the benchmark
+ * is built without __linux__ against the shim headers of the simulator and provides the few shim functions itself.
+ * Results are printed as CSV or JSON (-f json).
+ *
+ * @file    bench_utesla_client.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "bench_report.h"
+#include "AES_crypto.h"
+#include "uTESLAClient.h"
+
+#define ITERATIONS  1000
+
+using namespace std;
+
+static uint8_t eeprom[SIM_EEPROM_SIZE];
+
+// the client reads its commitment from EEPROM and checks time of key arrival, time stands still here
+uint8_t *simEeprom()
+{
+    return eeprom;
+}
+
+uint32_t simMillis()
+{
+    return 0;
+}
+
+/**
+ * @brief Build hash chain, the first key is the commitment and every key is the hash of the next one
+ *
+ * @param hash      Hash function
+ * @param length    Number of keys after the commitment
+ * @return vector<uint8_t>  Keys, AES_HASH_SIZE bytes each
+ */
+static vector<uint8_t> buildChain(Hash *hash, const uint32_t length)
+{
+    vector<uint8_t> chain((length + 1) * AES_HASH_SIZE);
+
+    for(uint32_t i=0;i<AES_HASH_SIZE;i++){
+        chain[length * AES_HASH_SIZE + i] = i * 13 + 1;
+    }
+    for(uint32_t i=length;i>0;i--){
+        hash->hash(&chain[i * AES_HASH_SIZE], AES_HASH_SIZE, &chain[(i - 1) * AES_HASH_SIZE], AES_HASH_SIZE);
+    }
+
+    return chain;
+}
+
+int main(int argc, char **argv)
+{
+    vector<BenchResult> results;
+    bool json;
+
+    if(!parseReportFormat(argc, argv, &json)){
+        cerr << "Usage: " << argv[0] << " [-f csv|json]" << endl;
+        return 1;
+    }
+
+    AES aes;
+    AEShash hash(&aes);
+    AESMAC mac(&aes);
+    bool failed = false;
+
+    // every run discloses the key of the round that comes after the missed ones
+    for(uint32_t missed=1;missed<=MAX_NUM_MISSED_ROUNDS;missed++){
+        vector<uint8_t> chain = buildChain(&hash, BENCH_REPEATS * ITERATIONS * missed);
+        uint32_t index = 0;
+
+        memcpy(eeprom + (uintptr_t) UTESLA_KEY_ADDRESS, &chain[0], AES_HASH_SIZE);
+        uTeslaClient client(UTESLA_KEY_ADDRESS, &hash, &mac);
+
+        double ns = measureNs(ITERATIONS, [&](){
+            index += missed;
+            if(client.updateKey(&chain[index * AES_HASH_SIZE]) != SUCCESS){
+                failed = true;
+            }
+        });
+        results.push_back({ "uTeslaClient::updateKey/" + to_string(missed), "node", AES_HASH_SIZE, ITERATIONS, ns });
+    }
+
+    // forged key is hashed MAX_NUM_MISSED_ROUNDS times before it is rejected
+    vector<uint8_t> chain = buildChain(&hash, 1);
+    uint8_t forged[AES_HASH_SIZE];
+    memset(forged, 0xA5, AES_HASH_SIZE);
+    memcpy(eeprom + (uintptr_t) UTESLA_KEY_ADDRESS, &chain[0], AES_HASH_SIZE);
+    uTeslaClient client(UTESLA_KEY_ADDRESS, &hash, &mac);
+
+    double ns = measureNs(ITERATIONS, [&](){
+        if(client.updateKey(forged) != FAIL){
+            failed = true;
+        }
+    });
+    results.push_back({ "uTeslaClient::updateKey/forged", "node", AES_HASH_SIZE, ITERATIONS, ns });
+
+    if(failed){
+        cerr << "Key update gave unexpected result" << endl;
+        return 1;
+    }
+
+    writeReport(results, json);
+
+    return 0;
+}
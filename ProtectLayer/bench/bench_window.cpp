@@ -0,0 +1,184 @@
+/**
+ * @brief Benchmark of sending messages through the slave device - stop-and-wait (window 1) and a window of SLAVE_QUEUE_LEN
+ * messages in flight. The slave is simulated by a thread with serial port latency, serial transfer time and radio time.
+ *
+ * @file    bench_window.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench_common.h"
+#include "EventLoop.h"
+#include "SerialLink.h"
+#include "common.h"
+
+#define MESSAGES_NUM    50      // messages sent in each measurement
+#define RADIO_US        12000   // RF12 at 49.2 kbps needs about 12 ms for a message of MAX_MSG_SIZE with preamble and CRC
+
+using namespace std;
+
+/**
+ * @brief Simulated slave device. Messages become available after one-way latency and serial transfer time, the radio
+ * sends one message per RADIO_US and statuses reach the host after one-way latency.
+ *
+ */
+class SimulatedSlave {
+private:
+    struct Message {
+        uint64_t    available_us;   // when the slave has read the whole message
+        uint8_t     seq;
+    };
+
+    struct Status {
+        uint64_t    deliver_us;     // when the host receives the status
+        uint8_t     status;
+        uint8_t     seq;
+    };
+
+    int                 m_fd;
+    uint32_t            m_latency_us;
+    std::atomic<bool>   m_running;
+    std::thread         m_thread;
+
+    static uint64_t nowUs()
+    {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void run()
+    {
+        deque<Message> queue;
+        deque<Status> statuses;
+        LinkDecoder decoder;
+        uint8_t buffer[1024];
+        uint32_t encoded_len = 0;       // bytes of the record being received
+        uint64_t serial_free_us = 0;    // serial line from the host is busy until then
+        uint64_t radio_free_us = 0;     // radio is busy until then
+
+        while(m_running){
+            uint64_t now = nowUs();
+
+            ssize_t rval = read(m_fd, buffer, sizeof(buffer));
+            for(ssize_t pos = 0; pos < rval;){
+                uint16_t consumed = decoder.feed(buffer + pos, rval - pos);
+                pos += consumed;
+                encoded_len += consumed;
+
+                uint8_t *record = decoder.record();
+                uint8_t len = decoder.recordLen();
+                if(!len){
+                    continue;
+                }
+
+                // message is available when all its encoded bytes are transferred
+                uint64_t transfer_us = encoded_len * 10 * 1000000ULL / SLAVE_BAUD_RATE;
+                serial_free_us = max(serial_free_us, now + m_latency_us) + transfer_us;
+                encoded_len = 0;
+
+                if(record[0] != LINK_MSG || len < 3){
+                    continue;
+                }
+                if(queue.size() < SLAVE_QUEUE_LEN){
+                    queue.push_back({ serial_free_us, record[1] });
+                } else {
+                    statuses.push_back({ serial_free_us + m_latency_us, ERR_MSG_ADD, record[1] });
+                }
+            }
+
+            // radio sends the oldest message and the slave confirms it
+            if(!queue.empty() && queue.front().available_us <= now && radio_free_us <= now){
+                radio_free_us = now + RADIO_US;
+                statuses.push_back({ now + m_latency_us, ERR_OK, queue.front().seq });
+                queue.pop_front();
+            }
+
+            while(!statuses.empty() && statuses.front().deliver_us <= now){
+                uint8_t record[3] = { LINK_STATUS, statuses.front().status, statuses.front().seq };
+                uint8_t encoded[LINK_MAX_ENCODED];
+                uint8_t len = linkEncode(record, sizeof(record), encoded);
+                if(write(m_fd, encoded, len) != len){
+                    return;
+                }
+                statuses.pop_front();
+            }
+
+            usleep(50);
+        }
+    }
+
+public:
+    SimulatedSlave(int fd, uint32_t latency_us): m_fd(fd), m_latency_us(latency_us), m_running(true)
+    {
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+        m_thread = std::thread(&SimulatedSlave::run, this);
+    }
+
+    ~SimulatedSlave()
+    {
+        m_running = false;
+        m_thread.join();
+    }
+};
+
+int main()
+{
+    // USB serial adapters deliver data in intervals of their latency timer, 16 ms by default for FTDI
+    const uint32_t latencies_ms[] = { 1, 4, 16 };
+    const uint8_t windows[] = { 1, SLAVE_QUEUE_LEN };
+
+    uint8_t message[MAX_MSG_SIZE];
+    memset(message, 0xAB, MAX_MSG_SIZE);
+
+    cout << "sending " << MESSAGES_NUM << " messages of " << MAX_MSG_SIZE << " B, radio " << RADIO_US / 1000 << " ms per message" << endl;
+    cout << setw(14) << "latency [ms]" << setw(10) << "window" << setw(16) << "messages/s" << setw(20) << "radio utilization" << endl;
+
+    for(uint32_t latency_ms: latencies_ms){
+        for(uint8_t window: windows){
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0){
+                cerr << "Failed to create socket pair" << endl;
+                return 1;
+            }
+
+            uint32_t confirmed = 0;
+            uint32_t failed = 0;
+            double time_ms;
+            {
+                SimulatedSlave slave(fds[1], latency_ms * 1000);
+                EventLoop loop;
+                int device = loop.addDevice(fds[0], window);
+
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for(int i=0;i<MESSAGES_NUM;i++){
+                    loop.send(device, message, MAX_MSG_SIZE, [&](uint8_t status){ status == ERR_OK ? confirmed++ : failed++; });
+                }
+                loop.runUntil([&](){ return confirmed + failed == MESSAGES_NUM; }, MESSAGES_NUM * 1000);
+                chrono::steady_clock::time_point end = chrono::steady_clock::now();
+                time_ms = chrono::duration<double, milli>(end - start).count();
+            }
+            close(fds[0]);
+            close(fds[1]);
+
+            if(confirmed != MESSAGES_NUM){
+                cerr << "Confirmed " << confirmed << " of " << MESSAGES_NUM << " messages" << endl;
+                return 1;
+            }
+
+            cout << setw(14) << latency_ms << setw(10) << (int) window << fixed << setprecision(1) << setw(16) << MESSAGES_NUM / (time_ms / 1000)
+                 << setw(19) << 100.0 * MESSAGES_NUM * RADIO_US / 1000 / time_ms << "%" << endl;
+        }
+    }
+
+    return 0;
+}
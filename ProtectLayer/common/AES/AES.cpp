@@ -66,7 +66,7 @@ void AES::keyExpansion(uint8_t *expkey, const uint8_t *key)
         if( !(i % Nk) ) {
             tmp4 = tmp3;
             tmp3 = sbox[tmp0];
-            tmp0 = sbox[tmp1] ^ Rcon[i/Nk];
+            tmp0 = sbox[tmp1] ^ Rcon[i/Nk - 1];
             tmp1 = sbox[tmp2];
             tmp2 = sbox[tmp4];
         } else if( Nk > 6 && i % Nk == 4 ) {
@@ -65,6 +65,11 @@
 */
 #define Nk 4
 
+/*
+    Size of the expanded key in bytes - a round key for each round and one for the initial AddRoundKey.
+*/
+#define AES_EXP_KEY_SIZE    (Nb * 4 * (NB_ROUNDS + 1))
+
 
 class AES: public Cipher {
 public:
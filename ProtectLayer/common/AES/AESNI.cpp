@@ -0,0 +1,268 @@
+/**
+ * @brief AES implementation using AES-NI instructions for Linux base station on x86 CPUs
+ * 
+ * @file    AESNI.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "AESNI.h"
+
+#include <string.h>
+
+#ifdef HAVE_AESNI
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+// intrinsics are enabled per function, so the rest of the library can run on CPUs without AES-NI
+#define AESNI_TARGET    __attribute__((target("aes,sse2")))
+
+// one step of AES-128 key schedule, 'assist' is the output of _mm_aeskeygenassist_si128()
+AESNI_TARGET static inline __m128i keyExpansionStep(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, _MM_SHUFFLE(3, 3, 3, 3));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+// round constant must be an immediate value, hence the macro
+#define expand_round(round_keys, i, rcon) \
+    round_keys[i] = keyExpansionStep(round_keys[i - 1], _mm_aeskeygenassist_si128(round_keys[i - 1], rcon))
+
+bool AESNI::isSupported()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+        return false;
+    }
+
+    return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+
+AESNI_TARGET void AESNI::keyExpansion(uint8_t *expkey, const uint8_t *key)
+{
+    __m128i round_keys[NB_ROUNDS + 1];
+
+    round_keys[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    expand_round(round_keys, 1, 0x01);
+    expand_round(round_keys, 2, 0x02);
+    expand_round(round_keys, 3, 0x04);
+    expand_round(round_keys, 4, 0x08);
+    expand_round(round_keys, 5, 0x10);
+    expand_round(round_keys, 6, 0x20);
+    expand_round(round_keys, 7, 0x40);
+    expand_round(round_keys, 8, 0x80);
+    expand_round(round_keys, 9, 0x1B);
+    expand_round(round_keys, 10, 0x36);
+
+    for(int i=0;i<NB_ROUNDS + 1;i++){
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(expkey + i * AES_BLOCK_SIZE), round_keys[i]);
+    }
+}
+
+AESNI_TARGET bool AESNI::encrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block)
+{
+    if(!in_block || !expkey || !out_block){
+        return false;
+    }
+
+    const __m128i *round_keys = reinterpret_cast<const __m128i*>(expkey);
+    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_block));
+
+    state = _mm_xor_si128(state, _mm_loadu_si128(round_keys));
+    for(int i=1;i<NB_ROUNDS;i++){
+        state = _mm_aesenc_si128(state, _mm_loadu_si128(round_keys + i));
+    }
+    state = _mm_aesenclast_si128(state, _mm_loadu_si128(round_keys + NB_ROUNDS));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out_block), state);
+
+    return true;
+}
+
+AESNI_TARGET bool AESNI::encrypt2(const uint8_t *in_block1, const uint8_t *in_block2, uint8_t *expkey, uint8_t *out_block1, uint8_t *out_block2)
+{
+    if(!in_block1 || !in_block2 || !expkey || !out_block1 || !out_block2){
+        return false;
+    }
+
+    // rounds of both blocks are interleaved so that they overlap in the AES unit
+    const __m128i *round_keys = reinterpret_cast<const __m128i*>(expkey);
+    __m128i round_key = _mm_loadu_si128(round_keys);
+    __m128i state1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in_block1)), round_key);
+    __m128i state2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in_block2)), round_key);
+
+    for(int i=1;i<NB_ROUNDS;i++){
+        round_key = _mm_loadu_si128(round_keys + i);
+        state1 = _mm_aesenc_si128(state1, round_key);
+        state2 = _mm_aesenc_si128(state2, round_key);
+    }
+    round_key = _mm_loadu_si128(round_keys + NB_ROUNDS);
+    state1 = _mm_aesenclast_si128(state1, round_key);
+    state2 = _mm_aesenclast_si128(state2, round_key);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out_block1), state1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out_block2), state2);
+
+    return true;
+}
+
+// round of the key schedule of all chains and the encryption with it, round constant must be an immediate value
+#define chain_round(keys, states, n, rcon) \
+    for(int l=0;l<n;l++){ \
+        keys[l] = keyExpansionStep(keys[l], _mm_aeskeygenassist_si128(keys[l], rcon)); \
+        states[l] = _mm_aesenc_si128(states[l], keys[l]); \
+    }
+
+AESNI_TARGET void AESNI::hashChainSteps(uint8_t *blocks, uint8_t blocks_num, uint32_t steps)
+{
+    __m128i zero_keys[NB_ROUNDS + 1];
+    __m128i values[4];
+    __m128i keys[4];
+    __m128i states[4];
+    int n = blocks_num < 4 ? blocks_num : 4;
+
+    // the first block is always encrypted by the all-zero key
+    zero_keys[0] = _mm_setzero_si128();
+    expand_round(zero_keys, 1, 0x01);
+    expand_round(zero_keys, 2, 0x02);
+    expand_round(zero_keys, 3, 0x04);
+    expand_round(zero_keys, 4, 0x08);
+    expand_round(zero_keys, 5, 0x10);
+    expand_round(zero_keys, 6, 0x20);
+    expand_round(zero_keys, 7, 0x40);
+    expand_round(zero_keys, 8, 0x80);
+    expand_round(zero_keys, 9, 0x1B);
+    expand_round(zero_keys, 10, 0x36);
+
+    for(int l=0;l<n;l++){
+        values[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + l * AES_BLOCK_SIZE));
+    }
+
+    for(uint32_t s=0;s<steps;s++){
+        // key = E_0(x) ^ x
+        for(int l=0;l<n;l++){
+            states[l] = _mm_xor_si128(values[l], zero_keys[0]);
+        }
+        for(int i=1;i<NB_ROUNDS;i++){
+            for(int l=0;l<n;l++){
+                states[l] = _mm_aesenc_si128(states[l], zero_keys[i]);
+            }
+        }
+        for(int l=0;l<n;l++){
+            keys[l] = _mm_xor_si128(_mm_aesenclast_si128(states[l], zero_keys[NB_ROUNDS]), values[l]);
+            states[l] = keys[l];    // zero block xored with the first round key
+        }
+
+        // x' = E_key(0) ^ 0, round keys are expanded on the fly
+        chain_round(keys, states, n, 0x01);
+        chain_round(keys, states, n, 0x02);
+        chain_round(keys, states, n, 0x04);
+        chain_round(keys, states, n, 0x08);
+        chain_round(keys, states, n, 0x10);
+        chain_round(keys, states, n, 0x20);
+        chain_round(keys, states, n, 0x40);
+        chain_round(keys, states, n, 0x80);
+        chain_round(keys, states, n, 0x1B);
+        for(int l=0;l<n;l++){
+            keys[l] = keyExpansionStep(keys[l], _mm_aeskeygenassist_si128(keys[l], 0x36));
+            values[l] = _mm_aesenclast_si128(states[l], keys[l]);
+        }
+    }
+
+    for(int l=0;l<n;l++){
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blocks + l * AES_BLOCK_SIZE), values[l]);
+    }
+}
+
+AESNI_TARGET bool AESNI::decrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block)
+{
+    if(!in_block || !expkey || !out_block){
+        return false;
+    }
+
+    // equivalent inverse cipher - inner round keys are transformed by InvMixColumns on the fly
+    const __m128i *round_keys = reinterpret_cast<const __m128i*>(expkey);
+    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_block));
+
+    state = _mm_xor_si128(state, _mm_loadu_si128(round_keys + NB_ROUNDS));
+    for(int i=NB_ROUNDS - 1;i>0;i--){
+        state = _mm_aesdec_si128(state, _mm_aesimc_si128(_mm_loadu_si128(round_keys + i)));
+    }
+    state = _mm_aesdeclast_si128(state, _mm_loadu_si128(round_keys));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out_block), state);
+
+    return true;
+}
+
+/**
+ * @brief Known-answer test - FIPS-197 Appendix C.1 vector, compared also with the portable implementation
+ * 
+ * @param aesni     AES-NI implementation
+ * @param portable  Portable implementation
+ * @return true     Both implementations produce expected results
+ * @return false    Otherwise
+ */
+static bool knownAnswerTest(AESNI *aesni, AES *portable)
+{
+    const uint8_t key[AES_KEY_SIZE] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    const uint8_t plaintext[AES_BLOCK_SIZE] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    const uint8_t ciphertext[AES_BLOCK_SIZE] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+
+    uint8_t aesni_exp[AES_EXP_KEY_SIZE];
+    uint8_t portable_exp[AES_EXP_KEY_SIZE];
+    uint8_t aesni_out[AES_BLOCK_SIZE];
+    uint8_t aesni_out2[AES_BLOCK_SIZE];
+    uint8_t portable_out[AES_BLOCK_SIZE];
+
+    // expanded keys must be interchangeable
+    aesni->keyExpansion(aesni_exp, key);
+    portable->keyExpansion(portable_exp, key);
+    if(memcmp(aesni_exp, portable_exp, AES_EXP_KEY_SIZE)){
+        return false;
+    }
+
+    aesni->encrypt(plaintext, aesni_exp, aesni_out);
+    portable->encrypt(plaintext, portable_exp, portable_out);
+    if(memcmp(aesni_out, ciphertext, AES_BLOCK_SIZE) || memcmp(portable_out, ciphertext, AES_BLOCK_SIZE)){
+        return false;
+    }
+
+    // second block of the pair is checked against the portable implementation
+    aesni->encrypt2(plaintext, ciphertext, aesni_exp, aesni_out, aesni_out2);
+    portable->encrypt(ciphertext, portable_exp, portable_out);
+    if(memcmp(aesni_out, ciphertext, AES_BLOCK_SIZE) || memcmp(aesni_out2, portable_out, AES_BLOCK_SIZE)){
+        return false;
+    }
+
+    aesni->decrypt(ciphertext, aesni_exp, aesni_out);
+    if(memcmp(aesni_out, plaintext, AES_BLOCK_SIZE)){
+        return false;
+    }
+
+    return true;
+}
+
+#endif // HAVE_AESNI
+
+Cipher *selectCipher(AES *portable)
+{
+#ifdef HAVE_AESNI
+    static AESNI aesni;     // no state, single instance is enough
+
+    if(AESNI::isSupported() && knownAnswerTest(&aesni, portable)){
+        return &aesni;
+    }
+#endif // HAVE_AESNI
+
+    return portable;
+}
+
+#endif // __linux__
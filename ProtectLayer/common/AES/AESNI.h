@@ -0,0 +1,71 @@
+/**
+ * @brief AES implementation using AES-NI instructions for Linux base station on x86 CPUs
+ * 
+ * @file    AESNI.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef AESNI_H
+#define AESNI_H
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include "AES.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_AESNI  1
+#endif
+
+#ifdef HAVE_AESNI
+
+/**
+ * @brief AES-128 using AES-NI instructions. Uses the same expanded key format as AES class,
+ * so keys expanded by one of them can be used by the other one.
+ * 
+ */
+class AESNI: public Cipher {
+public:
+    /**
+     * @brief Check whether the CPU supports AES-NI instructions
+     * 
+     * @return true     AES-NI is available
+     * @return false    Otherwise
+     */
+    static bool isSupported();
+
+    virtual void keyExpansion(uint8_t *expkey, const uint8_t *key);
+
+    virtual bool encrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block);
+
+    virtual bool decrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block);
+
+    virtual bool encrypt2(const uint8_t *in_block1, const uint8_t *in_block2, uint8_t *expkey, uint8_t *out_block1, uint8_t *out_block2);
+
+    /**
+     * @brief Advance hash chains of the AES-based hash (AEShash of a single block) in place. Chains are interleaved,
+     * so several of them cost about as much as one.
+     * 
+     * @param blocks        Current elements of the chains, AES_BLOCK_SIZE bytes each
+     * @param blocks_num    Number of chains, at most 4
+     * @param steps         Number of hashes
+     */
+    static void hashChainSteps(uint8_t *blocks, uint8_t blocks_num, uint32_t steps);
+};
+
+#endif // HAVE_AESNI
+
+/**
+ * @brief Select the fastest cipher usable on this CPU. AES-NI implementation is used only if it is supported
+ * and passes a known-answer test against the portable implementation.
+ * 
+ * @param portable  Portable AES implementation used as a fallback
+ * @return Cipher*  AES-NI implementation or portable
+ */
+Cipher *selectCipher(AES *portable);
+
+#endif // __linux__
+
+#endif // AESNI_H
@@ -25,13 +25,45 @@
 
 #include <string.h>
 
+#if defined(__linux__) || defined(SIMULATOR)
+// cache of the calling thread
+thread_local AESKeyCache aes_key_cache;
+#else
 // global variable shared between aes-based classes to save some space
-uint8_t expanded_key[240]; //expanded key
+AESKeyCache aes_key_cache;
+#endif
 
-AEShash::AEShash(AES *aes): m_aes(aes), m_exp(expanded_key) { }
+AESKeyCache::AESKeyCache()
+{
+    memset(m_valid, 0, sizeof(m_valid));
+}
 
-// uint8_t hashDataBlockB( uint8_t* buffer, uint8_t offset, PL_key_t* key, uint8_t* hash){
-uint8_t AEShash::hashDataBlockB(const uint8_t* buffer, uint8_t offset, uint8_t* key, uint8_t* hash)
+uint8_t *AESKeyCache::getExpandedKey(Cipher *cipher, uint8_t key_id, const uint8_t *key)
+{
+    uint8_t slot = key_id % AES_KEY_CACHE_SLOTS;
+
+    // expand the key only if the slot holds a different one
+    if(!m_valid[slot] || memcmp(m_keys[slot], key, AES_KEY_SIZE)){
+        memcpy(m_keys[slot], key, AES_KEY_SIZE);
+        cipher->keyExpansion(m_expanded[slot], key);
+        m_valid[slot] = true;
+    }
+
+    return m_expanded[slot];
+}
+
+void AESKeyCache::invalidate(uint8_t key_id)
+{
+    uint8_t slot = key_id % AES_KEY_CACHE_SLOTS;
+
+    m_valid[slot] = false;
+    memset(m_keys[slot], 0, AES_KEY_SIZE);
+    memset(m_expanded[slot], 0, AES_EXP_KEY_SIZE);
+}
+
+AEShash::AEShash(Cipher *cipher): m_cipher(cipher) { }
+
+uint8_t AEShash::hashBlock(const uint8_t* block, uint8_t key_id, const uint8_t* key, uint8_t* hash)
 {
     uint8_t status = SUCCESS;       
     uint8_t i;
@@ -40,15 +72,20 @@ uint8_t AEShash::hashDataBlockB(const uint8_t* buffer, uint8_t offset, uint8_t*
         return FAIL;        
     }
     
-    m_aes->keyExpansion( m_exp, key);
-    m_aes->encrypt(buffer + offset, m_exp, hash);
+    m_cipher->encrypt(block, aes_key_cache.getExpandedKey(m_cipher, key_id, key), hash);
     for(i = 0; i < AES_BLOCK_SIZE; i++){
-        hash[i] = buffer[i + offset] ^ hash[i];
+        hash[i] = block[i] ^ hash[i];
     }
 
     return status;
 }
 
+// uint8_t hashDataBlockB( uint8_t* buffer, uint8_t offset, PL_key_t* key, uint8_t* hash){
+uint8_t AEShash::hashDataBlockB(const uint8_t* buffer, uint8_t offset, uint8_t* key, uint8_t* hash)
+{
+    return hashBlock(buffer + offset, KEY_ID_TEMP, key, hash);
+}
+
 uint8_t AEShash::hashDataB(const uint8_t* buffer, uint8_t offset, uint8_t len, uint8_t* hash)
 {
     uint8_t status = SUCCESS;
@@ -81,7 +118,8 @@ uint8_t AEShash::hashDataB(const uint8_t* buffer, uint8_t offset, uint8_t len, u
                 hash[j] = 0;
             } 
         }
-        if((status = hashDataBlockB(hash, 0, key_buff, tempHash)) != SUCCESS){
+        // the first block is hashed with all-zero key that stays cached, others with intermediate hash values
+        if((status = hashBlock(hash, i ? KEY_ID_TEMP : KEY_ID_HASH, key_buff, tempHash)) != SUCCESS){
             return status;
         }
 
@@ -121,20 +159,16 @@ uint8_t AEShash::hashSize()
 	return AES_HASH_SIZE;
 }
 
-AESMAC::AESMAC(AES *aes): m_aes(aes), m_exp(expanded_key)
-{
-    memset(expanded_key, 0, AES_KEY_SIZE);
-}
+AESMAC::AESMAC(Cipher *cipher): m_cipher(cipher) { }
 
 
-uint8_t AESMAC::macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac)
+uint8_t AESMAC::macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac, uint8_t key_id)
 {
     uint8_t i;
     uint8_t j;
     uint8_t xor_[AES_BLOCK_SIZE];
     uint8_t status = SUCCESS;
-    
-    m_aes->keyExpansion( m_exp, key);
+    uint8_t *exp_key = aes_key_cache.getExpandedKey(m_cipher, key_id, key);
         
     //if pLen is < BLOCK_SIZE then copy just pLen otherwise copy first block of data
     memset(xor_, 0, AES_BLOCK_SIZE);
@@ -145,7 +179,7 @@ uint8_t AESMAC::macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t off
     }
     //process buffer by blocks
     for (i = 0; i < (*pLen / AES_BLOCK_SIZE) + 1; i++){
-        m_aes->encrypt (xor_, m_exp, xor_);
+        m_cipher->encrypt (xor_, exp_key, xor_);
         for (j = 0; j < AES_BLOCK_SIZE; j++){
             if ((*pLen <= (i * AES_BLOCK_SIZE + j))){
                 break;
@@ -14,22 +14,86 @@
 #include "AES.h"
 #include "common.h"
 
+// number of expanded keys kept in AESKeyCache, key with ID 'i' is stored in slot 'i % AES_KEY_CACHE_SLOTS'
+#ifndef AES_KEY_CACHE_SLOTS
+#ifdef __linux__
+#define AES_KEY_CACHE_SLOTS     (KEY_ID_TEMP + 1)   // a slot for every node and every KEY_ID_*
+#else
+#define AES_KEY_CACHE_SLOTS     1                   // single slot to save RAM
+#endif
+#endif // AES_KEY_CACHE_SLOTS
+
+/**
+ * @brief Direct-mapped cache of expanded keys. Slot is selected by the key ID, the key value
+ * is stored as well and compared on every lookup, so a replaced key is never served stale.
+ * 
+ */
+class AESKeyCache {
+private:
+    uint8_t m_keys[AES_KEY_CACHE_SLOTS][AES_KEY_SIZE];          // keys stored in slots
+    uint8_t m_expanded[AES_KEY_CACHE_SLOTS][AES_EXP_KEY_SIZE];  // expanded keys
+    bool    m_valid[AES_KEY_CACHE_SLOTS];                       // true if slot contains a key
+
+public:
+    /**
+     * @brief Constructor, invalidates all slots
+     * 
+     */
+    AESKeyCache();
+
+    /**
+     * @brief Get expanded key, expand it into the ID's slot if it is not cached
+     * 
+     * @param cipher    Cipher used for key expansion
+     * @param key_id    Node's ID or one of KEY_ID_*
+     * @param key       Key to be expanded
+     * @return uint8_t* Expanded key, valid until another key with the same slot is requested
+     */
+    uint8_t *getExpandedKey(Cipher *cipher, uint8_t key_id, const uint8_t *key);
+
+    /**
+     * @brief Remove key from the cache and overwrite it
+     * 
+     * @param key_id    Node's ID or one of KEY_ID_*
+     */
+    void invalidate(uint8_t key_id);
+};
+
+#if defined(__linux__) || defined(SIMULATOR)
+// every thread has its own cache, so several threads can protect and unprotect messages concurrently - simulated
+// nodes of different worker threads too
+extern thread_local AESKeyCache aes_key_cache;
+#else
+// global cache shared between aes-based classes, single instance to save RAM
+extern AESKeyCache aes_key_cache;
+#endif
+
 /**
  * @brief Class for hash computation
  * 
  */
 class AEShash: public Hash {
 private:
-    AES     *m_aes; // AES class used for AES encryption
-    uint8_t *m_exp; //  expanded key
+    Cipher      *m_cipher;      // AES implementation used for encryption
+
+    /**
+     * @brief Hash single block
+     * 
+     * @param block     Block to be hashed
+     * @param key_id    ID of the key used to cache its expanded form
+     * @param key       Key to use for AES
+     * @param hash      Output
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t hashBlock(const uint8_t* block, uint8_t key_id, const uint8_t* key, uint8_t* hash);
 
 public:
     /**
      * @brief Constructor
      * 
-     * @param aes AES class
+     * @param cipher AES implementation
      */
-    AEShash(AES *aes);
+    AEShash(Cipher *cipher);
 
     /**
      * @brief Hash single block
@@ -80,16 +144,15 @@ public:
  */
 class AESMAC: public MAC {
 private:
-    AES *m_aes;     // AES class used for AES encryption
-    uint8_t *m_exp; // expanded key
+    Cipher      *m_cipher;      // AES implementation used for encryption
 
 public:
     /**
      * @brief Constructor
      * 
-     * @param aes   AES class
+     * @param cipher    AES implementation
      */
-    AESMAC(AES *aes);
+    AESMAC(Cipher *cipher);
 
     /**
      * @brief Compute MAC for buffer
@@ -99,9 +162,10 @@ public:
      * @param offset    Offset to skip
      * @param pLen      Size of the data
      * @param mac       Output
+     * @param key_id    ID of the key used to cache its expanded form
      * @return uint8_t  SUCCESS or FAIL
      */
-    virtual uint8_t macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac);
+    virtual uint8_t macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac, uint8_t key_id = KEY_ID_UTESLA);
 
     /**
      * @brief Compute MAC for buffer
@@ -0,0 +1,237 @@
+/**
+ * @brief Implementation of the AES hash chain builder
+ *
+ * @file    HashChainBuilder.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "HashChainBuilder.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+
+#include "AESNI.h"
+#include "common.h"
+
+/**
+ * @brief Advance chains by the portable implementation
+ *
+ * @param aes           AES implementation
+ * @param zero_exp      Expanded all-zero key
+ * @param blocks        Current elements of the chains
+ * @param blocks_num    Number of chains
+ * @param steps         Number of hashes
+ */
+static void portableSteps(AES *aes, uint8_t *zero_exp, uint8_t *blocks, uint8_t blocks_num, uint32_t steps)
+{
+    uint8_t key[AES_BLOCK_SIZE];
+    uint8_t exp_key[AES_EXP_KEY_SIZE];
+    const uint8_t zero[AES_BLOCK_SIZE] = { 0 };
+
+    for(uint8_t l=0;l<blocks_num;l++){
+        uint8_t *value = blocks + l * AES_BLOCK_SIZE;
+
+        for(uint32_t s=0;s<steps;s++){
+            // key = E_0(x) ^ x, x' = E_key(0), calls are qualified to avoid virtual dispatch
+            aes->AES::encrypt(value, zero_exp, key);
+            for(int i=0;i<AES_BLOCK_SIZE;i++){
+                key[i] ^= value[i];
+            }
+            aes->AES::keyExpansion(exp_key, key);
+            aes->AES::encrypt(zero, exp_key, value);
+        }
+    }
+}
+
+/**
+ * @brief Advance chains by the fastest available implementation
+ *
+ * @param aesni         Use AES-NI
+ * @param aes           AES implementation
+ * @param zero_exp      Expanded all-zero key
+ * @param blocks        Current elements of the chains
+ * @param blocks_num    Number of chains
+ * @param steps         Number of hashes
+ */
+static void chainSteps(bool aesni, AES *aes, uint8_t *zero_exp, uint8_t *blocks, uint8_t blocks_num, uint32_t steps)
+{
+#ifdef HAVE_AESNI
+    if(aesni){
+        AESNI::hashChainSteps(blocks, blocks_num, steps);
+        return;
+    }
+#endif // HAVE_AESNI
+
+    portableSteps(aes, zero_exp, blocks, blocks_num, steps);
+}
+
+HashChainBuilder::HashChainBuilder(uint32_t threads_num): m_threads_num(threads_num), m_aesni(false)
+{
+    if(!m_threads_num){
+        m_threads_num = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+#ifdef HAVE_AESNI
+    // AES-NI is used only if it gives the same chain as the portable implementation
+    if(AESNI::isSupported()){
+        AES aes;
+        uint8_t zero_key[AES_KEY_SIZE] = { 0 };
+        uint8_t zero_exp[AES_EXP_KEY_SIZE];
+        uint8_t portable[AES_BLOCK_SIZE * 2];
+        uint8_t aesni[AES_BLOCK_SIZE * 2];
+
+        for(int i=0;i<AES_BLOCK_SIZE * 2;i++){
+            portable[i] = aesni[i] = i * 7;
+        }
+        aes.keyExpansion(zero_exp, zero_key);
+        portableSteps(&aes, zero_exp, portable, 2, 3);
+        AESNI::hashChainSteps(aesni, 2, 3);
+
+        m_aesni = !memcmp(portable, aesni, sizeof(aesni));
+    }
+#endif // HAVE_AESNI
+}
+
+void HashChainBuilder::step(const uint8_t *in, uint8_t *out)
+{
+    AES aes;
+    uint8_t zero_key[AES_KEY_SIZE] = { 0 };
+    uint8_t zero_exp[AES_EXP_KEY_SIZE];
+
+    aes.keyExpansion(zero_exp, zero_key);
+    memmove(out, in, AES_BLOCK_SIZE);
+    portableSteps(&aes, zero_exp, out, 1, 1);
+}
+
+void HashChainBuilder::steps(uint8_t *value, uint32_t steps)
+{
+    AES aes;
+    uint8_t zero_key[AES_KEY_SIZE] = { 0 };
+    uint8_t zero_exp[AES_EXP_KEY_SIZE];
+
+    if(!m_aesni){
+        aes.keyExpansion(zero_exp, zero_key);
+    }
+    chainSteps(m_aesni, &aes, zero_exp, value, 1, steps);
+}
+
+void HashChainBuilder::worker(HashChainJob *jobs, uint32_t jobs_num, uint8_t lanes_max, std::atomic<uint32_t> *next_job)
+{
+    struct Lane {
+        HashChainJob    *job;
+        uint32_t        index;          // index of the element in blocks
+        uint32_t        position;       // next position to be stored
+    };
+
+    AES aes;
+    uint8_t zero_key[AES_KEY_SIZE] = { 0 };
+    uint8_t zero_exp[AES_EXP_KEY_SIZE];
+    aes.keyExpansion(zero_exp, zero_key);
+
+    Lane lanes[CHAIN_BUILDER_LANES];
+    uint8_t blocks[CHAIN_BUILDER_LANES * AES_BLOCK_SIZE];
+    uint8_t lanes_num = 0;
+
+    while(true){
+        // take new jobs to free lanes
+        while(lanes_num < lanes_max){
+            uint32_t job = next_job->fetch_add(1);
+            if(job >= jobs_num){
+                break;
+            }
+            lanes[lanes_num] = { &jobs[job], 0, 0 };
+            memcpy(blocks + lanes_num * AES_BLOCK_SIZE, jobs[job].seed, AES_BLOCK_SIZE);
+            lanes_num++;
+        }
+        if(!lanes_num){
+            return;
+        }
+
+        // store requested elements, finished lanes are replaced by the last one
+        for(int l=lanes_num - 1;l>=0;l--){
+            Lane &lane = lanes[l];
+            uint8_t *block = blocks + l * AES_BLOCK_SIZE;
+
+            while(lane.position < lane.job->positions_num && lane.job->positions[lane.position] == lane.index){
+                memcpy(lane.job->values + lane.position * AES_BLOCK_SIZE, block, AES_BLOCK_SIZE);
+                lane.position++;
+            }
+
+            if(lane.index == lane.job->length){
+                memcpy(lane.job->last, block, AES_BLOCK_SIZE);
+                lanes_num--;
+                lane = lanes[lanes_num];
+                memcpy(block, blocks + lanes_num * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+            }
+        }
+        if(!lanes_num){
+            continue;
+        }
+
+        // all lanes advance to the nearest element that has to be stored
+        uint32_t steps = UINT32_MAX;
+        for(int l=0;l<lanes_num;l++){
+            uint32_t next = lanes[l].job->length;
+            if(lanes[l].position < lanes[l].job->positions_num){
+                next = std::min(next, lanes[l].job->positions[lanes[l].position]);
+            }
+            steps = std::min(steps, next - lanes[l].index);
+        }
+
+        chainSteps(m_aesni, &aes, zero_exp, blocks, lanes_num, steps);
+        for(int l=0;l<lanes_num;l++){
+            lanes[l].index += steps;
+        }
+    }
+}
+
+uint8_t HashChainBuilder::build(HashChainJob *jobs, uint32_t jobs_num)
+{
+    if(!jobs){
+        return FAIL;
+    }
+
+    for(uint32_t i=0;i<jobs_num;i++){
+        if(!jobs[i].seed || !jobs[i].last || (jobs[i].positions_num && (!jobs[i].positions || !jobs[i].values))){
+            return FAIL;
+        }
+        for(uint32_t p=0;p<jobs[i].positions_num;p++){
+            if(jobs[i].positions[p] > jobs[i].length || (p && jobs[i].positions[p] <= jobs[i].positions[p - 1])){
+                return FAIL;
+            }
+        }
+    }
+
+    if(!jobs_num){
+        return SUCCESS;
+    }
+
+    // cores first, lanes are filled by chains that are left - a thread taking all lanes would leave cores idle
+    std::atomic<uint32_t> next_job(0);
+    uint32_t threads_num = std::min(m_threads_num, jobs_num);
+    uint8_t lanes_max = std::min<uint32_t>(CHAIN_BUILDER_LANES, (jobs_num + threads_num - 1) / threads_num);
+    std::vector<std::thread> threads;
+    for(uint32_t i=1;i<threads_num;i++){
+        threads.emplace_back(&HashChainBuilder::worker, this, jobs, jobs_num, lanes_max, &next_job);
+    }
+    worker(jobs, jobs_num, lanes_max, &next_job);
+
+    for(std::thread &thread: threads){
+        thread.join();
+    }
+
+    return SUCCESS;
+}
+
+bool HashChainBuilder::usesAESNI()
+{
+    return m_aesni;
+}
+
+#endif // __linux__
@@ -0,0 +1,100 @@
+/**
+ * @brief Fast computation of hash chains of the AES-based hash for Linux base station and configurator
+ *
+ * @file    HashChainBuilder.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef HASHCHAINBUILDER_H
+#define HASHCHAINBUILDER_H
+
+#ifdef __linux__
+
+#include <atomic>
+
+#include <stdint.h>
+
+#include "AES.h"
+
+#define CHAIN_BUILDER_LANES     4       // chains hashed in lockstep by a single thread
+
+/**
+ * @brief Chain to be computed - x_0 = seed, x_i = AEShash(x_(i-1)) for 16-byte elements
+ *
+ */
+struct HashChainJob {
+    const uint8_t   *seed;              // x_0
+    uint32_t        length;             // index of the last element
+    uint8_t         *last;              // output for x_length
+    const uint32_t  *positions;         // increasing indices of elements to be stored, may be NULL
+    uint32_t        positions_num;      // number of indices
+    uint8_t         *values;            // output for stored elements, AES_HASH_SIZE bytes each
+};
+
+/**
+ * @brief Builder of AES hash chains. A step of the chain is a specialized non-virtual AES hash (AES-NI when the CPU
+ * supports it) instead of AEShash::hash() with its key cache. Chains are distributed among threads, each thread
+ * hashes up to CHAIN_BUILDER_LANES chains interleaved so that they overlap in the AES unit.
+ *
+ */
+class HashChainBuilder {
+private:
+    uint32_t    m_threads_num;      // maximum number of threads
+    bool        m_aesni;            // AES-NI is used
+
+    /**
+     * @brief Compute chains taken from the shared job index until there are none left
+     *
+     * @param jobs      Jobs
+     * @param jobs_num  Number of jobs
+     * @param lanes_max Maximum number of chains hashed at once
+     * @param next_job  Index of the next job to be taken, shared by threads
+     */
+    void worker(HashChainJob *jobs, uint32_t jobs_num, uint8_t lanes_max, std::atomic<uint32_t> *next_job);
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param threads_num   Maximum number of threads, 0 for the number of CPU cores
+     */
+    HashChainBuilder(uint32_t threads_num = 0);
+
+    /**
+     * @brief Compute a single hash of the chain by the portable implementation
+     *
+     * @param in    Element
+     * @param out   Next element, may be the same as in
+     */
+    static void step(const uint8_t *in, uint8_t *out);
+
+    /**
+     * @brief Advance a single chain in place by the fastest available implementation
+     *
+     * @param value     Element, replaced by the result
+     * @param steps     Number of hashes
+     */
+    void steps(uint8_t *value, uint32_t steps);
+
+    /**
+     * @brief Compute chains
+     *
+     * @param jobs      Chains to be computed
+     * @param jobs_num  Number of chains
+     * @return uint8_t  SUCCESS or FAIL if a job is invalid
+     */
+    uint8_t build(HashChainJob *jobs, uint32_t jobs_num);
+
+    /**
+     * @brief Check whether AES-NI is used
+     *
+     * @return true     AES-NI is used
+     * @return false    Portable implementation is used
+     */
+    bool usesAESNI();
+};
+
+#endif // __linux__
+
+#endif // HASHCHAINBUILDER_H
@@ -11,74 +11,105 @@
 #include "common.h"
 
 #ifdef __linux__    // BS host
-#include <chrono>
-#include <thread>
-
 #include <cstring>
-#include <unistd.h>
 
 
-void CTP::setSlaveFD(int slave_fd)
+CTP::CTP(): m_loop(NULL), m_device(0), m_sent(0), m_result(SUCCESS), m_active(false), m_timer_id(0), m_expected(0), m_converged(0)
 {
-    m_slave_fd = slave_fd;
+    // distance message does not change
+    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(m_message);
+    header->msgType = MSG_CTP;
+    header->sender = BS_NODE_ID;
+    header->receiver = 0;
+    header->seq = 0;
+
+    // set distance and route cost to 0
+    memset(m_message + SPHEADER_SIZE, 0, CTP_BEACON_SIZE - SPHEADER_SIZE);
 }
 
-uint8_t CTP::startCTP(uint32_t duration)
+void CTP::setSlave(EventLoop *loop, uint8_t device)
 {
-    uint64_t start = millis();
-    uint8_t buffer[MAX_MSG_SIZE];
-    uint8_t recv_buffer[MAX_MSG_SIZE];
+    m_loop = loop;
+    m_device = device;
+}
 
-    memset(buffer, 0, MAX_MSG_SIZE);
+void CTP::setExpected(uint32_t nodes)
+{
+    m_expected = nodes;
+}
 
-    // set size of message for serial communication
-    buffer[0] = SPHEADER_SIZE + 1;
-    buffer[1] = buffer[0];
-    
-    // set header pointer
-    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(buffer + 2);
-    header->msgType = MSG_CTP;
-    header->sender = BS_NODE_ID;
-    header->receiver = 0;
+void CTP::reportConverged(uint8_t node_id)
+{
+    if(node_id < 32){
+        setBit(m_converged, node_id);
+    }
+}
 
-    // set distance to 0
-    buffer[SPHEADER_SIZE + 2] = 0;
+uint32_t CTP::getConverged()
+{
+    return m_converged;
+}
 
-    // rebroadcast several times
-    for(int i=0;i<CTP_REBROADCASTS_NUM;i++){
-        int len;
-        
-        if((len = write(m_slave_fd, buffer, sizeof(SPHeader_t) + 3)) < sizeof(SPHeader_t) + 3){
-            return FAIL;
+void CTP::rebroadcast()
+{
+    // nodes estimate the link quality from lost beacons
+    reinterpret_cast<SPHeader_t*>(m_message)->seq++;
+
+    uint8_t rval = m_loop->send(m_device, m_message, sizeof(m_message), [this](uint8_t status){
+        if(!m_active){
+            return;
         }
 
-        if((len = read(m_slave_fd, recv_buffer, MAX_MSG_SIZE)) < 1){
-            return FAIL;
+        if(status != ERR_OK){
+            m_result = FAIL;
+            return;
         }
-        
-        if(recv_buffer[0] != ERR_OK){
-           return FAIL;
+
+        // rebroadcast several times
+        if(++m_sent < CTP_REBROADCASTS_NUM){
+            m_timer_id = m_loop->addTimer(CTP_REBROADCASTS_DELAY, [this](){ rebroadcast(); });
         }
+    });
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(CTP_REBROADCASTS_DELAY));
+    if(rval != SUCCESS){
+        m_result = FAIL;
     }
+}
 
-    // sleep until CTP formation ends
-    uint64_t end = millis();
-    if(end - start < duration){
-        std::this_thread::sleep_for(std::chrono::milliseconds(duration - (end - start)));
+uint8_t CTP::startCTP(uint32_t duration)
+{
+    if(!m_loop){
+        return FAIL;
     }
 
-    return SUCCESS;
+    m_sent = 0;
+    m_result = SUCCESS;
+    m_timer_id = 0;
+    m_active = true;
+    m_converged = 0;
+
+    rebroadcast();
+
+    // serve the slave until CTP formation ends or all nodes report convergence instead of sleeping
+    m_loop->runUntil([this](){
+        return m_result != SUCCESS || (m_expected && (m_converged & m_expected) == m_expected);
+    }, duration);
+
+    m_active = false;
+    m_loop->cancelTimer(m_timer_id);
+
+    return m_result;
 }
 
 #else   // node
 #include "RF12.h"
 
 CTP::CTP(): 
-m_node_id(0), m_parent_id(0), m_distance(INVALID_DISTANCE), m_req_ack(DEFAULT_REQ_ACK)
+m_node_id(0), m_parent_id(0), m_distance(INVALID_DISTANCE), m_req_ack(DEFAULT_REQ_ACK),
+m_trickle(CTP_TRICKLE_IMIN, CTP_TRICKLE_DOUBLINGS, CTP_TRICKLE_K), m_beacons(0), m_convergence_time(0), m_repairs(0),
+m_etx(CTP_INVALID_ETX), m_tree_etx(CTP_INVALID_ETX), m_beacon_seq(0), m_forward_dups(NULL)
 { 
-
+    memset(m_candidates, 0, sizeof(m_candidates));
 }
 
 void CTP::setNodeID(uint8_t node_id)
@@ -86,6 +117,11 @@ void CTP::setNodeID(uint8_t node_id)
     m_node_id = node_id;
 }
 
+void CTP::setForwardCache(DuplicateCache *forward_dups)
+{
+    m_forward_dups = forward_dups;
+}
+
 // extracts distance from packet
 void CTP::update(uint8_t *message)
 {
@@ -94,72 +130,315 @@ void CTP::update(uint8_t *message)
         return;
     }
 
-    // ignore longer distances
-    if(message[sizeof(SPHeader_t)] + 1 >= m_distance){
+    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(message);
+    uint8_t distance = message[sizeof(SPHeader_t)];
+    uint16_t etx;
+    memcpy(&etx, message + sizeof(SPHeader_t) + 1, sizeof(etx));
+
+    // every neighbor is a possible parent, its link is estimated from the beacons
+    CTPCandidate_t *candidate = updateCandidate(header->sender, distance, etx, header->seq);
+
+    // a neighbor advertising the same distance makes own beacon redundant
+    if(distance == m_distance){
+        m_trickle.consistent();
+    }
+
+    uint8_t old_parent = m_parent_id;
+    uint8_t old_distance = m_distance;
+
+    // parent's route changed, so did own
+    if(candidate && header->sender == m_parent_id){
+        setParent(candidate);
+    }
+
+    // switch only to a clearly better route, estimates of similar links fluctuate
+    CTPCandidate_t *best = bestCandidate();
+    if(best && best->id != m_parent_id && (!m_parent_id || pathEtx(best) + CTP_ETX_HYSTERESIS < m_etx)){
+        setParent(best);
+    }
+
+    // neighbors have to learn the new route soon
+    if(m_parent_id != old_parent || m_distance != old_distance){
+        m_trickle.reset(millis());
+    }
+}
+
+CTPCandidate_t *CTP::updateCandidate(uint8_t id, uint8_t distance, uint16_t etx, uint8_t seq)
+{
+    CTPCandidate_t *candidate = findCandidate(id);
+
+    if(candidate){
+        // gap in beacon sequence numbers means lost beacons, a repeated number comes from a targeted beacon
+        uint8_t missed = seq - candidate->seq - 1;
+        if(seq != candidate->seq && missed < CTP_MAX_MISSED_BEACONS){
+            for(uint8_t i = 0; i < missed; i++){
+                candidate->quality -= candidate->quality >> 3;
+            }
+        }
+
+        // hearing the neighbor again means the link works
+        candidate->quality += (255 - candidate->quality) >> 3;
+        candidate->distance = distance;
+        candidate->etx = etx;
+        candidate->seq = seq;
+        return candidate;
+    }
+
+    // replace an empty entry or the one with the most expensive route, never the parent
+    for(uint8_t i = 0; i < CTP_CANDIDATES; i++){
+        CTPCandidate_t *entry = &m_candidates[i];
+        if(!entry->id){
+            candidate = entry;
+            break;
+        }
+        if(entry->id == m_parent_id){
+            continue;
+        }
+        if(!candidate || pathEtx(entry) > pathEtx(candidate)){
+            candidate = entry;
+        }
+    }
+
+    // keep cheaper routes when the table is full, links of new neighbors are assumed average
+    if(!candidate || (candidate->id && pathEtx(candidate) <= etx + CTP_ETX_UNIT * 255 / CTP_QUALITY_INIT)){
+        return NULL;
+    }
+
+    candidate->id = id;
+    candidate->distance = distance;
+    candidate->etx = etx;
+    candidate->seq = seq;
+    candidate->quality = CTP_QUALITY_INIT;
+
+    return candidate;
+}
+
+CTPCandidate_t *CTP::findCandidate(uint8_t id)
+{
+    if(!id){
+        return NULL;
+    }
+
+    for(uint8_t i = 0; i < CTP_CANDIDATES; i++){
+        if(m_candidates[i].id == id){
+            return &m_candidates[i];
+        }
+    }
+
+    return NULL;
+}
+
+void CTP::linkResult(uint8_t id, bool acked)
+{
+    CTPCandidate_t *candidate = findCandidate(id);
+    if(!candidate){
         return;
     }
 
-    // set attributes
-    m_distance = message[sizeof(SPHeader_t)] + 1;
-    m_parent_id = ((SPHeader_t*)(message))->sender;
+    // exponentially weighted, a few lost acknowledgements make the link unusable
+    if(acked){
+        candidate->quality += (255 - candidate->quality) >> 2;
+    } else {
+        candidate->quality -= candidate->quality >> 2;
+    }
+
+    // own route cost follows the parent's link
+    if(id == m_parent_id){
+        setParent(candidate);
+    }
+}
+
+uint16_t CTP::pathEtx(const CTPCandidate_t *candidate)
+{
+    if(candidate->etx >= CTP_INVALID_ETX || candidate->quality < CTP_QUALITY_MIN){
+        return CTP_INVALID_ETX;
+    }
+
+    // expected transmissions over the link are the inverse of the delivery ratio
+    uint32_t etx = candidate->etx + (uint32_t) CTP_ETX_UNIT * 255 / candidate->quality;
+
+    return etx < CTP_INVALID_ETX ? etx : CTP_INVALID_ETX;
+}
+
+CTPCandidate_t *CTP::bestCandidate()
+{
+    CTPCandidate_t *best = NULL;
+
+    // descendants advertise at least the lowest own cost plus one transmission, routes through them would loop
+    uint32_t max_etx = (uint32_t) m_tree_etx + CTP_ETX_UNIT;
+
+    for(uint8_t i = 0; i < CTP_CANDIDATES; i++){
+        CTPCandidate_t *candidate = &m_candidates[i];
+        if(!candidate->id || candidate->etx >= max_etx || candidate->distance + 1 >= INVALID_DISTANCE ||
+                pathEtx(candidate) >= CTP_INVALID_ETX){
+            continue;
+        }
+
+        if(!best || pathEtx(candidate) < pathEtx(best)){
+            best = candidate;
+        }
+    }
+
+    return best;
+}
+
+void CTP::setParent(const CTPCandidate_t *candidate)
+{
+    m_parent_id = candidate->id;
+    m_distance = candidate->distance + 1 < INVALID_DISTANCE ? candidate->distance + 1 : INVALID_DISTANCE;
+    m_etx = pathEtx(candidate);
+
+    if(m_etx < m_tree_etx){
+        m_tree_etx = m_etx;
+    }
+}
+
+uint8_t CTP::repairParent()
+{
+    uint8_t old_distance = m_distance;
+    uint8_t beacon[CTP_BEACON_SIZE];
+    CTPCandidate_t *candidate = findCandidate(m_parent_id);
+
+    // lost parent is not a candidate anymore
+    if(candidate){
+        memset(candidate, 0, sizeof(CTPCandidate_t));
+    }
+
+    while((candidate = bestCandidate()) != NULL){
+        setParent(candidate);
+
+        // targeted beacon checks the link before messages go over it
+        createBeacon(beacon, m_parent_id);
+        if(sendWithAck(m_parent_id, beacon, sizeof(beacon))){
+            linkResult(m_parent_id, true);
+            m_repairs++;
+
+            // children have to learn the longer distance
+            if(m_distance != old_distance){
+                broadcastDistance();
+            }
+
+            return SUCCESS;
+        }
+
+        memset(candidate, 0, sizeof(CTPCandidate_t));
+    }
+
+    // no route is left, any neighbor may be the next parent
+    m_parent_id = 0;
+    m_distance = INVALID_DISTANCE;
+    m_etx = CTP_INVALID_ETX;
+    m_tree_etx = CTP_INVALID_ETX;
+
+    return FAIL;
+}
+
+bool CTP::sendWithAck(uint8_t receiver, const uint8_t *buffer, uint8_t size)
+{
+    rf12_sendNow(createHeader(receiver, MODE_DST, true), buffer, size);
+
+    return waitAck(receiver, buffer, millis() + CTP_ACK_TIMEOUT);
 }
 
 // receives distance messages until end and sets variables accordingly
 void CTP::handleDistanceMessages(uint32_t end)
 {
-    uint8_t rcvd_msg[sizeof(SPHeader_t) + 1];
+    uint8_t rcvd_msg[MAX_MSG_SIZE];
     uint8_t rcvd_msg_len;
 
     while(waitReceive(end)){
-        replyAck();
-        if(rf12_len == sizeof(SPHeader_t) + 1){
-            rcvd_msg_len = rf12_len;
-            memcpy( rcvd_msg, rf12_data, rcvd_msg_len);    
+        // acknowledgements of other messages carry their headers, they must not be taken for the messages
+        if(rf12_len > MAX_MSG_SIZE || (rf12_hdr & RF12_HDR_CTL)){
+            rf12_recvDone();
+            continue;
         }
+
+        // copy the packet before acknowledging it, the acknowledgement is sent from the receive buffer
+        rcvd_msg_len = rf12_len;
+        memcpy(rcvd_msg, (const void*) rf12_data, rcvd_msg_len);
+        replyAck();
         rf12_recvDone();
 
+        // children may converge first, their reports go up the tree already - acknowledged, the child got its
+        // acknowledgement and will not send the report again
+        if(rcvd_msg_len >= sizeof(SPHeader_t) && ((SPHeader_t*) rcvd_msg)->msgType == MSG_CTP_DONE && m_parent_id){
+            // a child whose acknowledgement was lost sends the same report again, it is acknowledged but not relayed
+            SPHeader_t *header = reinterpret_cast<SPHeader_t*>(rcvd_msg);
+            if(m_forward_dups){
+                if(m_forward_dups->seen(header->sender, header->seq)){
+                    continue;
+                }
+                m_forward_dups->add(header->sender, header->seq);
+            }
+
+            sendToParent(rcvd_msg, rcvd_msg_len);
+            continue;
+        }
+
+        if(rcvd_msg_len != CTP_BEACON_SIZE){
+            continue;
+        }
+
         update(rcvd_msg);
     }
 }
 
-// broadcasts it's distance from BS
-void CTP::broadcastDistance(){
-    if(m_distance == INVALID_DISTANCE){   // TODO use define
-        return;
-    }
-
-    uint8_t buffer[sizeof(SPHeader_t) + 1];
-
+void CTP::createBeacon(uint8_t *buffer, uint8_t receiver)
+{
     // set header
     SPHeader_t *header = reinterpret_cast<SPHeader_t*>(buffer);
     header->msgType = MSG_CTP;
     header->sender = m_node_id;
-    header->receiver = 0;
+    header->receiver = receiver;
+    header->seq = m_beacon_seq;     // neighbors count lost beacons by it, targeted beacon repeats the last one
 
-    // set distance
+    // set distance and route cost
     buffer[sizeof(SPHeader_t)] = m_distance;
+    memcpy(buffer + sizeof(SPHeader_t) + 1, &m_etx, sizeof(m_etx));
+}
+
+// broadcasts it's distance from BS
+void CTP::broadcastDistance(){
+    if(m_distance == INVALID_DISTANCE){   // TODO use define
+        return;
+    }
+
+    uint8_t buffer[CTP_BEACON_SIZE];
+    m_beacon_seq++;
+    createBeacon(buffer, 0);
 
     // send
     uint8_t rf12_header = createHeader(0, MODE_SRC, m_req_ack);
-    rf12_sendNow(rf12_header, buffer, sizeof(SPHeader_t) + 1);
+    rf12_sendNow(rf12_header, buffer, CTP_BEACON_SIZE);
+    m_beacons++;
 }
 
 // routing table establishment phase main function for non-BS nodes
 uint8_t CTP::startCTP(uint32_t duration)
 {
     uint32_t start = millis();
-    uint32_t ms;
+    uint32_t end = start + duration;
 
-    while((ms = millis()) < start + duration){
-        // handle distance messages for half a second
-        handleDistanceMessages(ms + 500);
+    m_beacons = 0;
+    m_convergence_time = 0;
 
-        // broadcast own distance
-        broadcastDistance();
-        // TODO ?
+    // beacons are sent by the Trickle timer, dense neighborhoods send only a few of them per interval
+    m_trickle.start(start);
+    while(millis() < end){
+        // handle distance messages until the next timer event
+        uint32_t event = m_trickle.nextEvent();
+        handleDistanceMessages(event < end ? event : end);
+
+        uint8_t rval = m_trickle.poll(millis());
+        if(rval == TRICKLE_TRANSMIT){
+            broadcastDistance();
+        }
 
-        // if there is time left (should be), continue receiving distance messages
-        handleDistanceMessages(ms + 500);
+        // the whole interval ramp passed without a change, neighbors know the distance
+        if(rval == TRICKLE_EXPIRED && m_distance < INVALID_DISTANCE && m_parent_id){
+            m_convergence_time = millis() - start;
+            break;
+        }
     }
 
     if(m_distance >= INVALID_DISTANCE || m_parent_id == 0){
@@ -171,6 +450,39 @@ uint8_t CTP::startCTP(uint32_t duration)
     return SUCCESS;
 }
 
+void CTP::handleBeacon(uint8_t *message, uint8_t len)
+{
+    if(len != CTP_BEACON_SIZE){
+        return;
+    }
+
+    update(message);
+}
+
+uint8_t CTP::sendToParent(const uint8_t *buffer, uint8_t size)
+{
+    // every repair removes a candidate, the loop ends
+    while(m_parent_id){
+        for(uint8_t i = 0; i < CTP_SEND_RETRIES; i++){
+            if(sendWithAck(m_parent_id, buffer, size)){
+                linkResult(m_parent_id, true);
+                return SUCCESS;
+            }
+            linkResult(m_parent_id, false);
+
+            // the parent may have been busy with a sibling's message, retrying at once would hit it again
+            delay(random(CTP_RETRY_BACKOFF));
+        }
+
+        // parent is gone, switch locally instead of waiting for a new establishment
+        if(repairParent() != SUCCESS){
+            return FAIL;
+        }
+    }
+
+    return FAIL;
+}
+
 // void CTP::send(uint8_t *buffer, uint8_t length)
 // {
 //     uint8_t header = createHeader(m_parent_id, MODE_DST, m_req_ack);
@@ -182,4 +494,29 @@ uint8_t CTP::getParentID()
     return m_parent_id;
 }
 
+uint8_t CTP::getDistance()
+{
+    return m_distance;
+}
+
+uint16_t CTP::getBeaconCount()
+{
+    return m_beacons;
+}
+
+uint32_t CTP::getConvergenceTime()
+{
+    return m_convergence_time;
+}
+
+uint16_t CTP::getRepairCount()
+{
+    return m_repairs;
+}
+
+uint16_t CTP::getPathETX()
+{
+    return m_etx;
+}
+
 #endif
@@ -14,6 +14,13 @@
 
 // #undef __linux__ // TODO!!! REMOVE - just for syntax highlighting in VS Code
 
+#ifdef __linux__
+#include "EventLoop.h"
+#else
+#include "DuplicateCache.h"
+#include "Trickle.h"
+#endif
+
 #ifdef __linux__
 
 /**
@@ -22,17 +29,60 @@
  */
 class CTP {
 private:
-    int m_slave_fd; // file descriptor of slave serial device
+    EventLoop   *m_loop;                        // event loop serving the slave device
+    uint8_t     m_device;                       // slave device in m_loop
+    uint8_t     m_message[CTP_BEACON_SIZE];     // distance message
+    uint8_t     m_sent;                         // number of distance messages sent
+    uint8_t     m_result;                       // SUCCESS or FAIL if the slave failed to send a message
+    bool        m_active;                       // CTP establishment is running
+    uint32_t    m_timer_id;                     // timer of the next rebroadcast
+    uint32_t    m_expected;                     // nodes (bits by ID) that have to report convergence, 0 to wait for the whole duration
+    uint32_t    m_converged;                    // nodes that reported convergence
+
+    /**
+     * @brief Send distance message and schedule the next one after it is confirmed by the slave
+     * 
+     */
+    void rebroadcast();
 public:
     /**
-     * @brief Set the slave file descriptor
+     * @brief Constructor
+     * 
+     */
+    CTP();
+
+    /**
+     * @brief Set the slave device
+     * 
+     * @param loop      Event loop serving the slave
+     * @param device    Device index in the loop
+     */
+    void setSlave(EventLoop *loop, uint8_t device);
+
+    /**
+     * @brief Set nodes whose convergence reports end the establishment early
+     * 
+     * @param nodes     Bits set at node IDs, 0 to always wait for the whole duration
+     */
+    void setExpected(uint32_t nodes);
+
+    /**
+     * @brief Record convergence report of a node
+     * 
+     * @param node_id   Node's ID
+     */
+    void reportConverged(uint8_t node_id);
+
+    /**
+     * @brief Get nodes that reported convergence in the last establishment
      * 
-     * @param slave_fd  File descriptor
+     * @return uint32_t Bits set at node IDs
      */
-    void setSlaveFD(int slave_fd);
+    uint32_t getConverged();
 
     /**
-     * @brief Perform CTP establishment
+     * @brief Perform CTP establishment. Runs the event loop until all expected nodes report convergence or
+     * the duration passes.
      * 
      * @param duration  Duration
      * @return uint8_t  SUCCESS or FAIL
@@ -42,6 +92,18 @@ public:
 
 #else
 
+/**
+ * @brief Neighbor that can become node's parent
+ * 
+ */
+typedef struct _CTPCandidate {
+    uint8_t id;             // neighbor's ID, 0 if the entry is empty
+    uint8_t distance;       // distance advertised by the neighbor
+    uint16_t etx;           // route cost advertised by the neighbor
+    uint8_t seq;            // sequence number of the last beacon heard from the neighbor
+    uint8_t quality;        // delivery ratio estimate, 0-255, from beacon reception and acknowledgements
+} CTPCandidate_t;
+
 /**
  * @brief CTP class
  * 
@@ -52,16 +114,102 @@ private:
     uint8_t m_parent_id;    // parent's ID
     uint8_t m_distance;     // shortest distance
     uint8_t m_req_ack;      // true if communication requires acknowledgements, false otherwise
+    TrickleTimer m_trickle; // schedules distance beacons
+    uint16_t m_beacons;     // beacons sent in the last establishment
+    uint32_t m_convergence_time;    // time from the start to convergence, 0 if the node did not converge
+    CTPCandidate_t m_candidates[CTP_CANDIDATES];    // neighbors heard during beaconing, parent is one of them
+    uint16_t m_repairs;     // parent switches after the parent stopped acknowledging
+    uint16_t m_etx;         // route cost - expected transmissions to BS in CTP_ETX_UNIT
+    uint16_t m_tree_etx;    // lowest route cost the node had, neighbors advertising more may be its descendants
+    uint8_t m_beacon_seq;   // sequence number of the last broadcasted beacon
+    DuplicateCache *m_forward_dups; // messages already forwarded to BS, shared with ProtectLayer, NULL if not set
 
     /**
-     * @brief Update distance and parent
+     * @brief Update the neighbor's entry and switch to a parent with clearly lower route cost. A route change resets
+     * the beacon timer and the same distance counts as a redundant beacon.
      * 
      * @param message   Message content
      */
     void update(uint8_t *message);
 
     /**
-     * @brief Wait for distance messages and handle them
+     * @brief Record route advertised by a neighbor and update its link quality by lost beacons, the entry with
+     * the most expensive route is replaced when the table is full
+     * 
+     * @param id                Neighbor's ID
+     * @param distance          Advertised distance
+     * @param etx               Advertised route cost
+     * @param seq               Beacon sequence number
+     * @return CTPCandidate_t*  Neighbor's entry, NULL if it did not fit into the table
+     */
+    CTPCandidate_t *updateCandidate(uint8_t id, uint8_t distance, uint16_t etx, uint8_t seq);
+
+    /**
+     * @brief Find the neighbor in the candidate table
+     * 
+     * @param id                Neighbor's ID
+     * @return CTPCandidate_t*  Entry or NULL if the neighbor is not in the table
+     */
+    CTPCandidate_t *findCandidate(uint8_t id);
+
+    /**
+     * @brief Adjust link quality of a neighbor by the result of a transmission
+     * 
+     * @param id        Neighbor's ID
+     * @param acked     Transmission was acknowledged
+     */
+    void linkResult(uint8_t id, bool acked);
+
+    /**
+     * @brief Compute route cost through a neighbor - its advertised cost plus expected transmissions over the link
+     * 
+     * @param candidate Neighbor's entry
+     * @return uint16_t Route cost, CTP_INVALID_ETX if the link is unusable
+     */
+    uint16_t pathEtx(const CTPCandidate_t *candidate);
+
+    /**
+     * @brief Find the candidate with the lowest route cost, candidates that may be descendants are skipped
+     * 
+     * @return CTPCandidate_t*  Best candidate or NULL if there is none
+     */
+    CTPCandidate_t *bestCandidate();
+
+    /**
+     * @brief Make the candidate the parent and take over its route
+     * 
+     * @param candidate Candidate's entry
+     */
+    void setParent(const CTPCandidate_t *candidate);
+
+    /**
+     * @brief Drop the unresponsive parent and switch to the next best candidate that acknowledges a beacon.
+     * 
+     * @return uint8_t  SUCCESS or FAIL if no candidate is left, the node has no parent then
+     */
+    uint8_t repairParent();
+
+    /**
+     * @brief Send message to a neighbor and wait for the acknowledgement
+     * 
+     * @param receiver  Neighbor's ID
+     * @param buffer    Message
+     * @param size      Message size
+     * @return true     Acknowledged
+     * @return false    Otherwise
+     */
+    bool sendWithAck(uint8_t receiver, const uint8_t *buffer, uint8_t size);
+
+    /**
+     * @brief Fill distance beacon
+     * 
+     * @param buffer    Output, SPHEADER_SIZE + 1 bytes
+     * @param receiver  Receiver's ID, 0 for broadcast
+     */
+    void createBeacon(uint8_t *buffer, uint8_t receiver);
+
+    /**
+     * @brief Wait for distance messages and handle them, convergence reports of other nodes are relayed to the parent
      * 
      * @param end   Termination time
      */
@@ -87,12 +235,39 @@ public:
     void setNodeID(uint8_t node_id);
 
     /**
-     * @brief Start CTP establishment
+     * @brief Set cache of messages already forwarded to BS, convergence reports relayed during the establishment
+     * are recorded in it
      * 
-     * @param duration  Duration
+     * @param forward_dups  Cache shared with forwarding of received messages
+     */
+    void setForwardCache(DuplicateCache *forward_dups);
+
+    /**
+     * @brief Start CTP establishment. Ends early when the node converges - its distance is known and beacon timer
+     * reached the longest interval without any change.
+     * 
+     * @param duration  Maximum duration
      * @return uint8_t  SUCCESS or FAIL
      */
     uint8_t startCTP(uint32_t duration);
+
+    /**
+     * @brief Handle distance beacon received after the establishment, keeps the candidate table up to date
+     * 
+     * @param message   Message content
+     * @param len       Message size
+     */
+    void handleBeacon(uint8_t *message, uint8_t len);
+
+    /**
+     * @brief Send message to the parent. When the parent does not acknowledge CTP_SEND_RETRIES attempts, the node
+     * switches to the next best candidate and retries.
+     * 
+     * @param buffer    Message
+     * @param size      Message size
+     * @return uint8_t  SUCCESS or FAIL if no parent acknowledged it
+     */
+    uint8_t sendToParent(const uint8_t *buffer, uint8_t size);
     
     // void send(uint8_t *buffer, uint8_t length);
 
@@ -102,6 +277,41 @@ public:
      * @return uint8_t  Parent's ID
      */
     uint8_t getParentID();
+
+    /**
+     * @brief Get distance from BS
+     * 
+     * @return uint8_t  Distance, INVALID_DISTANCE if unknown
+     */
+    uint8_t getDistance();
+
+    /**
+     * @brief Get number of beacons sent in the last establishment
+     * 
+     * @return uint16_t Number of beacons
+     */
+    uint16_t getBeaconCount();
+
+    /**
+     * @brief Get time the node needed to converge in the last establishment
+     * 
+     * @return uint32_t Time in milliseconds, 0 if it did not converge
+     */
+    uint32_t getConvergenceTime();
+
+    /**
+     * @brief Get number of parent switches caused by a lost parent
+     * 
+     * @return uint16_t Number of switches
+     */
+    uint16_t getRepairCount();
+
+    /**
+     * @brief Get route cost to BS
+     * 
+     * @return uint16_t Expected transmissions in CTP_ETX_UNIT, CTP_INVALID_ETX if there is no route
+     */
+    uint16_t getPathETX();
 };
 
 #endif
@@ -32,9 +32,18 @@
 
 #include <string.h>
 
+// counter block for CTR mode - counter value in little endian, rest of the block stays zero
+static inline void setCounterBlock(uint8_t *block, uint32_t counter)
+{
+    block[0] = counter;
+    block[1] = counter >> 8;
+    block[2] = counter >> 16;
+    block[3] = counter >> 24;
+}
+
 
 Crypto::Crypto(Cipher *cipher, MAC *mac, Hash *hash, KeyDistrib *keydistrib):
-m_cipher(cipher), m_mac(mac), m_hash(hash), m_keydistrib(keydistrib), m_key1(NULL), m_exp(expanded_key)
+m_cipher(cipher), m_mac(mac), m_hash(hash), m_keydistrib(keydistrib)
 {
 
 }
@@ -48,58 +57,72 @@ m_cipher(cipher), m_mac(mac), m_hash(hash), m_keydistrib(keydistrib), m_key1(NUL
 uint8_t Crypto::protectBufferForNodeB(node_id_t nodeID, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;
+    PL_key_t* key;
 
-    if((status = m_keydistrib->getKeyToNodeB(nodeID, &m_key1)) != SUCCESS){
+    if((status = m_keydistrib->getKeyToNodeB(nodeID, &key)) != SUCCESS){
         return status;
     }
 
-    return protectBufferB(m_key1, buffer, offset, pLen);
+#ifdef __linux__
+    // BS threads share the counter of a node's key - e.g. sending to the node while its messages are received
+    std::lock_guard<std::mutex> lock(m_keydistrib->getKeyLock(nodeID));
+#endif
+
+    return protectBufferB(key, buffer, offset, pLen);
 }
 
 uint8_t Crypto::unprotectBufferFromNodeB(node_id_t nodeID, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;		
+    PL_key_t* key;
     
-    if((status = m_keydistrib->getKeyToNodeB(nodeID, &m_key1)) != SUCCESS){
+    if((status = m_keydistrib->getKeyToNodeB(nodeID, &key)) != SUCCESS){
         return status;
     }
 
 // // TODO! REMOVE
 // #ifdef __linux__
-//     printf("C%d: %u\n", nodeID, *m_key1->counter);
+//     printf("C%d: %u\n", nodeID, *key->counter);
 // #endif 
 
-    return unprotectBufferB(m_key1, buffer, offset, pLen);
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(m_keydistrib->getKeyLock(nodeID));
+#endif
+
+    return unprotectBufferB(key, buffer, offset, pLen);
 }
 
 uint8_t Crypto::protectBufferForBSB(uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;	
+    PL_key_t* key;
 
-    if((status = m_keydistrib->getKeyToBSB(&m_key1))!= SUCCESS){
+    if((status = m_keydistrib->getKeyToBSB(&key))!= SUCCESS){
         return status;
     }
     
-    return protectBufferB(m_key1, buffer, offset, pLen);
+    return protectBufferB(key, buffer, offset, pLen);
 }
 
 uint8_t Crypto::unprotectBufferFromBSB(uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;		
+    PL_key_t* key;
 
-    if((status = m_keydistrib->getKeyToBSB(&m_key1))!= SUCCESS){
+    if((status = m_keydistrib->getKeyToBSB(&key))!= SUCCESS){
         return status;
     }
 
-    return unprotectBufferB(m_key1, buffer, offset, pLen);
+    return unprotectBufferB(key, buffer, offset, pLen);
 }
 
 uint8_t Crypto::macBufferForNodeB(node_id_t nodeID, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;
+    PL_key_t* key;
 
-    if((status = m_keydistrib->getKeyToNodeB(nodeID, &m_key1)) == SUCCESS){
-        status = macBuffer(m_key1, buffer, offset, pLen, buffer + offset + *pLen);
+    if((status = m_keydistrib->getKeyToNodeB(nodeID, &key)) == SUCCESS){
+        status = macBuffer(key, buffer, offset, pLen, buffer + offset + *pLen);
         *pLen = *pLen + MAC_LENGTH;
     }
     
@@ -109,9 +132,10 @@ uint8_t Crypto::macBufferForNodeB(node_id_t nodeID, uint8_t* buffer, uint8_t off
 uint8_t Crypto::macBufferForBSB(uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;
+    PL_key_t* key;
 
-    if((status =  m_keydistrib->getKeyToBSB(&m_key1)) == SUCCESS){	
-        status = macBuffer(m_key1, buffer, offset, pLen, buffer + offset + *pLen);
+    if((status =  m_keydistrib->getKeyToBSB(&key)) == SUCCESS){	
+        status = macBuffer(key, buffer, offset, pLen, buffer + offset + *pLen);
         *pLen = *pLen + MAC_LENGTH; // TODO MAC_LENGTH => m_mac->macSize() everywhere
     }
     
@@ -121,23 +145,25 @@ uint8_t Crypto::macBufferForBSB(uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 uint8_t Crypto::verifyMacFromNodeB(node_id_t nodeID, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;        
+    PL_key_t* key;
         
-    if((status = m_keydistrib->getKeyToNodeB(nodeID, &m_key1)) != SUCCESS){
+    if((status = m_keydistrib->getKeyToNodeB(nodeID, &key)) != SUCCESS){
         return FAIL;
     }
     
-    return verifyMac(m_key1, buffer,  offset, pLen);
+    return verifyMac(key, buffer,  offset, pLen);
 }
 
 uint8_t Crypto::verifyMacFromBSB(uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;        
+    PL_key_t* key;
         
-    if((status = m_keydistrib->getKeyToBSB(&m_key1)) != SUCCESS){
+    if((status = m_keydistrib->getKeyToBSB(&key)) != SUCCESS){
         return status;
     }
 
-    return verifyMac(m_key1, buffer,  offset, pLen);
+    return verifyMac(key, buffer,  offset, pLen);
 }
 
 uint8_t Crypto::hashDataB(uint8_t* buffer, uint8_t offset, uint8_t len, uint8_t* hash)
@@ -196,17 +222,28 @@ uint8_t Crypto::verifyHashDataShortB(uint8_t* buffer, uint8_t offset, uint8_t pL
 //	CryptoRaw interface
 //	
 
+uint8_t *Crypto::getExpandedKey(PL_key_t* key)
+{
+    //key table on BS holds expanded keys, nodes use the cache
+    if(key->expKey != NULL){
+        return key->expKey;
+    }
+
+    return aes_key_cache.getExpandedKey(m_cipher, key->keyID, key->keyValue);
+}
+
 uint8_t Crypto::encryptBufferB(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t len)
 {
     uint8_t i;
     uint8_t j;
     uint8_t plainCounter[BLOCK_SIZE];			
     uint8_t encCounter[BLOCK_SIZE];
+    uint8_t *exp_key;
 
     //set rest of counter to zeros to fit AES block
     memset(plainCounter, 0, BLOCK_SIZE);	
     
-    m_cipher->keyExpansion(m_exp, (uint8_t*) key->keyValue);
+    exp_key = getExpandedKey(key);
 
     //process buffer by blocks 
     for(i = 0; i < (len / BLOCK_SIZE) + 1; i++){        
@@ -214,7 +251,7 @@ uint8_t Crypto::encryptBufferB(PL_key_t* key, uint8_t* buffer, uint8_t offset, u
         plainCounter[1] =  (*(key->counter)) >> 8;
         plainCounter[2] =  (*(key->counter)) >> 16;
         plainCounter[3] =  (*(key->counter)) >> 24;
-        m_cipher->encrypt(plainCounter, m_exp, encCounter);
+        m_cipher->encrypt(plainCounter, exp_key, encCounter);
         
         for (j = 0; j < BLOCK_SIZE; j++){
             if (i*BLOCK_SIZE + j >= len){
@@ -238,7 +275,7 @@ uint8_t Crypto::decryptBufferB(PL_key_t* key, uint8_t* buffer, uint8_t offset, u
 
 uint8_t Crypto::macBuffer(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac)
 {
-    return m_mac->macBuffer(key->keyValue, buffer, offset, pLen, mac);
+    return m_mac->macBuffer(key->keyValue, buffer, offset, pLen, mac, key->keyID);
 }
 
 uint8_t Crypto::verifyMac(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
@@ -284,8 +321,7 @@ uint8_t Crypto::deriveKeyB(PL_key_t* masterKey, uint8_t* derivationData, uint8_t
         return FAIL;	    
     }
     
-    m_cipher->keyExpansion(m_exp, (uint8_t*)(masterKey->keyValue));
-    m_cipher->encrypt(derivationData + offset, m_exp, (uint8_t*)(derivedKey->keyValue));
+    m_cipher->encrypt(derivationData + offset, getExpandedKey(masterKey), (uint8_t*)(derivedKey->keyValue));
     
     return SUCCESS;
 }
@@ -298,61 +334,191 @@ uint8_t Crypto::hashDataBlockB(uint8_t* buffer, uint8_t offset, PL_key_t* key, u
 
 uint8_t Crypto::protectBufferB(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
-    uint8_t status = SUCCESS;
+    uint8_t i;
+    uint8_t j;
+    uint8_t len = *pLen;
+    uint8_t blocks = (len / BLOCK_SIZE) + 1;    // number of blocks processed by both CBC-MAC and CTR
+    uint8_t lag = (offset / BLOCK_SIZE) + 1;    // CTR block 'i' overwrites plaintext of MAC blocks up to 'i + lag - 1'
+    uint8_t ctr_block;
+    uint16_t pos;
+    uint8_t mac[BLOCK_SIZE];
+    uint8_t plainCounter[BLOCK_SIZE];
+    uint8_t encCounter[BLOCK_SIZE];
+    uint8_t *exp_key;
 
-    //offset is used for encryption shift, to mac, but not encrypt SPheader
-    if((status = macBuffer(key, buffer, 0, pLen, buffer + *pLen)) != SUCCESS){
-        return status;
+    //counter hint for the receiver, included in mac but not encrypted
+    if(offset >= SPHEADER_SIZE){
+        reinterpret_cast<SPHeader_t*>(buffer)->seq = *(key->counter);
     }
 
-    if((status = encryptBufferB(key, buffer, offset, *pLen)) != SUCCESS){
-        return status;		
+    exp_key = getExpandedKey(key);
+
+    //mac is computed over whole buffer including SPheader, first block of data is the initial value
+    memset(mac, 0, BLOCK_SIZE);
+    memcpy(mac, buffer, len < BLOCK_SIZE ? len : BLOCK_SIZE);
+    memset(plainCounter, 0, BLOCK_SIZE);
+
+    //single pass over the buffer, CTR encryption follows CBC-MAC 'lag' blocks behind,
+    //so every block is included in mac before it is encrypted
+    for(i = 0; i < blocks + lag; i++){
+        if(i >= lag){
+            setCounterBlock(plainCounter, *(key->counter));
+        }
+
+        if(i < blocks && i >= lag){
+            m_cipher->encrypt2(mac, plainCounter, exp_key, mac, encCounter);    // independent, can be pipelined
+        } else if(i < blocks){
+            m_cipher->encrypt(mac, exp_key, mac);
+        } else {
+            m_cipher->encrypt(plainCounter, exp_key, encCounter);
+        }
+
+        if(i < blocks){
+            for(j = 0; j < BLOCK_SIZE; j++){
+                pos = i * BLOCK_SIZE + j;
+                if(pos >= len){
+                    break;
+                }
+                mac[j] ^= buffer[pos];
+            }
+            //append mac before CTR reaches it, offset is used for encryption shift, part of the mac gets encrypted
+            if(i == blocks - 1){
+                memcpy(buffer + len, mac, MAC_LENGTH);
+            }
+        }
+
+        if(i >= lag){
+            ctr_block = i - lag;
+            for(j = 0; j < BLOCK_SIZE; j++){
+                pos = ctr_block * BLOCK_SIZE + j;
+                if(pos >= len){
+                    break;
+                }
+                buffer[offset + pos] ^= encCounter[j];
+            }
+            (*(key->counter))++;
+        }
     }
 
     *pLen += m_mac->macSize();   // TODO correct?
     
-    return status;
+    return SUCCESS;
+}
+
+uint8_t Crypto::decryptVerifyB(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t len)
+{
+    uint8_t i;
+    uint8_t j;
+    uint8_t blocks = (len / BLOCK_SIZE) + 1;    // number of blocks processed by both CTR and CBC-MAC
+    uint16_t pos;
+    uint8_t mac[BLOCK_SIZE];
+    uint8_t plainCounter[BLOCK_SIZE];
+    uint8_t encCounter[BLOCK_SIZE];
+    uint8_t *exp_key;
+
+    exp_key = getExpandedKey(key);
+    memset(plainCounter, 0, BLOCK_SIZE);
+
+    //CTR runs one block ahead of CBC-MAC, the first block has to be decrypted before mac starts
+    setCounterBlock(plainCounter, *(key->counter));
+    m_cipher->encrypt(plainCounter, exp_key, encCounter);
+
+    for(i = 0; i < blocks; i++){
+        for(j = 0; j < BLOCK_SIZE; j++){
+            pos = i * BLOCK_SIZE + j;
+            if(pos >= len){
+                break;
+            }
+            buffer[offset + pos] ^= encCounter[j];
+        }
+        (*(key->counter))++;
+
+        if(i == 0){
+            memset(mac, 0, BLOCK_SIZE);
+            memcpy(mac, buffer, len < BLOCK_SIZE ? len : BLOCK_SIZE);
+        }
+
+        if(i + 1 < blocks){
+            setCounterBlock(plainCounter, *(key->counter));
+            m_cipher->encrypt2(mac, plainCounter, exp_key, mac, encCounter);    // independent, can be pipelined
+        } else {
+            m_cipher->encrypt(mac, exp_key, mac);
+        }
+
+        //block 'i' is already decrypted, offset only shifts CTR towards the end of the buffer
+        for(j = 0; j < BLOCK_SIZE; j++){
+            pos = i * BLOCK_SIZE + j;
+            if(pos >= len){
+                break;
+            }
+            mac[j] ^= buffer[pos];
+        }
+    }
+
+    if(memcmp(mac, buffer + len, MAC_LENGTH) != 0){
+        return EWRONGMAC;
+    }
+
+    return SUCCESS;
 }
 
 uint8_t Crypto::unprotectBufferB(PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t* pLen)
 {
     uint8_t status = SUCCESS;
     uint8_t i;
+    uint8_t len;
     uint32_t counter = *(key->counter);
-    uint8_t buffer_copy[MAX_MSG_SIZE];
+    uint32_t attempt;
+    int8_t diff;
 
     if(*pLen > MAX_MSG_SIZE){
         return FAIL;
     }
 
-    memcpy(buffer_copy, buffer, *pLen);
-
     if(*pLen < m_mac->macSize()){
         return FAIL;
     }
 
-    //offset is used for encryption shift, to verify SPheader, but not to encrypt it
-    // if((status = decryptBufferB(key, buffer, offset, *pLen) != SUCCESS){
-    if((status = decryptBufferB(key, buffer, offset, *pLen - m_mac->macSize())) != SUCCESS){
+    len = *pLen - m_mac->macSize();
+
+    //sender's counter is known from the hint in the header, no need to search for it
+    if(offset >= SPHEADER_SIZE){
+        diff = (int8_t) (reinterpret_cast<SPHeader_t*>(buffer)->seq - (uint8_t) counter);
+        if(diff > COUNTER_SYNCHRONIZATION_WINDOW || diff < -COUNTER_SYNCHRONIZATION_WINDOW){
+            return EWRONGMAC;
+        }
+
+        *(key->counter) = counter + diff;
+        if((status = decryptVerifyB(key, buffer, offset, len)) != SUCCESS){
+            *(key->counter) = counter;
+        }
         return status;
     }
 
-    if((status = verifyMac(key, buffer, 0, pLen)) != SUCCESS){            
-        for (i = 1; i <= COUNTER_SYNCHRONIZATION_WINDOW; i++){    
-memcpy(buffer, buffer_copy, *pLen);
-            *(key->counter) = counter - i;
-            decryptBufferB(key, buffer, offset, *pLen - m_mac->macSize());
-            if((status = verifyMac(key, buffer, 0, pLen)) == SUCCESS){
+    //offset is used for encryption shift, to verify SPheader, but not to encrypt it
+    if((status = decryptVerifyB(key, buffer, offset, len)) != SUCCESS){
+        //CTR is an involution, so the received data are restored by encrypting them again
+        //with the counter of the failed attempt instead of keeping a copy of the buffer
+        attempt = counter;
+        for (i = 1; i <= COUNTER_SYNCHRONIZATION_WINDOW; i++){
+            *(key->counter) = attempt;
+            encryptBufferB(key, buffer, offset, len);
+            attempt = counter - i;
+            *(key->counter) = attempt;
+            if((status = decryptVerifyB(key, buffer, offset, len)) == SUCCESS){
                 return status;
             }
     
-memcpy(buffer, buffer_copy, *pLen);
-            *(key->counter) = counter + i;
-            decryptBufferB(key, buffer, offset, *pLen - m_mac->macSize());
-            if((status = verifyMac(key, buffer, 0, pLen)) == SUCCESS){
+            *(key->counter) = attempt;
+            encryptBufferB(key, buffer, offset, len);
+            attempt = counter + i;
+            *(key->counter) = attempt;
+            if((status = decryptVerifyB(key, buffer, offset, len)) == SUCCESS){
                 return status;
             }
         }
+        *(key->counter) = attempt;
+        encryptBufferB(key, buffer, offset, len);
         *(key->counter) = counter;
         return status;
     }
@@ -49,9 +49,16 @@
 #endif
 
 #define MAX_OFFSET						20
+
+// maximal difference between the local and the received counter value that is accepted
+#ifndef COUNTER_SYNCHRONIZATION_WINDOW
 #define COUNTER_SYNCHRONIZATION_WINDOW	5
+#endif
 
-extern uint8_t expanded_key[240]; //expanded key
+// received counter is reconstructed from its lowest byte carried in SPHeader_t
+#if COUNTER_SYNCHRONIZATION_WINDOW > 127
+#error "COUNTER_SYNCHRONIZATION_WINDOW must fit into the counter hint in SPHeader_t"
+#endif
 
 enum { EWRONGHASH = 5, EWRONGMAC };
 
@@ -60,9 +67,6 @@ class Crypto {
     MAC         *m_mac;
     Hash        *m_hash;
     KeyDistrib  *m_keydistrib;
-
-	PL_key_t 	*m_key1;
-	uint8_t     *m_exp; //expanded key
 public:
     Crypto(Cipher *cipher, MAC *mac, Hash *hash, KeyDistrib *keydistrib);
 
@@ -238,6 +242,13 @@ public:
 
 private:
 
+	/**
+		Command: Get expanded key, either precomputed one or from the cache.
+		@param[in] key handle to the key
+		@return uint8_t* expanded key
+	*/
+	uint8_t *getExpandedKey(PL_key_t* key);
+
 	/**
 		Command: Blocking version. Used by other components to start encryption of supplied buffer by supplied key.
 		Enough additional space in buffer to fit encrypted content is assumed.
@@ -310,7 +321,9 @@ private:
 		Command: Used by Crypto component as inner function for mac calculation and encryption of buffer.
 		mac is appended to the buffer, so additional space of MAC_LENGTH is required.
 		offset can be used for shift of encryption, therefore mac will be calculated from whole payload including header
-		but header will stay unecrypted. Mac is calculated first and then is encrypted payload including mac.
+		but header will stay unecrypted. Mac and encryption are computed in a single pass, encryption follows
+		mac calculation, so the result is the same as if the payload including mac was encrypted afterwards.
+		If the unencrypted part contains SPHeader_t, lowest byte of the counter is stored into it as a hint for the receiver.
 		@param[in] key handle for key fro encryption and mac calculation
 		@param[in out] buffer with original data
 		@param[in] offset of encryption
@@ -321,7 +334,9 @@ private:
 	
 	/**
 		Command: Used by Crypto component as inner function for mac verification and decryption of buffer.
-		buffer if first decrypted and then if verified mac. If mac does not match, attempt is made to 
+		buffer if first decrypted and then if verified mac. If the unencrypted part contains SPHeader_t,
+		sender's counter is reconstructed from the hint in the header and only a single attempt is made
+		if it is in range of COUNTER_SYNCHRONIZATION_WINDOW. Otherwise, if mac does not match, attempt is made to 
 		synchronize counter value in range of COUNTER_SYNCHRONIZATION_WINDOW. If synchronization is 
 		succesfull, counter is updated to right value. Offset is used to specifie ecryption offset used.
 		(i.e. header is not encrypted, but included in mac calculation)
@@ -332,6 +347,18 @@ private:
 		@return error_t status
 	*/
 	uint8_t unprotectBufferB( PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t* pLen);
+
+	/**
+		Command: Used by Crypto component as inner function for single pass decryption and mac verification.
+		CTR decryption runs one block ahead of CBC-MAC, so the buffer is read only once.
+		Counter is advanced even if mac does not match.
+		@param[in] key handle for key for decryption and mac verification
+		@param[in out] buffer with received data, mac is expected right after len bytes
+		@param[in] offset of encryption
+		@param[in] len length of data in buffer without mac
+		@return error_t status
+	*/
+	uint8_t decryptVerifyB( PL_key_t* key, uint8_t* buffer, uint8_t offset, uint8_t len);
 };
 
 #endif //  CRYPTO_H
\ No newline at end of file
@@ -0,0 +1,112 @@
+/**
+ * @brief Implementation of the duplicate message cache
+ *
+ * @file    DuplicateCache.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include "DuplicateCache.h"
+
+#include <string.h>
+
+#include "common.h"
+
+DuplicateCache::DuplicateCache(): m_duplicates(0)
+{
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+DupEntry_t *DuplicateCache::find(uint8_t source)
+{
+    for(uint8_t i=0;i<DUP_CACHE_SOURCES;i++){
+        if(m_entries[i].source == source){
+            if((uint32_t) millis() - m_entries[i].last_seen > DUP_CACHE_TIMEOUT){
+                return NULL;
+            }
+            return &m_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool DuplicateCache::seen(uint8_t source, uint8_t seq)
+{
+    DupEntry_t *entry = find(source);
+    if(!entry){
+        return false;
+    }
+
+    // newer than anything seen
+    int8_t diff = (int8_t) (seq - entry->newest);
+    if(diff > 0){
+        return false;
+    }
+
+    // far behind the window - the source restarted its sequence
+    if(-diff >= DUP_WINDOW){
+        return false;
+    }
+
+    if(entry->window & ((uint32_t) 1 << -diff)){
+        m_duplicates++;
+        return true;
+    }
+
+    return false;
+}
+
+void DuplicateCache::add(uint8_t source, uint8_t seq)
+{
+    uint32_t now = (uint32_t) millis();
+    DupEntry_t *entry = find(source);
+
+    if(!entry){
+        // reuse the expired entry of the source or replace the least recently heard one
+        entry = &m_entries[0];
+        for(uint8_t i=0;i<DUP_CACHE_SOURCES;i++){
+            if(m_entries[i].source == source || !m_entries[i].source){
+                entry = &m_entries[i];
+                break;
+            }
+            if(now - m_entries[i].last_seen > now - entry->last_seen){
+                entry = &m_entries[i];
+            }
+        }
+
+        entry->source = source;
+        entry->newest = seq;
+        entry->window = 1;
+        entry->last_seen = now;
+        return;
+    }
+
+    int8_t diff = (int8_t) (seq - entry->newest);
+    if(diff > 0){
+        // slide the window to the new sequence number
+        entry->window = diff >= DUP_WINDOW ? 1 : (entry->window << diff) | 1;
+        entry->newest = seq;
+    } else if(-diff < DUP_WINDOW){
+        entry->window |= (uint32_t) 1 << -diff;
+    } else {
+        entry->window = 1;
+        entry->newest = seq;
+    }
+    entry->last_seen = now;
+}
+
+void DuplicateCache::addDelayed(uint8_t source, uint8_t seq)
+{
+    DupEntry_t *entry = find(source);
+
+    // nothing newer is tracked or the number still falls into the window
+    if(!entry || (int8_t) (seq - entry->newest) > -DUP_WINDOW){
+        add(source, seq);
+    }
+}
+
+uint16_t DuplicateCache::getDuplicates()
+{
+    return m_duplicates;
+}
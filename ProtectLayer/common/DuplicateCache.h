@@ -0,0 +1,101 @@
+/**
+ * @brief Detection of duplicate flooded and relayed messages by per-source sequence numbers
+ *
+ * @file    DuplicateCache.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef DUPLICATECACHE_H
+#define DUPLICATECACHE_H
+
+#include <stdint.h>
+
+#include "ProtectLayerGlobals.h"
+
+// number of sources tracked at once, the least recently heard one is replaced
+#ifndef DUP_CACHE_SOURCES
+#define DUP_CACHE_SOURCES   4
+#endif
+
+#define DUP_WINDOW          32      // sequence numbers remembered behind the newest one, bits of the window
+
+// a source silent for this long starts over - it may have restarted with a new sequence
+#ifndef DUP_CACHE_TIMEOUT
+#define DUP_CACHE_TIMEOUT   (3 * UTESLA_KEY_VALID_PERIOD)
+#endif
+
+/**
+ * @brief Sliding window of sequence numbers of a single source
+ *
+ */
+typedef struct DupEntry {
+    uint8_t     source;                 // node ID, 0 if the entry is empty
+    uint8_t     newest;                 // highest sequence number seen
+    uint32_t    window;                 // bit i is set if newest - i was seen
+    uint32_t    last_seen;              // time of the last new message
+} DupEntry_t;
+
+/**
+ * @brief Cache of recently seen (source, sequence number) pairs. Sequence numbers are 8-bit and compared in
+ * serial number arithmetic. A message at least DUP_WINDOW numbers behind the newest one means the source restarted
+ * its sequence, add() starts the window over from it. addDelayed() ignores such a number, it is stale.
+ *
+ */
+class DuplicateCache {
+private:
+    DupEntry_t  m_entries[DUP_CACHE_SOURCES];   // tracked sources
+    uint16_t    m_duplicates;                   // number of duplicates detected
+
+    /**
+     * @brief Find entry of the source
+     *
+     * @param source        Node ID
+     * @return DupEntry_t*  Entry or NULL if the source is not tracked or its entry expired
+     */
+    DupEntry_t *find(uint8_t source);
+
+public:
+    /**
+     * @brief Constructor
+     *
+     */
+    DuplicateCache();
+
+    /**
+     * @brief Check whether the message was already seen, counts duplicates
+     *
+     * @param source    Original sender of the message
+     * @param seq       Sequence number of the message
+     * @return true     Message is a duplicate
+     * @return false    Message is new
+     */
+    bool seen(uint8_t source, uint8_t seq);
+
+    /**
+     * @brief Record the message as seen
+     *
+     * @param source    Original sender of the message
+     * @param seq       Sequence number of the message
+     */
+    void add(uint8_t source, uint8_t seq);
+
+    /**
+     * @brief Record a message that was held back before it was accepted, e.g. until it was authenticated. Newer
+     * messages of the source may have been recorded meanwhile, so a sequence number behind the window is stale and
+     * ignored instead of restarting the window.
+     *
+     * @param source    Original sender of the message
+     * @param seq       Sequence number of the message
+     */
+    void addDelayed(uint8_t source, uint8_t seq);
+
+    /**
+     * @brief Get number of detected duplicates
+     *
+     * @return uint16_t Number of duplicates
+     */
+    uint16_t getDuplicates();
+};
+
+#endif // DUPLICATECACHE_H
@@ -0,0 +1,539 @@
+/**
+ * @brief Implementation of the event loop of the Linux base station
+ *
+ * @file    EventLoop.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "EventLoop.h"
+#include "common.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define EVENT_TIMER     0x100   // epoll tag of timerfd, devices use their index
+#define EVENT_WAKE      0x101   // epoll tag of eventfd
+#define MAX_EVENTS      16      // events processed by a single epoll_wait()
+#define READ_BUFFER_SIZE 1024   // bytes read from a slave at once
+
+
+EventLoop::EventLoop(): m_next_timer_id(1), m_running(false), m_dispatching(false)
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+
+    bool created = m_epoll_fd >= 0 && m_timer_fd >= 0 && m_wake_fd >= 0;
+    if(created){
+        event.data.u32 = EVENT_TIMER;
+        created = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &event) == 0;
+    }
+    if(created){
+        event.data.u32 = EVENT_WAKE;
+        created = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event) == 0;
+    }
+
+    if(!created){
+        closeAll();
+        throw std::runtime_error("Failed to create event loop");
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    closeAll();
+}
+
+void EventLoop::closeAll()
+{
+    // devices belong to their owners, only the loop's descriptors are closed
+    if(m_epoll_fd >= 0){
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    if(m_timer_fd >= 0){
+        close(m_timer_fd);
+        m_timer_fd = -1;
+    }
+    if(m_wake_fd >= 0){
+        close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+}
+
+uint64_t EventLoop::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int EventLoop::addDevice(int fd, uint8_t window)
+{
+    if(fd < 0 || !window || m_devices.size() >= UINT8_MAX){
+        return -1;
+    }
+
+    // reads and writes never block, epoll tells when to do them
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
+        return -1;
+    }
+
+    std::unique_ptr<Device> device(new Device);
+    device->fd = fd;
+    device->sent = 0;
+    device->written = 0;
+    device->window = window;
+    device->next_seq = 0;
+    device->want_write = false;
+    device->closed = false;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = m_devices.size();
+    if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0){
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_devices.push_back(std::move(device));
+
+    return m_devices.size() - 1;
+}
+
+void EventLoop::setFrameCallback(FrameCallback callback)
+{
+    m_frame_callback = callback;
+}
+
+uint8_t EventLoop::send(uint8_t device, const uint8_t *data, uint8_t len, SendCallback callback)
+{
+    if(!data || !len || len > MAX_MSG_SIZE){
+        return FAIL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(device >= m_devices.size() || m_devices[device]->closed){
+            return FAIL;
+        }
+
+        Device &dev = *m_devices[device];
+        dev.tx.push_back(Outgoing());
+
+        // encoded right away, so it can be written in pieces
+        uint8_t record[LINK_MAX_RECORD];
+        Outgoing &msg = dev.tx.back();
+        msg.seq = dev.next_seq++;
+        record[0] = LINK_MSG;
+        record[1] = msg.seq;
+        memcpy(record + 2, data, len);
+        msg.len = linkEncode(record, len + 2, msg.data);
+        msg.deadline = 0;
+        msg.callback = callback;
+    }
+
+    // writing is done by the loop, it might be waiting in another thread
+    wakeUp();
+
+    return SUCCESS;
+}
+
+uint8_t EventLoop::sendAndWait(uint8_t device, const uint8_t *data, uint8_t len)
+{
+    // shared with the completion, it might be called after a timeout
+    std::shared_ptr<uint8_t> status = std::make_shared<uint8_t>(ERR_TIMEOUT);
+    std::shared_ptr<bool> done = std::make_shared<bool>(false);
+
+    if(m_dispatching){
+        printDebug("Blocking send from event loop callback", true);
+        return FAIL;
+    }
+
+    if(send(device, data, len, [status, done](uint8_t rval){ *status = rval; *done = true; }) != SUCCESS){
+        return FAIL;
+    }
+
+    // messages queued before this one might have to wait for their status too
+    if(!runUntil([done](){ return *done; }, 2 * SLAVE_STATUS_TIMEOUT_MS)){
+        return FAIL;
+    }
+
+    return *status == ERR_OK ? SUCCESS : FAIL;
+}
+
+uint32_t EventLoop::addTimer(uint32_t delay_ms, TimerCallback callback)
+{
+    uint32_t id;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_next_timer_id++;
+        Timer timer = { id, callback };
+        m_timers.insert(std::make_pair(now() + delay_ms, timer));
+    }
+
+    // timerfd is re-armed by the loop
+    wakeUp();
+
+    return id;
+}
+
+void EventLoop::cancelTimer(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for(auto it=m_timers.begin();it!=m_timers.end();it++){
+        if(it->second.id == id){
+            m_timers.erase(it);
+            return;
+        }
+    }
+}
+
+uint8_t EventLoop::runOnce(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    if(m_dispatching){
+        printDebug("Event loop run from its callback", true);
+        return FAIL;
+    }
+
+    int events_num = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if(events_num < 0){
+        return errno == EINTR ? SUCCESS : FAIL;
+    }
+
+    m_dispatching = true;
+
+    for(int i=0;i<events_num;i++){
+        uint32_t tag = events[i].data.u32;
+        uint64_t counter;
+
+        if(tag == EVENT_TIMER){
+            // expirations are checked by processTimers()
+            if(read(m_timer_fd, &counter, sizeof(counter)) < 0){
+                continue;
+            }
+        } else if(tag == EVENT_WAKE){
+            if(read(m_wake_fd, &counter, sizeof(counter)) < 0){
+                continue;
+            }
+        } else {
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                readDevice(tag);
+            }
+            if(events[i].events & EPOLLOUT){
+                writeDevice(tag);
+            }
+        }
+    }
+
+    // start writing messages queued since the last run
+    for(uint8_t i=0;i<m_devices.size();i++){
+        writeDevice(i);
+    }
+
+    processTimers();
+    armTimer();
+
+    m_dispatching = false;
+
+    return SUCCESS;
+}
+
+bool EventLoop::runUntil(std::function<bool()> done, uint32_t timeout_ms)
+{
+    uint64_t end = now() + timeout_ms;
+
+    while(!done()){
+        uint64_t current = now();
+        if(current >= end){
+            return false;
+        }
+
+        if(runOnce(end - current) != SUCCESS){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void EventLoop::run()
+{
+    m_running = true;
+
+    while(m_running){
+        if(runOnce(-1) != SUCCESS){
+            break;
+        }
+    }
+
+    m_running = false;
+}
+
+void EventLoop::stop()
+{
+    m_running = false;
+    wakeUp();
+}
+
+void EventLoop::readDevice(uint8_t index)
+{
+    Device &dev = *m_devices[index];
+    uint8_t buffer[READ_BUFFER_SIZE];
+    int rval;
+
+    if(dev.closed){
+        return;
+    }
+
+    while((rval = read(dev.fd, buffer, READ_BUFFER_SIZE)) > 0){
+        for(int pos=0;pos<rval;){
+            pos += dev.rx.feed(buffer + pos, rval - pos);
+
+            uint8_t *record = dev.rx.record();
+            uint8_t record_len = dev.rx.recordLen();
+            if(!record_len){
+                continue;
+            }
+
+            if(record[0] == LINK_STATUS && record_len == 3){
+                completeSend(index, record[2], record[1]);
+            } else if(record[0] == LINK_FRAME && record_len > 1 && m_frame_callback){
+                m_frame_callback(index, record + 1, record_len - 1);
+            }
+        }
+    }
+
+    if(rval == 0 || (rval < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+        printDebug("Slave device disconnected", true);
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, dev.fd, NULL);
+        failDevice(index);
+    }
+}
+
+void EventLoop::writeDevice(uint8_t index)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Device &dev = *m_devices[index];
+
+    if(dev.closed){
+        return;
+    }
+
+    // keep the slave's queue full instead of waiting for each status
+    while(dev.sent < dev.window && dev.sent < dev.tx.size()){
+        Outgoing &msg = dev.tx[dev.sent];
+        int rval = write(dev.fd, msg.data + dev.written, msg.len - dev.written);
+        if(rval < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+                setWriteInterest(index, true);
+                return;
+            }
+
+            // slave did not get the message, nor will it get anything else
+            lock.unlock();
+            printDebug("Failed to write to slave device", true);
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, dev.fd, NULL);
+            failDevice(index);
+            return;
+        }
+
+        dev.written += rval;
+        if(dev.written < msg.len){
+            setWriteInterest(index, true);
+            return;
+        }
+
+        msg.deadline = now() + SLAVE_STATUS_TIMEOUT_MS;
+        dev.sent++;
+        dev.written = 0;
+    }
+
+    setWriteInterest(index, false);
+}
+
+void EventLoop::completeSend(uint8_t index, uint8_t seq, uint8_t status)
+{
+    std::vector<SendCallback> lost;
+    SendCallback callback;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Device &dev = *m_devices[index];
+
+        // status of a message that has already timed out
+        uint8_t position = 0;
+        while(position < dev.sent && dev.tx[position].seq != seq){
+            position++;
+        }
+        if(position == dev.sent){
+            return;
+        }
+
+        for(uint8_t i=0;i<position;i++){
+            lost.push_back(dev.tx.front().callback);
+            dev.tx.pop_front();
+        }
+
+        callback = dev.tx.front().callback;
+        dev.tx.pop_front();
+        dev.sent -= position + 1;
+    }
+
+    // without the lock, so the callbacks can send other messages
+    for(SendCallback &lost_callback: lost){
+        if(lost_callback){
+            lost_callback(ERR_TIMEOUT);
+        }
+    }
+    if(callback){
+        callback(status);
+    }
+}
+
+void EventLoop::failDevice(uint8_t index)
+{
+    std::deque<Outgoing> tx;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Device &dev = *m_devices[index];
+
+        dev.closed = true;
+        dev.tx.swap(tx);
+        dev.sent = 0;
+        dev.written = 0;
+    }
+
+    for(Outgoing &msg: tx){
+        if(msg.callback){
+            msg.callback(ERR_SERIAL_RD);
+        }
+    }
+}
+
+void EventLoop::setWriteInterest(uint8_t index, bool enable)
+{
+    Device &dev = *m_devices[index];
+
+    if(dev.want_write == enable){
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = enable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.u32 = index;
+
+    if(epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, dev.fd, &event) == 0){
+        dev.want_write = enable;
+    }
+}
+
+void EventLoop::processTimers()
+{
+    uint64_t current = now();
+    std::vector<TimerCallback> expired;
+    std::vector< std::pair<uint8_t, uint8_t> > timed_out;   // device and seq of its last expired message
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto end = m_timers.upper_bound(current);
+        for(auto it=m_timers.begin();it!=end;it++){
+            expired.push_back(it->second.callback);
+        }
+        m_timers.erase(m_timers.begin(), end);
+
+        // messages are written in order, so they expire in order too
+        for(uint8_t i=0;i<m_devices.size();i++){
+            Device &dev = *m_devices[i];
+            uint8_t expired_num = 0;
+            while(expired_num < dev.sent && dev.tx[expired_num].deadline <= current){
+                expired_num++;
+            }
+            if(expired_num){
+                timed_out.push_back(std::make_pair(i, dev.tx[expired_num - 1].seq));
+            }
+        }
+    }
+
+    // completing the last expired message completes the ones before it too
+    for(std::pair<uint8_t, uint8_t> &expired_send: timed_out){
+        printDebug("Slave did not confirm message", true);
+        completeSend(expired_send.first, expired_send.second, ERR_TIMEOUT);
+    }
+
+    for(TimerCallback &callback: expired){
+        callback();
+    }
+
+    // completions and timers might have queued new messages
+    if(!expired.empty() || !timed_out.empty()){
+        for(uint8_t i=0;i<m_devices.size();i++){
+            writeDevice(i);
+        }
+    }
+}
+
+void EventLoop::armTimer()
+{
+    uint64_t deadline = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!m_timers.empty()){
+            deadline = m_timers.begin()->first;
+        }
+
+        for(std::unique_ptr<Device> &dev: m_devices){
+            if(dev->sent && (!deadline || dev->tx.front().deadline < deadline)){
+                deadline = dev->tx.front().deadline;
+            }
+        }
+    }
+
+    // all zeros disarms the timer, expired deadlines fire immediately
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if(deadline){
+        spec.it_value.tv_sec = deadline / 1000;
+        spec.it_value.tv_nsec = (deadline % 1000) * 1000000 + 1;
+    }
+
+    timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void EventLoop::wakeUp()
+{
+    uint64_t counter = 1;
+
+    if(write(m_wake_fd, &counter, sizeof(counter)) < 0){
+        printDebug("Failed to wake up event loop", true);
+    }
+}
+
+#endif // __linux__
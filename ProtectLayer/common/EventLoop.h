@@ -0,0 +1,281 @@
+/**
+ * @brief Event loop of the Linux base station. Owns serial ports of slave devices and multiplexes messages
+ * written to the slaves, their status bytes, frames received from the radio and timers in a single thread.
+ *
+ * @file    EventLoop.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ProtectLayerGlobals.h"
+#include "SerialLink.h"
+
+#define SLAVE_STATUS_TIMEOUT_MS 3000    // time the slave has to confirm a written message, same as the former tty read timeout
+
+/**
+ * @brief Callback for frames received by a slave device
+ *
+ * @param device    Index of the device returned by EventLoop::addDevice()
+ * @param data      Frame as received by the radio, valid only during the call
+ * @param len       Frame length
+ */
+typedef std::function<void(uint8_t device, uint8_t *data, uint8_t len)> FrameCallback;
+
+/**
+ * @brief Completion of a message written to a slave device
+ *
+ * @param status    ERR_OK if the slave sent the message, other ERR_* code from the slave or ERR_TIMEOUT
+ */
+typedef std::function<void(uint8_t status)> SendCallback;
+
+/**
+ * @brief Callback of a timer
+ *
+ */
+typedef std::function<void()> TimerCallback;
+
+/**
+ * @brief Event loop based on epoll and timerfd. File descriptors are non-blocking and nothing waits for a slave
+ * except epoll_wait(), so a single thread can serve several slave devices. Each slave has a queue of outgoing messages,
+ * up to a window of them is written to the slave at once and they wait for statuses carrying their sequence numbers.
+ * Messages and statuses are framed as records of the serial link (SerialLink.h).
+ * The window must not exceed the slave's queue (SLAVE_QUEUE_LEN).
+ * Callbacks are called from the thread running the loop. send(), addTimer(), cancelTimer() and stop() can be called
+ * from any thread, other methods only from the thread running the loop.
+ *
+ */
+class EventLoop {
+private:
+    /**
+     * @brief Message waiting to be written to a slave device
+     *
+     */
+    struct Outgoing {
+        uint8_t         data[LINK_MAX_ENCODED]; // encoded LINK_MSG record
+        uint8_t         len;                    // length of the encoded record
+        uint8_t         seq;                    // sequence number, the slave returns it with the status
+        uint64_t        deadline;               // when the status is considered lost, set once written
+        SendCallback    callback;               // completion, can be empty
+    };
+
+    /**
+     * @brief Slave device
+     *
+     */
+    struct Device {
+        int                 fd;                 // serial port
+        LinkDecoder         rx;                 // decodes records received from the slave
+        std::deque<Outgoing> tx;                // messages for the slave, the first 'sent' of them wait for status
+        uint8_t             sent;               // messages written completely and waiting for status
+        uint8_t             written;            // bytes of message tx[sent] already written
+        uint8_t             window;             // maximum number of messages in flight
+        uint8_t             next_seq;           // sequence number of the next message
+        bool                want_write;         // EPOLLOUT is registered because the port did not accept everything
+        bool                closed;             // device hung up, removed from epoll
+    };
+
+    /**
+     * @brief Timer
+     *
+     */
+    struct Timer {
+        uint32_t        id;         // ID returned by addTimer()
+        TimerCallback   callback;   // called when the timer expires
+    };
+
+    int                     m_epoll_fd;     // epoll instance
+    int                     m_timer_fd;     // timerfd armed to the nearest timer or status deadline
+    int                     m_wake_fd;      // eventfd waking up epoll_wait() when called from other threads
+    std::vector< std::unique_ptr<Device> > m_devices;   // slave devices
+    std::multimap<uint64_t, Timer> m_timers;    // timers ordered by expiration
+    uint32_t                m_next_timer_id;    // ID of the next timer
+    std::mutex              m_mutex;            // guards queues of outgoing messages and timers
+    FrameCallback           m_frame_callback;   // receives frames from all devices
+    std::atomic<bool>       m_running;          // run() is running
+    bool                    m_dispatching;      // loop is inside runOnce(), blocking calls from callbacks are refused
+
+    /**
+     * @brief Read everything available from a device and dispatch status bytes and frames
+     *
+     * @param index     Device index
+     */
+    void readDevice(uint8_t index);
+
+    /**
+     * @brief Write outgoing messages until the window is full or the device does not accept more
+     *
+     * @param index     Device index
+     */
+    void writeDevice(uint8_t index);
+
+    /**
+     * @brief Complete message in flight with the given sequence number. Messages sent before it are completed
+     * with ERR_TIMEOUT, as the slave confirms messages in order and their statuses were lost.
+     *
+     * @param index     Device index
+     * @param seq       Sequence number
+     * @param status    Status passed to the completion
+     */
+    void completeSend(uint8_t index, uint8_t seq, uint8_t status);
+
+    /**
+     * @brief Complete all messages of a device that disconnected
+     *
+     * @param index     Device index
+     */
+    void failDevice(uint8_t index);
+
+    /**
+     * @brief Register or unregister interest in writing to a device
+     *
+     * @param index     Device index
+     * @param enable    true to wait until the device is writable
+     */
+    void setWriteInterest(uint8_t index, bool enable);
+
+    /**
+     * @brief Call expired timers and time out lost status bytes
+     *
+     */
+    void processTimers();
+
+    /**
+     * @brief Arm timerfd to the nearest timer or status deadline
+     *
+     */
+    void armTimer();
+
+    /**
+     * @brief Close descriptors of the loop
+     *
+     */
+    void closeAll();
+
+    /**
+     * @brief Wake up the thread blocked in epoll_wait()
+     *
+     */
+    void wakeUp();
+
+public:
+    /**
+     * @brief Constructor, throws runtime_error if it fails to create epoll, timerfd or eventfd
+     *
+     */
+    EventLoop();
+
+    /**
+     * @brief Destructor, pending messages are dropped without calling their completions
+     *
+     */
+    virtual ~EventLoop();
+
+    /**
+     * @brief Milliseconds of a monotonic clock used for deadlines
+     *
+     * @return uint64_t Current time
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Add a slave device. The file descriptor is switched to non-blocking mode and must not be read by anyone else.
+     *
+     * @param fd        Open serial port of the slave
+     * @param window    Maximum number of messages in flight, 1 for stop-and-wait
+     * @return int      Device index or -1 on failure
+     */
+    int addDevice(int fd, uint8_t window = SLAVE_QUEUE_LEN);
+
+    /**
+     * @brief Set callback for frames received from all devices
+     *
+     * @param callback  Callback
+     */
+    void setFrameCallback(FrameCallback callback);
+
+    /**
+     * @brief Queue a message for a slave device to broadcast, returns immediately. Messages are sent in order.
+     *
+     * @param device    Device index
+     * @param data      Message including header
+     * @param len       Message length
+     * @param callback  Completion called with the slave's status, can be empty
+     * @return uint8_t  SUCCESS or FAIL if the device does not exist or the message is too long
+     */
+    uint8_t send(uint8_t device, const uint8_t *data, uint8_t len, SendCallback callback);
+
+    /**
+     * @brief Queue a message and run the loop until the slave confirms it
+     *
+     * @param device    Device index
+     * @param data      Message including header
+     * @param len       Message length
+     * @return uint8_t  SUCCESS or FAIL if the message was not sent or it was called from a callback
+     */
+    uint8_t sendAndWait(uint8_t device, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Add a one-shot timer
+     *
+     * @param delay_ms  Delay in milliseconds
+     * @param callback  Callback
+     * @return uint32_t Timer ID
+     */
+    uint32_t addTimer(uint32_t delay_ms, TimerCallback callback);
+
+    /**
+     * @brief Cancel a timer that has not expired yet
+     *
+     * @param id    Timer ID returned by addTimer()
+     */
+    void cancelTimer(uint32_t id);
+
+    /**
+     * @brief Wait for events and process them
+     *
+     * @param timeout_ms    Maximum time to wait, -1 to wait for an event indefinitely
+     * @return uint8_t      SUCCESS or FAIL on epoll error or if it was called from a callback
+     */
+    uint8_t runOnce(int timeout_ms);
+
+    /**
+     * @brief Run the loop until a condition holds or the time runs out
+     *
+     * @param done          Condition checked after each processed batch of events
+     * @param timeout_ms    Maximum time to run
+     * @return true         The condition holds
+     * @return false        Timeout or error
+     */
+    bool runUntil(std::function<bool()> done, uint32_t timeout_ms);
+
+    /**
+     * @brief Run the loop until stop() is called
+     *
+     */
+    void run();
+
+    /**
+     * @brief Make run() return
+     *
+     */
+    void stop();
+};
+
+#endif // __linux__
+
+#endif // EVENTLOOP_H
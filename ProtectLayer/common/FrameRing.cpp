@@ -0,0 +1,115 @@
+/**
+ * @brief Implementation of the ring buffer for frames received from the slave device
+ *
+ * @file    FrameRing.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "FrameRing.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define RING_MASK   (FRAME_RING_SIZE - 1)
+
+
+FrameRing::FrameRing(): m_read(0), m_write(0) { }
+
+int FrameRing::fill(int fd)
+{
+    uint32_t space;
+    uint8_t *ptr = writePtr(&space);
+
+    if(!space){
+        return 0;
+    }
+
+    int rval = read(fd, ptr, space);
+    if(rval > 0){
+        commit(rval);
+    }
+
+    return rval;
+}
+
+uint8_t *FrameRing::writePtr(uint32_t *space)
+{
+    uint32_t pos = m_write & RING_MASK;
+    uint32_t free_space = FRAME_RING_SIZE - size();
+
+    // only up to the end of the ring, the rest is written in the next call
+    *space = FRAME_RING_SIZE - pos < free_space ? FRAME_RING_SIZE - pos : free_space;
+
+    return m_buffer + pos;
+}
+
+void FrameRing::commit(uint32_t len)
+{
+    m_write += len;
+}
+
+uint32_t FrameRing::push(const uint8_t *data, uint32_t len)
+{
+    uint32_t pushed = 0;
+
+    // at most two parts - up to the end of the ring and from its beginning
+    while(pushed < len){
+        uint32_t space;
+        uint8_t *ptr = writePtr(&space);
+
+        if(!space){
+            break;
+        }
+        if(space > len - pushed){
+            space = len - pushed;
+        }
+
+        memcpy(ptr, data + pushed, space);
+        commit(space);
+        pushed += space;
+    }
+
+    return pushed;
+}
+
+bool FrameRing::nextFrame(FrameView *frame)
+{
+    uint32_t available = size();
+
+    if(!available){
+        return false;
+    }
+
+    uint8_t len = m_buffer[m_read & RING_MASK];
+    if(available < (uint32_t) len + 1){
+        return false;
+    }
+
+    uint32_t start = (m_read + 1) & RING_MASK;
+
+    // make wrapped frame contiguous
+    if(start + len > FRAME_RING_SIZE){
+        memcpy(m_buffer + FRAME_RING_SIZE, m_buffer, start + len - FRAME_RING_SIZE);
+    }
+
+    frame->data = m_buffer + start;
+    frame->len = len;
+    m_read += len + 1;
+
+    return true;
+}
+
+uint32_t FrameRing::size()
+{
+    return m_write - m_read;
+}
+
+void FrameRing::clear()
+{
+    m_read = m_write;
+}
+
+#endif // __linux__
@@ -0,0 +1,113 @@
+/**
+ * @brief Ring buffer for frames received from the slave device. Each frame is prefixed
+ * with its length ([length][message]).
+ *
+ * @file    FrameRing.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+// size of the ring, must be a power of 2
+#ifndef FRAME_RING_SIZE
+#define FRAME_RING_SIZE     1024
+#endif
+
+#if FRAME_RING_SIZE & (FRAME_RING_SIZE - 1)
+#error "FRAME_RING_SIZE must be a power of 2"
+#endif
+
+#define FRAME_MAX_LEN       255     // frame length is stored in a single byte
+
+/**
+ * @brief Complete frame inside the ring buffer
+ *
+ */
+struct FrameView {
+    uint8_t *data;  // frame without the length byte, contiguous even if it wraps around the end of the ring
+    uint8_t len;    // frame length
+};
+
+/**
+ * @brief Preallocated ring buffer with frame parser. Data are read directly into the ring and frames are handed out
+ * as views into it without copying. Frames wrapping around the end of the ring are made contiguous by copying
+ * their beginning to the space behind the end of the ring.
+ *
+ */
+class FrameRing {
+private:
+    uint8_t     m_buffer[FRAME_RING_SIZE + FRAME_MAX_LEN];  // ring followed by space for wrapped frames
+    uint32_t    m_read;     // number of bytes consumed since start, position is m_read % FRAME_RING_SIZE
+    uint32_t    m_write;    // number of bytes written since start, position is m_write % FRAME_RING_SIZE
+
+public:
+    /**
+     * @brief Constructor, ring is empty
+     *
+     */
+    FrameRing();
+
+    /**
+     * @brief Read as much data from file descriptor as fits into contiguous free space of the ring (single read() call)
+     *
+     * @param fd    File descriptor
+     * @return int  Return value of read(), 0 if the ring is full
+     */
+    int fill(int fd);
+
+    /**
+     * @brief Get contiguous free space for writing, data must be committed by commit()
+     *
+     * @param space     Size of the space
+     * @return uint8_t* Pointer to the space
+     */
+    uint8_t *writePtr(uint32_t *space);
+
+    /**
+     * @brief Mark data written to the space from writePtr() as valid
+     *
+     * @param len   Number of bytes written
+     */
+    void commit(uint32_t len);
+
+    /**
+     * @brief Append data to the ring
+     *
+     * @param data      Data
+     * @param len       Data length
+     * @return uint32_t Number of bytes appended, less than len if the ring is full
+     */
+    uint32_t push(const uint8_t *data, uint32_t len);
+
+    /**
+     * @brief Get the next complete frame and consume it. The view stays valid until new data are written to the ring.
+     *
+     * @param frame     View of the frame
+     * @return true     Complete frame is available
+     * @return false    Otherwise
+     */
+    bool nextFrame(FrameView *frame);
+
+    /**
+     * @brief Get number of bytes in the ring
+     *
+     * @return uint32_t Number of bytes
+     */
+    uint32_t size();
+
+    /**
+     * @brief Remove all data
+     *
+     */
+    void clear();
+};
+
+#endif // __linux__
+
+#endif // FRAMERING_H
@@ -0,0 +1,331 @@
+/**
+ * @brief Implementation of the hash chain traversal
+ *
+ * @file    HashChain.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "HashChain.h"
+#include "HashChainBuilder.h"
+#include "AES_crypto.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Checksum of a state copy in the checkpoint file - FNV-1a over all fields except the checksum
+ *
+ * @param state     State copy
+ * @return uint32_t Checksum
+ */
+static uint32_t stateChecksum(const HashChainState *state)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(state);
+    uint32_t checksum = 2166136261u;
+
+    for(size_t i=0;i<offsetof(HashChainState, checksum);i++){
+        checksum = (checksum ^ data[i]) * 16777619u;
+    }
+
+    return checksum;
+}
+
+HashChain::HashChain(Hash *hash):
+m_hash(hash), m_hash_size(hash->hashSize()), m_aes(dynamic_cast<AEShash*>(hash) && m_hash_size == AES_HASH_SIZE), m_length(0), m_index(-1), m_last(hash->hashSize()), m_tmp(hash->hashSize()), m_hash_count(0),
+m_file(NULL), m_generation(0) { }
+
+HashChain::~HashChain()
+{
+    if(m_file){
+        munmap(m_file, sizeof(HashChainFile));
+    }
+}
+
+uint8_t HashChain::hashSteps(uint8_t *value, uint32_t steps)
+{
+    // builder has no state except the choice of implementation
+    static HashChainBuilder builder(1);
+
+    if(m_aes){
+        builder.steps(value, steps);
+        m_hash_count += steps;
+        return SUCCESS;
+    }
+
+    for(uint32_t i=0;i<steps;i++){
+        if(!m_hash->hash(value, m_hash_size, m_tmp.data(), m_hash_size)){
+            return FAIL;
+        }
+        memcpy(value, m_tmp.data(), m_hash_size);
+    }
+    m_hash_count += steps;
+
+    return SUCCESS;
+}
+
+uint8_t HashChain::init(const uint8_t *seed, uint32_t length)
+{
+    HashChain *chain = this;
+
+    return initChains(&chain, &seed, &length, 1);
+}
+
+uint8_t HashChain::initChains(HashChain **chains, const uint8_t * const *seeds, const uint32_t *lengths, uint32_t chains_num)
+{
+    std::vector<HashChainJob> jobs(chains_num);
+    bool aes = true;
+
+    for(uint32_t i=0;i<chains_num;i++){
+        HashChain *chain = chains[i];
+        uint32_t length = lengths[i];
+
+        chain->m_length = length;
+        chain->m_index = -1;
+        chain->m_hash_count = 0;
+        chain->m_positions.clear();
+        chain->m_values.clear();
+        chain->m_positions.reserve(HASH_CHAIN_MAX_DEPTH);
+        chain->m_values.reserve(HASH_CHAIN_MAX_DEPTH * chain->m_hash_size);
+
+        // the whole chain has to be computed for the last element anyway, checkpoints for the first traversal
+        // steps are placed on the way - x_0, then halves of the distance to x_(length-1)
+        if(length){
+            uint32_t target = length - 1;
+            uint32_t position = 0;
+            chain->m_positions.push_back(0);
+            while(position < target){
+                position += (target - position + 1) / 2;
+                chain->m_positions.push_back(position);
+            }
+        }
+        chain->m_values.resize(chain->m_positions.size() * chain->m_hash_size);
+        memcpy(chain->m_values.data(), seeds[i], chain->m_values.size() ? chain->m_hash_size : 0);
+
+        jobs[i].seed = seeds[i];
+        jobs[i].length = length;
+        jobs[i].last = chain->m_last.data();
+        jobs[i].positions = chain->m_positions.size() > 1 ? chain->m_positions.data() + 1 : NULL;
+        jobs[i].positions_num = chain->m_positions.size() > 1 ? chain->m_positions.size() - 1 : 0;
+        jobs[i].values = chain->m_values.data() + chain->m_hash_size;
+
+        aes = aes && chain->m_aes;
+    }
+
+    if(aes){
+        // AES hash chains are computed by the specialized builder, several of them in parallel
+        HashChainBuilder builder;
+        if(builder.build(jobs.data(), chains_num) != SUCCESS){
+            return FAIL;
+        }
+    } else {
+        for(uint32_t i=0;i<chains_num;i++){
+            HashChain *chain = chains[i];
+            uint32_t position = 0;
+
+            memcpy(jobs[i].last, jobs[i].seed, chain->m_hash_size);
+            for(uint32_t p=0;p<jobs[i].positions_num;p++){
+                if(chain->hashSteps(jobs[i].last, jobs[i].positions[p] - position) != SUCCESS){
+                    return FAIL;
+                }
+                position = jobs[i].positions[p];
+                memcpy(jobs[i].values + p * chain->m_hash_size, jobs[i].last, chain->m_hash_size);
+            }
+            if(chain->hashSteps(jobs[i].last, jobs[i].length - position) != SUCCESS){
+                return FAIL;
+            }
+        }
+    }
+
+    for(uint32_t i=0;i<chains_num;i++){
+        chains[i]->m_index = (int32_t) lengths[i] - 1;
+        chains[i]->m_hash_count = lengths[i];
+    }
+
+    return SUCCESS;
+}
+
+uint8_t HashChain::next()
+{
+    if(m_index < 0){
+        return FAIL;
+    }
+
+    // current element is on top and is not needed anymore
+    m_positions.pop_back();
+    m_values.resize(m_values.size() - m_hash_size);
+    m_index--;
+    if(m_index < 0){
+        return store();
+    }
+
+    // x_0 is never removed before the end, so there is a checkpoint below the new index
+    uint32_t target = m_index;
+    while(m_positions.back() < target){
+        uint32_t position = m_positions.back();
+        uint32_t mid = position + (target - position + 1) / 2;
+
+        // new checkpoint starts as a copy of the one below it
+        m_positions.push_back(mid);
+        m_values.resize(m_values.size() + m_hash_size);
+        uint8_t *value = m_values.data() + m_values.size() - m_hash_size;
+        memcpy(value, value - m_hash_size, m_hash_size);
+        if(hashSteps(value, mid - position) != SUCCESS){
+            return FAIL;
+        }
+    }
+
+    return store();
+}
+
+uint8_t HashChain::open(const std::string &path, const uint8_t *seed, uint32_t length)
+{
+    if(m_hash_size > HASH_CHAIN_MAX_HASH_SIZE){
+        return FAIL;
+    }
+
+    // checkpoints allow computing keys that were not disclosed yet, the file is as secret as the key file
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if(fd < 0){
+        return FAIL;
+    }
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) < 0){
+        close(fd);
+        return FAIL;
+    }
+    bool exists = file_stat.st_size == sizeof(HashChainFile);
+    if(!exists && ftruncate(fd, sizeof(HashChainFile)) < 0){
+        close(fd);
+        return FAIL;
+    }
+
+    void *map = mmap(NULL, sizeof(HashChainFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return FAIL;
+    }
+
+    if(m_file){
+        munmap(m_file, sizeof(HashChainFile));
+    }
+    m_file = static_cast<HashChainFile*>(map);
+
+    // the same chain is continued, its keys must never be used again from the beginning
+    if(exists && m_file->magic == HASH_CHAIN_MAGIC && m_file->hash_size == m_hash_size && m_file->length == length
+       && !memcmp(m_file->seed, seed, m_hash_size)){
+        return restore(length);
+    }
+
+    // new chain
+    if(init(seed, length) != SUCCESS){
+        return FAIL;
+    }
+
+    memset(m_file, 0, sizeof(HashChainFile));
+    m_file->magic = HASH_CHAIN_MAGIC;
+    m_file->hash_size = m_hash_size;
+    m_file->length = length;
+    memcpy(m_file->seed, seed, m_hash_size);
+    memcpy(m_file->last, m_last.data(), m_hash_size);
+    m_generation = 0;
+
+    return store();
+}
+
+uint8_t HashChain::restore(uint32_t length)
+{
+    // use the newer of valid copies
+    HashChainState *state = NULL;
+    for(int i=0;i<2;i++){
+        HashChainState *copy = &m_file->states[i];
+        if(copy->checksum == stateChecksum(copy) && (!state || copy->generation > state->generation)){
+            state = copy;
+        }
+    }
+
+    if(!state || state->count > HASH_CHAIN_MAX_DEPTH || state->index < -1 || state->index >= (int64_t) length){
+        return FAIL;
+    }
+    if(state->index >= 0 && (!state->count || state->positions[state->count - 1] != (uint32_t) state->index)){
+        return FAIL;
+    }
+
+    m_length = length;
+    m_index = state->index;
+    m_hash_count = 0;
+    m_generation = state->generation;
+    memcpy(m_last.data(), m_file->last, m_hash_size);
+
+    m_positions.assign(state->positions, state->positions + state->count);
+    m_values.clear();
+    m_values.reserve(HASH_CHAIN_MAX_DEPTH * m_hash_size);
+    for(uint32_t i=0;i<state->count;i++){
+        m_values.insert(m_values.end(), state->values[i], state->values[i] + m_hash_size);
+    }
+
+    return SUCCESS;
+}
+
+uint8_t HashChain::store()
+{
+    if(!m_file){
+        return SUCCESS;
+    }
+
+    // overwrite the older copy
+    HashChainState *state = &m_file->states[(m_generation + 1) % 2];
+    state->generation = m_generation + 1;
+    state->index = m_index;
+    state->count = m_positions.size();
+    for(uint32_t i=0;i<state->count;i++){
+        state->positions[i] = m_positions[i];
+        memcpy(state->values[i], m_values.data() + i * m_hash_size, m_hash_size);
+    }
+    state->checksum = stateChecksum(state);
+
+    if(msync(m_file, sizeof(HashChainFile), MS_SYNC) < 0){
+        return FAIL;
+    }
+    m_generation++;
+
+    return SUCCESS;
+}
+
+const uint8_t *HashChain::current()
+{
+    if(m_index < 0){
+        return NULL;
+    }
+
+    return m_values.data() + m_values.size() - m_hash_size;
+}
+
+const uint8_t *HashChain::last()
+{
+    return m_last.data();
+}
+
+int32_t HashChain::index()
+{
+    return m_index;
+}
+
+uint32_t HashChain::checkpointCount()
+{
+    return m_positions.size();
+}
+
+uint64_t HashChain::hashCount()
+{
+    return m_hash_count;
+}
+
+#endif // __linux__
@@ -0,0 +1,195 @@
+/**
+ * @brief Traversal of a hash chain in reverse order with logarithmic storage
+ *
+ * @file    HashChain.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef HASHCHAIN_H
+#define HASHCHAIN_H
+
+#ifdef __linux__
+
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+#include "ProtectLayerGlobals.h"
+#include "common.h"
+
+#define HASH_CHAIN_MAGIC            0x43484C50  // "PLHC" at the start of a checkpoint file
+#define HASH_CHAIN_MAX_DEPTH        33          // maximum number of checkpoints for 32-bit lengths
+#define HASH_CHAIN_MAX_HASH_SIZE    32          // maximum hash size supported by checkpoint files
+
+/**
+ * @brief Copy of the traversal state in a checkpoint file
+ *
+ */
+struct HashChainState {
+    uint32_t    generation;                                                 // newer valid copy is used
+    int32_t     index;                                                      // index of the current element
+    uint32_t    count;                                                      // number of checkpoints
+    uint32_t    positions[HASH_CHAIN_MAX_DEPTH];                            // indices of checkpoints
+    uint8_t     values[HASH_CHAIN_MAX_DEPTH][HASH_CHAIN_MAX_HASH_SIZE];     // values of checkpoints
+    uint32_t    checksum;                                                   // FNV-1a of the fields above
+};
+
+/**
+ * @brief Checkpoint file mapped to memory. The state is written alternately to two copies, so a crash during a write
+ * leaves the previous copy intact.
+ *
+ */
+struct HashChainFile {
+    uint32_t        magic;                              // HASH_CHAIN_MAGIC
+    uint32_t        hash_size;                          // hash size
+    uint32_t        length;                             // index of the last element
+    uint8_t         seed[HASH_CHAIN_MAX_HASH_SIZE];     // first element, identifies the chain
+    uint8_t         last[HASH_CHAIN_MAX_HASH_SIZE];     // last element
+    HashChainState  states[2];                          // two copies of the state
+};
+
+/**
+ * @brief Hash chain x_0 = seed, x_i = H(x_(i-1)) for i = 1..length, traversed from x_(length-1) down to x_0.
+ * Instead of the whole chain only checkpoints are stored (binary pebbling). The next element is computed from the
+ * nearest checkpoint below it, placing new checkpoints in halves of the remaining distance. At most log2(length) + 1
+ * checkpoints are stored and each step costs amortized log2(length) / 2 hashes. A single step may cost up to
+ * length / 2 hashes (crossing into the lower half of the chain).
+ *
+ */
+class HashChain {
+private:
+    Hash                    *m_hash;            // class providing hash computation
+    uint32_t                m_hash_size;        // hash size
+    bool                    m_aes;              // hash is AEShash, chains are computed by HashChainBuilder
+    uint32_t                m_length;           // index of the last element
+    int32_t                 m_index;            // index of the current element, -1 when the chain is exhausted
+
+    std::vector<uint32_t>   m_positions;        // indices of checkpoints, increasing, top is the current element
+    std::vector<uint8_t>    m_values;           // values of checkpoints, m_hash_size bytes each
+    std::vector<uint8_t>    m_last;             // last element of the chain
+    std::vector<uint8_t>    m_tmp;              // intermediate hash value
+
+    uint64_t                m_hash_count;       // number of hashes computed
+
+    HashChainFile           *m_file;            // mapped checkpoint file, NULL if the state is not persisted
+    uint32_t                m_generation;       // generation of the last stored state
+
+    /**
+     * @brief Hash value repeatedly
+     *
+     * @param value     Value to be hashed, replaced by the result
+     * @param steps     Number of hashes
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t hashSteps(uint8_t *value, uint32_t steps);
+
+    /**
+     * @brief Restore the state from a copy in the checkpoint file
+     *
+     * @param length    Index of the last element
+     * @return uint8_t  SUCCESS or FAIL if no copy is valid
+     */
+    uint8_t restore(uint32_t length);
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param hash      Class providing hash interface
+     */
+    HashChain(Hash *hash);
+
+    /**
+     * @brief Destructor, unmaps the checkpoint file
+     *
+     */
+    virtual ~HashChain();
+
+    /**
+     * @brief Compute the chain and place checkpoints for the traversal. Current element is x_(length-1).
+     *
+     * @param seed      First element of the chain, hash size bytes
+     * @param length    Index of the last element
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t init(const uint8_t *seed, uint32_t length);
+
+    /**
+     * @brief Initialize several chains at once, chains of the AES hash are computed in parallel
+     *
+     * @param chains        Chains to be initialized
+     * @param seeds         First elements of the chains
+     * @param lengths       Indices of the last elements
+     * @param chains_num    Number of chains
+     * @return uint8_t      SUCCESS or FAIL
+     */
+    static uint8_t initChains(HashChain **chains, const uint8_t * const *seeds, const uint32_t *lengths, uint32_t chains_num);
+
+    /**
+     * @brief Continue the traversal stored in a checkpoint file or start a new one by init() and create the file.
+     * Restoring the state takes constant time, the chain is not recomputed. A file of the same chain without a valid
+     * state is an error, starting the chain over would use disclosed keys again.
+     *
+     * @param path      Path to the checkpoint file
+     * @param seed      First element of the chain, hash size bytes
+     * @param length    Index of the last element
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t open(const std::string &path, const uint8_t *seed, uint32_t length);
+
+    /**
+     * @brief Write the state to the checkpoint file and wait until it is on disk
+     *
+     * @return uint8_t  SUCCESS or FAIL, SUCCESS if there is no checkpoint file
+     */
+    uint8_t store();
+
+    /**
+     * @brief Move to the previous element of the chain. With a checkpoint file the new state is stored before
+     * returning, so the current element is never used again after a restart.
+     *
+     * @return uint8_t  SUCCESS or FAIL if the chain is exhausted or a hash failed
+     */
+    uint8_t next();
+
+    /**
+     * @brief Get the current element
+     *
+     * @return const uint8_t*   Current element, NULL if the chain is exhausted
+     */
+    const uint8_t *current();
+
+    /**
+     * @brief Get the last element of the chain - the commitment known by the nodes
+     *
+     * @return const uint8_t*   Last element
+     */
+    const uint8_t *last();
+
+    /**
+     * @brief Get index of the current element
+     *
+     * @return int32_t  Index, -1 if the chain is exhausted
+     */
+    int32_t index();
+
+    /**
+     * @brief Get number of stored checkpoints
+     *
+     * @return uint32_t Number of checkpoints
+     */
+    uint32_t checkpointCount();
+
+    /**
+     * @brief Get number of hashes computed since init() was called
+     *
+     * @return uint64_t Number of hashes
+     */
+    uint64_t hashCount();
+};
+
+#endif // __linux__
+
+#endif // HASHCHAIN_H
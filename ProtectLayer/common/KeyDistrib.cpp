@@ -12,33 +12,67 @@
 
 
 #ifdef  __linux__
+#include <stdexcept>
+#include <vector>
 #include "configurator.h"
 
 KeyDistrib::KeyDistrib(std::string &filename)
 {
     // init configurator with keys
     Configurator configurator(filename, 0);
+    std::vector<Node> nodes = configurator.getNodes();
+    AES aes;    // expanded keys are identical for all Cipher implementations
+
+    if(nodes.size() > KEY_TABLE_SIZE){
+        throw std::runtime_error("Too many nodes in key file");
+    }
 
     // set attributes
-    m_nodes = configurator.getNodes();
-    m_nodes_num = m_nodes.size();
+    m_nodes_num = nodes.size();
     m_key_size = configurator.getKeySize();
-    memset(m_counters, 0, (MAX_NODE_NUM + 1) * sizeof(uint32_t));
+    memset(m_keys, 0, sizeof(m_keys));
+    memset(m_counters, 0, sizeof(m_counters));
+    memset(m_configured, 0, sizeof(m_configured));
+
+    // fill the table, so the lookup is just indexing
+    for(int i=0;i<m_nodes_num;i++){
+        uint8_t id = nodes[i].ID;
+
+        if(nodes[i].BS_key.size() != AES_KEY_SIZE){
+            throw std::runtime_error("Invalid key size in key file");
+        }
+
+        memcpy(m_keys[id].keyValue, nodes[i].BS_key.data(), AES_KEY_SIZE);
+        m_keys[id].counter = m_counters + id;
+        m_keys[id].keyID = id;
+        m_keys[id].expKey = m_expanded_keys[id];
+        aes.keyExpansion(m_expanded_keys[id], m_keys[id].keyValue);
+        m_configured[id] = true;
+    }
+
+    // always set to 0 in original WSNProtectLayer
+    memset(&m_hash_key, 0, sizeof(PL_key_t));
+    m_hash_counter = 0;
+    m_hash_key.counter = &m_hash_counter;
+    m_hash_key.keyID = KEY_ID_HASH;
+    m_hash_key.expKey = m_hash_expanded_key;
+    aes.keyExpansion(m_hash_expanded_key, m_hash_key.keyValue);
 }
 
 uint8_t KeyDistrib::getKeyToNodeB(uint8_t nodeID, PL_key_t** pNodeKey)
 {
-    // find the wanted node, set its counter and pointer to it
-    for(int i=0;i<m_nodes_num;i++){
-        if(m_nodes[i].ID == nodeID){
-            memcpy(m_key.keyValue, m_nodes[i].BS_key.data(), m_key_size);
-            m_key.counter = m_counters + i;
-            *pNodeKey = &m_key;
-            return SUCCESS;
-        }
+    if(!m_configured[nodeID]){
+        return FAIL;
     }
 
-    return FAIL;
+    *pNodeKey = m_keys + nodeID;
+
+    return SUCCESS;
+}
+
+std::mutex &KeyDistrib::getKeyLock(uint8_t nodeID)
+{
+    return m_locks[nodeID];
 }
 
 uint8_t KeyDistrib::getKeyToBSB(PL_key_t** pNodeKey)
@@ -48,11 +82,8 @@ uint8_t KeyDistrib::getKeyToBSB(PL_key_t** pNodeKey)
 
 uint8_t KeyDistrib::getHashKeyB(PL_key_t** pHashKey)
 {
-    // always set to 0 in original WSNProtectLayer
-    *m_counters = 0;
-    m_key.counter = m_counters;
-    memset(m_key.keyValue, 0, AES_KEY_SIZE);
-    *pHashKey = &m_key;
+    // counter is set to 0 in constructor and never changed, threads share the hash key without a lock
+    *pHashKey = &m_hash_key;
 
     return SUCCESS;
 }
@@ -61,11 +92,12 @@ uint8_t KeyDistrib::getHashKeyB(PL_key_t** pHashKey)
 
 #include <avr/eeprom.h>
 #include "common.h"
+#include "AES_crypto.h"
 
 
 KeyDistrib::KeyDistrib(uint32_t *neighbors): m_neighbors(neighbors)
 {
-    // zero out the current key and all counters
+    // zero out the current key and all counters, expanded keys are not precomputed (expKey stays NULL)
     memset((void*) &m_key, 0, sizeof(PL_key_t));
     memset((void*) m_counters, 0, (MAX_NODE_NUM + 1) * sizeof(uint32_t));
 
@@ -90,6 +122,7 @@ uint8_t KeyDistrib::getKeyToNodeB(uint8_t nodeID, PL_key_t** pNodeKey)
     eeprom_read_block(m_key.keyValue, KEYS_START_ADDRESS + ((nodeID - 1) * AES_KEY_SIZE), AES_KEY_SIZE);
     // set the counter
     m_key.counter = m_counters + nodeID;
+    m_key.keyID = nodeID;
     // set pointer
     *pNodeKey = &m_key;
 
@@ -110,6 +143,7 @@ uint8_t KeyDistrib::getDerivedKeyToNodeB(uint8_t nodeID, PL_key_t** pNodeKey)
     eeprom_read_block(m_key.keyValue, DRVD_KEYS_START_ADDRESS + ((nodeID - 1) * AES_KEY_SIZE), AES_KEY_SIZE);
     // set the counter
     m_key.counter = m_counters + nodeID;
+    m_key.keyID = nodeID;
     // set pointer
     *pNodeKey = &m_key;
 
@@ -120,6 +154,7 @@ uint8_t KeyDistrib::getKeyToBSB(PL_key_t** pBSKey)
 {
     eeprom_read_block(m_key.keyValue, KEYS_START_ADDRESS, AES_KEY_SIZE);
     m_key.counter = m_counters + 1;
+    m_key.keyID = BS_NODE_ID;
     *pBSKey = &m_key;
 
     return SUCCESS;
@@ -130,6 +165,7 @@ uint8_t KeyDistrib::getHashKeyB(PL_key_t** pHashKey)
     // always set to 0 in original WSNProtectLayer
     *m_counters = 0;
     m_key.counter = m_counters;
+    m_key.keyID = KEY_ID_HASH;
     memset(m_key.keyValue, 0, AES_KEY_SIZE);
     *pHashKey = &m_key;
 
@@ -146,6 +182,9 @@ uint8_t KeyDistrib::deleteKey(uint8_t nodeID)
         return FAIL;
     }
 
+    // drop expanded key from the cache
+    aes_key_cache.invalidate(nodeID);
+
     // overwrite the key
     for(int i=0;i<AES_KEY_SIZE;i++){
         eeprom_write_byte(KEYS_START_ADDRESS + ((nodeID - 1) * AES_KEY_SIZE) + i, 0);
@@ -166,7 +205,6 @@ uint8_t KeyDistrib::deriveKeyToNode(uint8_t nodeID, uint8_t *random_input, uint8
         return FAIL;
     }
 
-    uint8_t mac_buff[AES_MAC_SIZE];
     uint8_t original_key[AES_KEY_SIZE];
 
 #if AES_MAC_SIZE != AES_KEY_SIZE
@@ -188,6 +226,9 @@ uint8_t KeyDistrib::deriveKeyToNode(uint8_t nodeID, uint8_t *random_input, uint8
 
     eeprom_update_block(original_key, DRVD_KEYS_START_ADDRESS + ((nodeID - 1) * AES_KEY_SIZE), AES_KEY_SIZE);
 
+    // the key to this node has been replaced, its expanded form must not be used anymore
+    aes_key_cache.invalidate(nodeID);
+
     return SUCCESS;
 }
 
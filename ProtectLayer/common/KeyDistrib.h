@@ -99,26 +99,40 @@ public:
 #else // __linux__
 #include "configurator.h"
 // version for linux base station
-#include <vector>
+#include <mutex>
 #include <string>
 
+#define KEY_TABLE_SIZE	256		// node IDs are uint8_t, every possible ID has its own entry
+
+/**
+ * @brief Key table of the base station. Getters do not modify the table, but counters change with every message
+ * sent to or received from the node - Crypto holds the key's lock (getKeyLock()) while it uses the counter, so
+ * threads can use keys concurrently, even the key of the same node.
+ * 
+ */
 class KeyDistrib {
 private:
-	PL_key_t				m_key;							// current key
-	std::vector<Node> 		m_nodes;						// vector of structures describing nodes
-	uint8_t 				m_key_size;						// key size				
-	uint8_t 				m_nodes_num;					// number of nodes
-	uint32_t 				m_counters[MAX_NODE_NUM + 1];	// counters for each node's key
+	PL_key_t 				m_keys[KEY_TABLE_SIZE];							// keys indexed by node ID
+	uint8_t 				m_expanded_keys[KEY_TABLE_SIZE][AES_EXP_KEY_SIZE];	// expanded keys, computed once in constructor
+	uint32_t 				m_counters[KEY_TABLE_SIZE];						// counters for each node's key
+	std::mutex 				m_locks[KEY_TABLE_SIZE];						// guard counters, held by Crypto while a key is used
+	bool 					m_configured[KEY_TABLE_SIZE];					// true if there is a key for the node
+	PL_key_t 				m_hash_key;										// all-zero hash key
+	uint8_t 				m_hash_expanded_key[AES_EXP_KEY_SIZE];			// expanded hash key
+	uint32_t 				m_hash_counter;									// hash key counter, always 0
+	uint8_t 				m_key_size;										// key size				
+	uint16_t 				m_nodes_num;									// number of nodes, up to KEY_TABLE_SIZE
 public:
 	/**
-	 * @brief Constructot
+	 * @brief Constructor, loads keys into the table and expands them. Throws runtime_error
+	 * if the key file contains a key of a wrong size or more nodes than the table can hold
 	 * 
 	 * @param filename Name of the file with keys and IDs
 	 */
 	KeyDistrib(std::string &filename);
 
 	/**
-	 * @brief Get key shared with a node
+	 * @brief Get key shared with a node, returns pointer to the table entry
 	 * 
 	 * @param nodeID 	Node ID
 	 * @param pNodeKey 	Pointer to pointer to a key
@@ -126,6 +140,14 @@ public:
 	 */
 	uint8_t getKeyToNodeB(uint8_t nodeID, PL_key_t** pNodeKey);
 	
+	/**
+	 * @brief Get lock of the key shared with a node, it must be held while the key's counter is used
+	 * 
+	 * @param nodeID 		Node ID
+	 * @return std::mutex& 	Lock of the key
+	 */
+	std::mutex &getKeyLock(uint8_t nodeID);
+
 	/**
 	 * @brief Get the hash key
 	 * 
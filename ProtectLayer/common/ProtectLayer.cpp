@@ -18,37 +18,67 @@
 #include <unistd.h>
 
 
-int openSerialPort(std::string path);   // TODO move from configurator to separate file with header
+int openSerialPort(std::string path, uint32_t baud_rate);   // TODO move from configurator to separate file with header
 
 
 ProtectLayer::ProtectLayer(std::string &slave_path, std::string &key_file):
-m_hash(&m_aes), m_mac(&m_aes), m_keydistrib(key_file), m_crypto(&m_aes, &m_mac, &m_hash, &m_keydistrib)
+m_cipher(selectCipher(&m_aes)), m_hash(m_cipher), m_mac(m_cipher), m_keydistrib(key_file), m_crypto(m_cipher, &m_mac, &m_hash, &m_keydistrib),
+m_pipeline(NULL)
 { 
-    memset(m_received, 0, 2 * sizeof(uint8_t));
-
     // open file descriptor for serial port
-    m_slave_fd = openSerialPort(slave_path);
+    m_slave_fd = openSerialPort(slave_path, SLAVE_BAUD_RATE);
     if(m_slave_fd < 0){
         throw std::runtime_error("Failed to open serial port");
     }
 
+    // fire up the device - sometimes it takes a read first
+    uint8_t buffer[MAX_MSG_SIZE];
+    read(m_slave_fd, buffer, MAX_MSG_SIZE);
+
+    // from now on the slave is served by the event loop only
+    int device = m_loop.addDevice(m_slave_fd);
+    if(device < 0){
+        close(m_slave_fd);
+        throw std::runtime_error("Failed to add serial port to event loop");
+    }
+    m_slave_device = device;
+    m_loop.setFrameCallback([this](uint8_t, uint8_t *data, uint8_t len){ handleFrame(data, len); });
+
 #ifdef ENABLE_CTP
-    // set file descriptor in CTP class
-    m_ctp.setSlaveFD(m_slave_fd);
+    // set slave device in CTP class
+    m_ctp.setSlave(&m_loop, m_slave_device);
 #endif
     // initialize configurator class to read keys from the file
     Configurator configurator(key_file, 0, 0);
 
-    // initialize uTESLA class with keys from configurator
-    m_utesla = new uTeslaMaster(m_slave_fd, configurator.getuTESLAKey(), configurator.getuTESLARounds(), &m_hash, &m_mac);
+#ifdef ENABLE_CTP
+    // CTP establishment ends early once every configured node reports convergence
+    uint32_t nodes = 0;
+    for(const Node &node: configurator.getNodes()){
+        if(node.ID != BS_NODE_ID && node.ID <= MAX_NODE_NUM){
+            setBit(nodes, node.ID);
+        }
+    }
+    m_ctp.setExpected(nodes);
+#endif
 
-    // fire up the device - sometimes it takes a read first
-    uint8_t buffer[MAX_MSG_SIZE];
-    read(m_slave_fd, buffer, MAX_MSG_SIZE);
+    // two-level uTESLA uses the configured chain as the high-level one
+#ifdef UTESLA_TWO_LEVEL
+    uint32_t low_rounds = UTESLA_LOW_ROUNDS;
+#else
+    uint32_t low_rounds = 0;
+#endif
+
+    // initialize uTESLA class with keys from configurator, it continues from the last round before a restart
+    m_utesla = new uTeslaMaster(&m_loop, m_slave_device, configurator.getuTESLAKey(), configurator.getuTESLARounds(), &m_hash, &m_mac,
+                                key_file + UTESLA_CHECKPOINT_SUFFIX, low_rounds);
 }
 
 ProtectLayer::~ProtectLayer()
 {
+    // pipeline reads from the slave device, stop it first
+    delete m_pipeline;
+
     // uTESLA was dynamically allocated
     delete m_utesla;
     
@@ -73,10 +103,10 @@ uint8_t ProtectLayer::startCTP()
     return m_ctp.startCTP(CTP_DURATION_MS);
 }
 
-uint8_t ProtectLayer::sendTo(msg_type_t msg_type, uint8_t receiver, uint8_t *buffer, uint8_t size)
+uint8_t ProtectLayer::protectMessage(msg_type_t msg_type, uint8_t receiver, const uint8_t *buffer, uint8_t size, uint8_t *message, uint8_t *msg_size)
 {
     // return FAIL in case of too long messages, NULL buffer or invalid recipient
-    if(size > MAX_MSG_SIZE + SPHEADER_SIZE + m_mac.macSize() || receiver < 2 || receiver > MAX_NODE_NUM || !buffer){
+    if(size > MAX_MSG_SIZE - SPHEADER_SIZE - m_mac.macSize() || receiver < 2 || receiver > MAX_NODE_NUM || !buffer){
         return FAIL;
     }
     
@@ -84,87 +114,100 @@ uint8_t ProtectLayer::sendTo(msg_type_t msg_type, uint8_t receiver, uint8_t *buf
     if(msg_type != MSG_OTHER && msg_type != MSG_APP){
         return FAIL;
     }
-    
-    uint8_t msg_buffer[MAX_MSG_SIZE + 2];
 
-    // set header pointer to beginning of the message (first 2 bytes are only for serial communication between master and slave BS devices)
-    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(msg_buffer + 2);
     // set the header
+    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(message);
     spheader->msgType = msg_type;
     spheader->sender = BS_NODE_ID;
     spheader->receiver = receiver;
 
     // copy the rest of the message into buffer
-    memcpy(msg_buffer + 2 + SPHEADER_SIZE, buffer, size);
+    memcpy(message + SPHEADER_SIZE, buffer, size);
 
     // set the new size to size + header size
-    size += SPHEADER_SIZE;
+    *msg_size = size + SPHEADER_SIZE;
+
     // encryption and MAC
-    if(m_crypto.protectBufferForNodeB(receiver, msg_buffer + 2, SPHEADER_SIZE, &size) != SUCCESS){
-        return FAIL;
-    }
+    return m_crypto.protectBufferForNodeB(receiver, message, SPHEADER_SIZE, msg_size);
+}
 
-    // set first 2 bytes for serial communication
-    msg_buffer[0] = size;
-    msg_buffer[1] = size;
+uint8_t ProtectLayer::sendTo(msg_type_t msg_type, uint8_t receiver, uint8_t *buffer, uint8_t size)
+{
+    uint8_t msg_buffer[MAX_MSG_SIZE];
+    uint8_t msg_size;
 
-    // send buffer to device
-    int wr_len = 0;
-    if((wr_len = write(m_slave_fd, buffer, size + 2)) != size + 2){
+    if(protectMessage(msg_type, receiver, buffer, size, msg_buffer, &msg_size) != SUCCESS){
         return FAIL;
     }
 
-    // receive the response
-    int rd_len = 0;
-    if((rd_len = read(m_slave_fd, buffer, MAX_MSG_SIZE)) != 1){
-        return FAIL;
-    }
+    // send through the slave and wait for its response
+    return m_loop.sendAndWait(m_slave_device, msg_buffer, msg_size);
+}
+
+uint8_t ProtectLayer::sendToAsync(msg_type_t msg_type, uint8_t receiver, uint8_t *buffer, uint8_t size, SendCallback callback)
+{
+    uint8_t msg_buffer[MAX_MSG_SIZE];
+    uint8_t msg_size;
 
-    // check the response
-    if(buffer[0] != ERR_OK){
+    if(protectMessage(msg_type, receiver, buffer, size, msg_buffer, &msg_size) != SUCCESS){
         return FAIL;
     }
 
-    return SUCCESS;
+    // the loop keeps its own copy of the message
+    return m_loop.send(m_slave_device, msg_buffer, msg_size, callback);
 }
 
-uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size)
+void ProtectLayer::handleFrame(uint8_t *data, uint8_t len)
 {
-    uint8_t rcvd_len = 0;
-    uint8_t rcvd_buff[MAX_MSG_SIZE + 10];
+#ifdef ENABLE_CTP
+    // convergence reports may end CTP establishment early, they are not passed to the application
+    if(len >= SPHEADER_SIZE && reinterpret_cast<SPHeader_t*>(data)->msgType == MSG_CTP_DONE){
+        if(unprotectFrame(data, &len) == SUCCESS){
+            m_ctp.reportConverged(reinterpret_cast<SPHeader_t*>(data)->sender);
+        }
+        return;
+    }
+#endif // ENABLE_CTP
 
-    // // get new message from the slave
-    // if((rcvd_len = read(m_slave_fd, (void*) rcvd_buff, MAX_MSG_SIZE)) < SPHEADER_SIZE + m_mac.macSize() + 1){
-    //     // return FAIL if there is none
-    //     return FAIL;
-    // }
+    // the pipeline decrypts in its workers, the loop only passes the frame on
+    if(m_pipeline){
+        if(m_pipeline->submit(data, len) == ERR_BUFFSIZE){
+            printDebug("Pipeline queue full, dropping message", true);
+        }
+        return;
+    }
 
-    // get new message from the slave
-    if((rcvd_len = read(m_slave_fd, (void*) rcvd_buff, MAX_MSG_SIZE)) > 0){
-        m_rcvd_queue.insert(m_rcvd_queue.end(), rcvd_buff, rcvd_buff + rcvd_len);
+    if(m_rcv_callback){
+        if(unprotectFrame(data, &len) == SUCCESS){
+            m_rcv_callback(data, len);
+        }
+        return;
     }
 
-    if(m_rcvd_queue.size() < SPHEADER_SIZE + m_mac.macSize() + 1){
-        return FAIL;
+    // keep the frame for receive(), drop it if the application does not keep up
+    if(FRAME_RING_SIZE - m_rcvd_ring.size() < (uint32_t) len + 1){
+        printDebug("Receive buffer full, dropping message", true);
+        return;
     }
 
-    if(m_rcvd_queue.size() < m_rcvd_queue.front()){
+    m_rcvd_ring.push(&len, 1);
+    m_rcvd_ring.push(data, len);
+}
+
+uint8_t ProtectLayer::unprotectFrame(uint8_t *data, uint8_t *len)
+{
+    // discard message if it cannot be a protected message
+    if(*len < SPHEADER_SIZE + m_mac.macSize() + 1){
         return FAIL;
     }
 
-    rcvd_len = m_rcvd_queue.front();
-    m_rcvd_queue.pop_front();
-    std::copy(m_rcvd_queue.begin(), m_rcvd_queue.begin() + rcvd_len, rcvd_buff);
-    m_rcvd_queue.erase(m_rcvd_queue.begin(), m_rcvd_queue.begin() + rcvd_len);
-
     // discard message if it does not fit into buffer
-    if(rcvd_len > MAX_MSG_SIZE){    // cannot happen
+    if(*len > MAX_MSG_SIZE){
         return ERR_BUFFSIZE;
     }
 
     // set the header pointer
-    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(rcvd_buff);
-    uint8_t rval;
+    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(data);
 
     // discard messages for other nodes
     if(spheader->receiver != BS_NODE_ID){
@@ -172,29 +215,98 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
     }
 
     // decrypt and verify MAC
-    if((rval = m_crypto.unprotectBufferFromNodeB(spheader->sender, rcvd_buff, (uint8_t) SPHEADER_SIZE, &rcvd_len)) != SUCCESS){
+    if(m_crypto.unprotectBufferFromNodeB(spheader->sender, data, (uint8_t) SPHEADER_SIZE, len) != SUCCESS){
         return FAIL;
     }
 
     // set the actual data size + header
-    *received_size = rcvd_len - m_mac.macSize();
+    *len -= m_mac.macSize();
+
+    return SUCCESS;
+}
+
+uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size)
+{
+    FrameView frame;
+
+    // frames received while sending or establishing CTP are already waiting, otherwise run the loop until one comes
+    if(!m_rcvd_ring.nextFrame(&frame)){
+        if(!m_loop.runUntil([this](){ return m_rcvd_ring.size() > 0; }, BS_RECV_TIMEOUT_MS) || !m_rcvd_ring.nextFrame(&frame)){
+            return FAIL;
+        }
+    }
+
+    // decrypted in place, the frame is already consumed from the ring
+    uint8_t rval = unprotectFrame(frame.data, &frame.len);
+    if(rval != SUCCESS){
+        return rval;
+    }
 
     // return FAIL if plaintext does not fit into buffer
+    *received_size = frame.len;
     if(*received_size > buff_size){
         return FAIL;
     }
 
     // copy message into buffer
-    memcpy(buffer, rcvd_buff, *received_size);
+    memcpy(buffer, frame.data, *received_size);
 
     return SUCCESS;
 }
 
+void ProtectLayer::setReceiveCallback(ReceiveCallback callback)
+{
+    m_rcv_callback = callback;
+
+    // messages waiting for receive() go to the callback
+    FrameView frame;
+    while(m_rcv_callback && m_rcvd_ring.nextFrame(&frame)){
+        if(unprotectFrame(frame.data, &frame.len) == SUCCESS){
+            m_rcv_callback(frame.data, frame.len);
+        }
+    }
+}
+
+EventLoop *ProtectLayer::getEventLoop()
+{
+    return &m_loop;
+}
+
 uint8_t ProtectLayer::getNodeID()
 {
     return BS_NODE_ID;
 }
 
+uint8_t ProtectLayer::startPipeline(ReceiveCallback callback, unsigned workers_num)
+{
+    if(m_pipeline){
+        return FAIL;
+    }
+
+    m_pipeline = new ReceivePipeline(&m_crypto, m_mac.macSize(), callback, workers_num);
+
+    // data received by receive() but not processed yet go first, the event loop passes the following frames
+    FrameView frame;
+    while(m_rcvd_ring.nextFrame(&frame)){
+        m_pipeline->submit(frame.data, frame.len);
+    }
+    m_rcvd_ring.clear();
+
+    return SUCCESS;
+}
+
+uint8_t ProtectLayer::stopPipeline()
+{
+    if(!m_pipeline){
+        return FAIL;
+    }
+
+    delete m_pipeline;
+    m_pipeline = NULL;
+
+    return SUCCESS;
+}
+
 #else
 #include "RF12.h"
 #include <avr/eeprom.h>
@@ -212,15 +324,16 @@ m_hash(&m_aes), m_mac(&m_aes), m_keydistrib(&m_neighbors), m_crypto(&m_aes, &m_m
     // initialize serial communication
     Serial.begin(BAUD_RATE);
 
-    // set received indicators to 0
-    memset(m_received, 0, 2);
-
     // read the node ID from EEPROM
     m_node_id = eeprom_read_byte(0);
 
+    // Trickle timers of neighbors must not run in lockstep, discoverNeighbors() seeds it again
+    randomSeed(m_node_id);
+
 #ifdef ENABLE_CTP
-    // set node ID to CTP class if enabled
+    // set node ID to CTP class if enabled, reports relayed by CTP and by receive() share the duplicate cache
     m_ctp.setNodeID(m_node_id);
+    m_ctp.setForwardCache(&m_forward_dups);
 #endif // ENABLE_CTP
 
     // initialize the radio
@@ -230,7 +343,13 @@ m_hash(&m_aes), m_mac(&m_aes), m_keydistrib(&m_neighbors), m_crypto(&m_aes, &m_m
 #ifdef ENABLE_CTP
 uint8_t ProtectLayer::startCTP()
 {
-    return m_ctp.startCTP(CTP_DURATION_MS);
+    if(m_ctp.startCTP(CTP_DURATION_MS) != SUCCESS){
+        return FAIL;
+    }
+
+    // report convergence with own distance, BS ends the establishment once all nodes reported
+    uint8_t distance = m_ctp.getDistance();
+    return sendToBS(MSG_CTP_DONE, &distance, 1);
 }
 
 uint8_t ProtectLayer::sendCTP(msg_type_t msg_type, uint8_t *buffer, uint8_t size)
@@ -299,7 +418,7 @@ uint8_t ProtectLayer::sendToBS(msg_type_t msg_type, uint8_t *buffer, uint8_t siz
     }
 
 #ifdef ENABLE_CTP
-    if(msg_type != MSG_FORWARD){
+    if(msg_type != MSG_FORWARD && msg_type != MSG_CTP_DONE){
         return FAIL;
     }
 
@@ -331,7 +450,7 @@ uint8_t ProtectLayer::forwardToBS(uint8_t *buffer, uint8_t size)
     SPHeader_t *header = reinterpret_cast<SPHeader_t*>(buffer);
 
     // check the message type to be sure it must be forwarded
-    if(header->msgType != MSG_FORWARD){
+    if(header->msgType != MSG_FORWARD && header->msgType != MSG_CTP_DONE){
         return FAIL;
     }
 
@@ -340,24 +459,47 @@ uint8_t ProtectLayer::forwardToBS(uint8_t *buffer, uint8_t size)
         return FAIL;
     }
 
-    // forward to a CTP parent
-    uint8_t rf12_header = createHeader(m_ctp.getParentID(), MODE_DST, DEFAULT_REQ_ACK);
-    rf12_sendNow(rf12_header, buffer, size);
-
-    return SUCCESS;
+    // forward to a CTP parent, an unresponsive parent is replaced by another neighbor
+    return m_ctp.sendToParent(buffer, size);
 }
 #endif // ENABLE_CTP
 
 uint8_t ProtectLayer::forwarduTESLA(uint8_t *buffer, uint8_t size)
 {
-    // does not work if they all resend it at once
-    delay(m_node_id * 20);
-
-    // send
+#ifdef ENABLE_UTESLA
+    // neighbors rebroadcast at random times, the ones that hear a copy first stay silent
+    return m_floods.schedule(buffer, size);
+#else
     uint8_t rf12_header = createHeader(m_node_id, MODE_SRC, DEFAULT_REQ_ACK);
     rf12_sendNow(rf12_header, buffer, size);
     
     return SUCCESS;
+#endif // ENABLE_UTESLA
+}
+
+bool ProtectLayer::waitReceiveFlooding(uint32_t end)
+{
+    while(1){
+#ifdef ENABLE_UTESLA
+        m_floods.service(m_node_id);
+#endif // ENABLE_UTESLA
+
+        // return false if the time has passed
+        if(millis() >= end){
+            return false;
+        }
+#ifdef ENABLE_UTESLA
+        idleUntil(m_floods.nextEvent(end));
+#else
+        idleUntil(end);
+#endif // ENABLE_UTESLA
+        // return true if packet was received
+        if(rf12_recvDone() && rf12_crc == 0){
+            return true;
+        }
+    }
+
+    return false;   // unreachable
 }
 
 uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size)
@@ -372,8 +514,8 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
         timeout = 1;
     }
 
-    // blocking receive
-    if(!waitReceive(millis() + timeout)){
+    // blocking receive, scheduled rebroadcasts are sent meanwhile
+    if(!waitReceiveFlooding(millis() + timeout)){
         // return ERR_TIMEOUT;
         return FAIL;
     }
@@ -384,6 +526,11 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
         return FAIL;
     }
 
+    // acknowledgements and truncated packets have no header to look at
+    if(rf12_len < SPHEADER_SIZE || (rf12_hdr & RF12_HDR_CTL)){
+        return FAIL;
+    }
+
     uint8_t rcvd_hdr;   // just to use macro copy_rf12_to_buffer
     uint8_t rcvd_len;
     uint8_t rcvd_buff[MAX_MSG_SIZE];
@@ -397,8 +544,20 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
     uint8_t rval;
 
 #ifdef ENABLE_CTP
+    // distance beacons keep parent candidates up to date, nothing for the app
+    if(header->msgType == MSG_CTP){
+        m_ctp.handleBeacon(rcvd_buff, rcvd_len);
+        return FAIL;
+    }
+
     // forward message if CTP is enabled
-    if(header->msgType == MSG_FORWARD){
+    if(header->msgType == MSG_FORWARD || header->msgType == MSG_CTP_DONE){
+        // the same message may arrive again - retransmitted or over another path, seq is the sender's counter hint
+        if(m_forward_dups.seen(header->sender, header->seq)){
+            return FAIL;
+        }
+        m_forward_dups.add(header->sender, header->seq);
+
         if((rval = forwardToBS(rcvd_buff, rcvd_len)) == SUCCESS){
             return FORWARD;
         }
@@ -413,19 +572,23 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
             return FAIL;
         }
 
-        // ignore already received message
-        // TODO use a sequence number or something like that - this will not work in some cases
-        if(rcvd_buff[rcvd_len - 5] == m_received[0]){
+        // ignore already received message - authenticated and taken by the app, or waiting for its key. It cannot
+        // be recorded before it is authenticated, a forged copy with the next sequence number would suppress it.
+        if(m_utesla_dups.seen(header->sender, header->seq) || m_utesla.isBuffered(rcvd_buff, rcvd_len)){
+            m_floods.heard(rcvd_buff, rcvd_len);
             return FAIL;
         }
-        m_received[0] = rcvd_buff[rcvd_len - 5];
 
         // not verifying anything, the key has not arrived yet
-        // forward, return SUCCESS and verify in app
+        // forward and keep the message until it is verified, the app takes it by receiveBroadcast()
         if(forwarduTESLA(rcvd_buff, rcvd_len) != SUCCESS){
             return FAIL;
         }
 
+        if(m_utesla.bufferMessage(rcvd_buff, rcvd_len) != SUCCESS){
+            return FAIL;
+        }
+
         if(buff_size < rcvd_len){
             return FAIL;
         }
@@ -433,26 +596,30 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
         memcpy(buffer, rcvd_buff, rcvd_len);
         *received_size = rcvd_len;
 
-        return SUCCESS;
+        return FORWARD;
     }
 
     if(header->msgType == MSG_UTESLA_KEY){
         // check the size
+#ifdef UTESLA_TWO_LEVEL
+        if(rcvd_len  != SPHEADER_SIZE + UTESLA_INDEX_SIZE + 1 + m_mac.macSize()){
+#else
         if(rcvd_len  != SPHEADER_SIZE + m_mac.macSize()){
+#endif
             return FAIL;
         }
 
         // ignore already received key
-        // TODO use a sequence number or something like that - this will not work in some cases
-        if(rcvd_buff[16] == m_received[1]){
+        if(m_utesla_dups.seen(header->sender, header->seq)){
+            m_floods.heard(rcvd_buff, rcvd_len);
             return FAIL;
         }
 
-        // update uTESLA key
+        // update uTESLA key, only a verified key is recorded so a forged copy cannot suppress the real one
         if(m_utesla.updateKey(rcvd_buff + SPHEADER_SIZE) != SUCCESS){
             return FAIL;
         }
-        m_received[1] = rcvd_buff[16];
+        m_utesla_dups.add(header->sender, header->seq);
 
         // forward the key
         if(forwarduTESLA(rcvd_buff, rcvd_len) != SUCCESS){
@@ -470,6 +637,39 @@ uint8_t ProtectLayer::receive(uint8_t *buffer, uint8_t buff_size, uint8_t *recei
         // return different value than SUCCESS so the app can skip it easily
         return FORWARD;
     }
+
+#ifdef UTESLA_TWO_LEVEL
+    if(header->msgType == MSG_UTESLA_CDM){
+        // check the size
+        if(rcvd_len != SPHEADER_SIZE + m_utesla.getCommitmentSize()){
+            return FAIL;
+        }
+
+        if(m_utesla_dups.seen(header->sender, header->seq)){
+            m_floods.heard(rcvd_buff, rcvd_len);
+            return FAIL;
+        }
+
+        // verifies the disclosed high-level key and the previous CDM, repeated CDMs fail and are not forwarded
+        if(m_utesla.processCommitment(rcvd_buff + SPHEADER_SIZE) != SUCCESS){
+            return FAIL;
+        }
+        m_utesla_dups.add(header->sender, header->seq);
+
+        if(forwarduTESLA(rcvd_buff, rcvd_len) != SUCCESS){
+            return FAIL;
+        }
+
+        if(buff_size < rcvd_len){
+            return FAIL;
+        }
+
+        memcpy(buffer, rcvd_buff, rcvd_len);
+        *received_size = rcvd_len;
+
+        return FORWARD;
+    }
+#endif // UTESLA_TWO_LEVEL
 #endif // ENABLE_UTESLA
     if(header->msgType == MSG_DISC){
         if(neighborHandshakeResponse(rcvd_buff, rcvd_len) == SUCCESS){
@@ -516,6 +716,20 @@ uint8_t ProtectLayer::verifyMessage(uint8_t *data, uint8_t data_size)
 {
     return m_utesla.verifyMessage(data, data_size);
 }
+
+uint8_t ProtectLayer::receiveBroadcast(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size)
+{
+    if(m_utesla.getVerifiedMessage(buffer, buff_size, received_size) != SUCCESS){
+        return FAIL;
+    }
+
+    // authenticated, copies arriving after it left the buffer are duplicates. The app may take it late, after keys
+    // and CDMs with newer numbers were recorded
+    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(buffer);
+    m_utesla_dups.addDelayed(header->sender, header->seq);
+
+    return SUCCESS;
+}
 #endif // ENABLE_UTESLA
 
 uint8_t ProtectLayer::neighborHandshake(uint8_t node_id)
@@ -527,6 +741,7 @@ uint8_t ProtectLayer::neighborHandshake(uint8_t node_id)
     spheader->msgType = MSG_DISC;
     spheader->sender = m_node_id;
     spheader->receiver = node_id;
+    spheader->seq = 0;
 
     // create some nonce
     uint32_t own_nonce = random();
@@ -541,14 +756,14 @@ uint8_t ProtectLayer::neighborHandshake(uint8_t node_id)
 
     uint32_t start = millis();
     while(waitReceive(start + DISC_NEIGHBOR_RSP_TIME)){
-        // check the header
+        // check the header, acknowledgements carry headers of other messages
         spheader = reinterpret_cast<volatile SPHeader_t*>(rf12_data);
-        if(spheader->msgType != MSG_DISC || spheader->sender != node_id){
+        if((rf12_hdr & RF12_HDR_CTL) || spheader->msgType != MSG_DISC || spheader->sender != node_id){
             continue;
         }
 
         // copy the message
-        memcpy(msg_buffer, rf12_data, rf12_len);
+        memcpy(msg_buffer, (const void*) rf12_data, rf12_len);
         uint8_t msg_size = rf12_len;
         rf12_recvDone();
 
@@ -581,14 +796,14 @@ uint8_t ProtectLayer::neighborHandshake(uint8_t node_id)
         rf12_sendNow(rf12_header, msg_buffer, msg_size);
 
         while(waitReceive(start + DISC_NEIGHBOR_RSP_TIME)){
-            // check the header
+            // check the header, acknowledgements carry headers of other messages
             spheader = reinterpret_cast<volatile SPHeader_t*>(rf12_data);
-            if(spheader->msgType != MSG_DISC || spheader->sender != node_id){
+            if((rf12_hdr & RF12_HDR_CTL) || spheader->msgType != MSG_DISC || spheader->sender != node_id){
                 continue;
             }
 
             // copy the message
-            memcpy(msg_buffer, rf12_data, rf12_len);
+            memcpy(msg_buffer, (const void*) rf12_data, rf12_len);
             msg_size = rf12_len;
             rf12_recvDone();
 
@@ -661,14 +876,14 @@ uint8_t ProtectLayer::neighborHandshakeResponse(uint8_t *msg_buffer, uint8_t msg
 
     uint32_t start = millis();
     while(waitReceive(start + DISC_NEIGHBOR_RSP_TIME)){
-        // check the header
+        // check the header, acknowledgements carry headers of other messages
         spheader = reinterpret_cast<volatile SPHeader_t*>(rf12_data);
-        if(spheader->msgType != MSG_DISC || spheader->sender != other_id){
+        if((rf12_hdr & RF12_HDR_CTL) || spheader->msgType != MSG_DISC || spheader->sender != other_id){
             continue;
         }
 
         // copy the message
-        memcpy(msg_buffer, rf12_data, rf12_len);
+        memcpy(msg_buffer, (const void*) rf12_data, rf12_len);
         msg_size = rf12_len;
         rf12_recvDone();
 
@@ -762,5 +977,25 @@ uint32_t ProtectLayer::getNeighbors()
     return m_neighbors;
 }
 
+void ProtectLayer::getCounters(PLCounters_t *counters)
+{
+    memset(counters, 0, sizeof(PLCounters_t));
+#ifdef ENABLE_CTP
+    counters->forward_dups = m_forward_dups.getDuplicates();
+#endif
+#ifdef ENABLE_UTESLA
+    counters->utesla_dups = m_utesla_dups.getDuplicates() + m_utesla.getBufferedDuplicates();
+    counters->floods_sent = m_floods.getSent();
+    counters->floods_suppressed = m_floods.getSuppressed();
+#endif
+}
+
+#ifdef ENABLE_CTP
+CTP *ProtectLayer::getCTP()
+{
+    return &m_ctp;
+}
+#endif // ENABLE_CTP
+
 #endif
 
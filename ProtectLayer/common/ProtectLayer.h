@@ -18,15 +18,29 @@
 
 #ifdef __linux__
 #include <string>
-#include <deque>
 
 #include "uTESLAMaster.h"
 #include "configurator.h"
-
-#define RCVD_BUFFER_SIZE    1024
+#include "AESNI.h"
+#include "ReceivePipeline.h"
+#include "FrameRing.h"
+#include "EventLoop.h"
 
 #else 
 #include "uTESLAClient.h"
+#include "DuplicateCache.h"
+#include "Trickle.h"
+
+/**
+ * @brief Counters of node's duplicate suppression, see ProtectLayer::getCounters()
+ * 
+ */
+typedef struct _PLCounters {
+    uint16_t    forward_dups;       // duplicate messages dropped instead of forwarding to BS
+    uint16_t    utesla_dups;        // duplicate uTESLA floods
+    uint16_t    floods_sent;        // uTESLA rebroadcasts sent
+    uint16_t    floods_suppressed;  // uTESLA rebroadcasts suppressed by Trickle
+} PLCounters_t;
 #endif
 
 /**
@@ -37,31 +51,72 @@
 class ProtectLayer {
 private:
     AES             m_aes;          // single-block AES encryption
-    AEShash         m_hash;         // AES-based hash computation, uses m_aes for encryption
-    AESMAC          m_mac;          // AES-based MAC computation, uses m_aes for encryption
+#ifdef __linux__
+    Cipher          *m_cipher;      // AES implementation used by BS - AES-NI if available, m_aes otherwise
+#endif
+    AEShash         m_hash;         // AES-based hash computation, uses m_aes (m_cipher on BS) for encryption
+    AESMAC          m_mac;          // AES-based MAC computation, uses m_aes (m_cipher on BS) for encryption
     KeyDistrib      m_keydistrib;   // provides keys for m_crypto
-    Crypto          m_crypto;       // provides all crypto operations, uses m_aes, m_hash and m_mac
+    Crypto          m_crypto;       // provides all crypto operations, uses m_aes (m_cipher on BS), m_hash and m_mac
+#ifdef __linux__
+    EventLoop       m_loop;         // serves the slave device, used by m_ctp and m_utesla too
+#endif
 
 #ifdef ENABLE_CTP
     CTP             m_ctp;          // class providing CTP establishment, required when routing to BS
 #endif // ENABLE_CTP
 
-    uint8_t         m_received[2];  // one byte of last received MAC or key - not to rebroadcast already rebroadcasted message or key
-                                    // TODO use sequence number or something
-
 #ifdef __linux__
     uTeslaMaster    *m_utesla;      // uTESLA class for BS
     int             m_slave_fd;     // file descriptor of slave JeeLink device
-    std::deque<uint8_t> m_rcvd_queue;
+    uint8_t         m_slave_device; // slave device in m_loop
+    FrameRing       m_rcvd_ring;    // frames received from slave device, not yet processed by receive()
+    ReceiveCallback m_rcv_callback; // receives decrypted messages from the event loop, empty if receive() is used
+    ReceivePipeline *m_pipeline;    // multi-threaded receive pipeline, NULL if not running
+
+    /**
+     * @brief Handle frame received by the slave device - pass it to m_pipeline or m_rcv_callback or keep it for receive()
+     * 
+     * @param data      Frame
+     * @param len       Frame length
+     */
+    void handleFrame(uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Check and decrypt received frame in place
+     * 
+     * @param data      Frame
+     * @param len       Frame length, set to the length of the message without MAC
+     * @return uint8_t  SUCCESS, FAIL or ERR_BUFFSIZE if the frame is too long
+     */
+    uint8_t unprotectFrame(uint8_t *data, uint8_t *len);
+
+    /**
+     * @brief Build protected message for a node
+     * 
+     * @param msg_type  Type of the message (MSG_APP or MSG_OTHER)
+     * @param receiver  Recipient
+     * @param buffer    Data to be sent
+     * @param size      Size of the data
+     * @param message   Protected message, at least MAX_MSG_SIZE bytes
+     * @param msg_size  Size of the protected message
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t protectMessage(msg_type_t msg_type, uint8_t receiver, const uint8_t *buffer, uint8_t size, uint8_t *message, uint8_t *msg_size);
 #else
     uint8_t         m_node_id;      // this node's ID
     uint32_t        m_neighbors;    // active neighors, available only after neighbor discovery
 #ifdef ENABLE_UTESLA
     uTeslaClient    m_utesla;       // uTESLA class for ordinary node (not a BS)
+    DuplicateCache  m_utesla_dups;  // uTESLA floods already received - not to rebroadcast them again
+    FloodScheduler  m_floods;       // rebroadcasts of uTESLA floods
+#endif
+#ifdef ENABLE_CTP
+    DuplicateCache  m_forward_dups; // messages already forwarded to BS
 #endif
 
     /**
-     * @brief Forward uTESLA messages
+     * @brief Forward uTESLA messages - schedule the rebroadcast, it is sent while receive() waits for messages
      * 
      * @param buffer    Message
      * @param size      Message length
@@ -69,6 +124,15 @@ private:
      */
     uint8_t forwarduTESLA(uint8_t *buffer, uint8_t size);
 
+    /**
+     * @brief Wait for a message and send scheduled rebroadcasts meanwhile
+     * 
+     * @param end       Termination time
+     * @return true     Message was received
+     * @return false    Time has passed
+     */
+    bool waitReceiveFlooding(uint32_t end);
+
     /**
      * @brief Start neighbor handshake in neighbor discovery process. Sends protected nonce and expects it back incremented.
      * 
@@ -127,6 +191,57 @@ public:
      * @return uint8_t  SUCCESS or FAIL
      */
     uint8_t sendTo(msg_type_t msg_type, uint8_t receiver, uint8_t *buffer, uint8_t size);
+
+    /**
+     * @brief Queue a message for a single node within one hop protected by encryption and MAC. Returns immediately,
+     * the result is passed to the callback from the event loop.
+     * 
+     * @param msg_type  Type of the message (MSG_APP or MSG_OTHER)
+     * @param receiver  Recipient
+     * @param buffer    Data to be sent
+     * @param size      Size of the data
+     * @param callback  Completion called with ERR_OK or an error code, can be empty
+     * @return uint8_t  SUCCESS or FAIL if the message could not be queued
+     */
+    uint8_t sendToAsync(msg_type_t msg_type, uint8_t receiver, uint8_t *buffer, uint8_t size, SendCallback callback);
+
+    /**
+     * @brief Set callback for received messages. Messages are decrypted and passed to it from the event loop,
+     * receive() must not be used while it is set. Empty callback switches back to receive().
+     * 
+     * @param callback  Callback for received messages (decrypted, including header)
+     */
+    void setReceiveCallback(ReceiveCallback callback);
+
+    /**
+     * @brief Get the event loop serving the slave device. Asynchronous sends, received messages and timers are processed
+     * only while the loop runs - by run() or runUntil() in application's thread or inside blocking methods of ProtectLayer.
+     * 
+     * @return EventLoop*   Event loop
+     */
+    EventLoop *getEventLoop();
+
+    /**
+     * @brief Start receiving messages in a pipeline - the event loop passes frames from the slave device to worker
+     * threads which decrypt and verify them. Messages from a single node are passed to the callback in order and always
+     * from the same thread. Frames arrive only while the loop runs. receive() must not be used and the callback of
+     * setReceiveCallback() is bypassed while the pipeline is running. A worker that falls behind by PIPELINE_QUEUE_LEN
+     * frames drops the following ones. Messages can be sent meanwhile, the counter of a key that a worker shares with
+     * the sending thread is guarded by KeyDistrib.
+     * 
+     * @param callback      Callback for received messages (decrypted, including header)
+     * @param workers_num   Number of worker threads
+     * @return uint8_t      SUCCESS or FAIL if the pipeline is already running
+     */
+    uint8_t startPipeline(ReceiveCallback callback, unsigned workers_num);
+
+    /**
+     * @brief Stop the receive pipeline, messages that have already been read are processed before it returns.
+     * Must not be called while the event loop runs in another thread.
+     * 
+     * @return uint8_t      SUCCESS or FAIL if the pipeline is not running
+     */
+    uint8_t stopPipeline();
 #else
 
     /**
@@ -184,7 +299,8 @@ public:
      * @param buff_size     Size of the buffer for received message
      * @param received_size Size of the received message
      * @param timeout       Time in milliseconds to wait for a message
-     * @return uint8_t      SUCCESS on success, FAIL on failure or FORWARD if the message was intended for BS
+     * @return uint8_t      SUCCESS on success, FAIL on failure or FORWARD if the message was intended for BS or it is
+     *                      a uTESLA message - broadcasts are delivered by receiveBroadcast() once they are authenticated
      */
     uint8_t receive(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size, uint16_t timeout);
 
@@ -197,6 +313,17 @@ public:
      * @return uint8_t  SUCCESS or FAIL
      */
     uint8_t verifyMessage(uint8_t *data, uint8_t data_size);
+
+    /**
+     * @brief Take the oldest authenticated uTESLA broadcast. Broadcasts are kept by receive() until their key arrives,
+     * call this after receive() returns FORWARD for MSG_UTESLA_KEY.
+     * 
+     * @param buffer        Buffer for the message (including header and MAC)
+     * @param buff_size     Size of the buffer
+     * @param received_size Size of the message
+     * @return uint8_t      SUCCESS or FAIL if there is no authenticated broadcast
+     */
+    uint8_t receiveBroadcast(uint8_t *buffer, uint8_t buff_size, uint8_t *received_size);
 #endif // ENABLE_UTESLA
 
     /**
@@ -213,6 +340,22 @@ public:
      */
     uint32_t getNeighbors();
 
+    /**
+     * @brief Get counters of duplicate suppression
+     * 
+     * @param counters  Output, counters of disabled features are 0
+     */
+    void getCounters(PLCounters_t *counters);
+
+#ifdef ENABLE_CTP
+    /**
+     * @brief Get CTP of the node, e.g. to read its parent and route cost
+     * 
+     * @return CTP*     CTP
+     */
+    CTP *getCTP();
+#endif // ENABLE_CTP
+
 #endif  // __linux__
 
     /**
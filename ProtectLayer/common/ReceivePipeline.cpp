@@ -0,0 +1,140 @@
+/**
+ * @brief Implementation of the multi-threaded receive pipeline for the Linux base station
+ *
+ * @file    ReceivePipeline.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifdef __linux__
+
+#include "ReceivePipeline.h"
+
+#include <cstring>
+
+
+ReceivePipeline::ReceivePipeline(Crypto *crypto, uint8_t mac_size, ReceiveCallback callback, unsigned workers_num):
+m_crypto(crypto), m_mac_size(mac_size), m_callback(callback), m_running(true), m_received(0), m_failed(0), m_dropped(0)
+{
+    if(workers_num < 1){
+        workers_num = 1;
+    }
+
+    for(unsigned i=0;i<workers_num;i++){
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+    }
+
+    // start threads after all workers exist
+    for(unsigned i=0;i<workers_num;i++){
+        Worker *worker = m_workers[i].get();
+        worker->thread = std::thread(&ReceivePipeline::workerLoop, this, worker);
+    }
+}
+
+ReceivePipeline::~ReceivePipeline()
+{
+    stop();
+}
+
+uint8_t ReceivePipeline::submit(const uint8_t *data, uint8_t len)
+{
+    if(!data || !m_running){
+        return FAIL;
+    }
+
+    // same checks as in ProtectLayer::receive()
+    if(len < SPHEADER_SIZE + m_mac_size + 1 || len > MAX_MSG_SIZE){
+        return FAIL;
+    }
+
+    const SPHeader_t *header = reinterpret_cast<const SPHeader_t*>(data);
+    if(header->receiver != BS_NODE_ID){
+        return FAIL;
+    }
+
+    // messages from a node always go to the same worker, so they are unprotected in order
+    Worker *worker = m_workers[header->sender % m_workers.size()].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if(worker->queue.size() >= PIPELINE_QUEUE_LEN){
+            m_dropped++;
+            return ERR_BUFFSIZE;
+        }
+        worker->queue.push_back(Frame());
+        memcpy(worker->queue.back().data, data, len);
+        worker->queue.back().len = len;
+    }
+    worker->cond.notify_one();
+
+    return SUCCESS;
+}
+
+void ReceivePipeline::stop()
+{
+    if(!m_running.exchange(false)){
+        return;
+    }
+
+    // workers finish their queues and stop
+    for(std::unique_ptr<Worker> &worker: m_workers){
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->cond.notify_all();
+        worker->thread.join();
+    }
+}
+
+uint32_t ReceivePipeline::getReceivedCount()
+{
+    return m_received;
+}
+
+uint32_t ReceivePipeline::getFailedCount()
+{
+    return m_failed;
+}
+
+uint32_t ReceivePipeline::getDroppedCount()
+{
+    return m_dropped;
+}
+
+void ReceivePipeline::workerLoop(Worker *worker)
+{
+    std::deque<Frame> batch;
+    std::unique_lock<std::mutex> lock(worker->mutex);
+
+    while(true){
+        worker->cond.wait(lock, [&](){ return !worker->queue.empty() || !m_running; });
+        if(worker->queue.empty()){
+            break;  // stopping and everything has been processed
+        }
+
+        // take all queued frames at once, so the lock is not held while decrypting
+        batch.swap(worker->queue);
+        lock.unlock();
+        for(Frame &frame: batch){
+            processFrame(frame);
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+void ReceivePipeline::processFrame(Frame &frame)
+{
+    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(frame.data);
+    uint8_t len = frame.len;
+
+    // decrypt and verify MAC
+    if(m_crypto->unprotectBufferFromNodeB(header->sender, frame.data, SPHEADER_SIZE, &len) != SUCCESS){
+        m_failed++;
+        return;
+    }
+
+    m_received++;
+    m_callback(frame.data, len - m_mac_size);
+}
+
+#endif // __linux__
@@ -0,0 +1,152 @@
+/**
+ * @brief Multi-threaded receive pipeline for the Linux base station. Frames are submitted by the event loop
+ * serving the slave device, worker threads decrypt and verify them and pass plaintexts to the application.
+ *
+ * @file    ReceivePipeline.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef RECEIVEPIPELINE_H
+#define RECEIVEPIPELINE_H
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ProtectLayerGlobals.h"
+#include "Crypto.h"
+
+// frames waiting for a single worker, more are dropped when the worker does not keep up
+#ifndef PIPELINE_QUEUE_LEN
+#define PIPELINE_QUEUE_LEN  256
+#endif
+
+/**
+ * @brief Callback for received messages. Called from worker threads, messages of a single node always
+ * from the same thread and in the order of arrival.
+ *
+ * @param data  Decrypted message including header
+ * @param size  Size of the message
+ */
+typedef std::function<void(const uint8_t *data, uint8_t size)> ReceiveCallback;
+
+/**
+ * @brief Receive pipeline. Frames are distributed among workers by sender's ID, so messages from a node
+ * are always processed by the same worker in order. Other threads may use the node's key meanwhile (sending
+ * to the node), its counter is guarded by KeyDistrib's lock.
+ * Each worker queues at most PIPELINE_QUEUE_LEN frames.
+ *
+ */
+class ReceivePipeline {
+private:
+    /**
+     * @brief Received frame waiting for a worker
+     *
+     */
+    struct Frame {
+        uint8_t data[MAX_MSG_SIZE];
+        uint8_t len;
+    };
+
+    /**
+     * @brief Worker thread with its queue
+     *
+     */
+    struct Worker {
+        std::thread             thread;
+        std::mutex              mutex;
+        std::condition_variable cond;
+        std::deque<Frame>       queue;
+    };
+
+    Crypto                  *m_crypto;          // unprotects messages, must be re-entrant
+    uint8_t                 m_mac_size;         // size of the MAC appended to messages
+    ReceiveCallback         m_callback;         // receives decrypted messages
+    std::vector< std::unique_ptr<Worker> > m_workers;   // worker threads
+    std::atomic<bool>       m_running;          // false when the pipeline is stopping
+    std::atomic<uint32_t>   m_received;         // messages passed to callback
+    std::atomic<uint32_t>   m_failed;           // messages dropped because of verification failure
+    std::atomic<uint32_t>   m_dropped;          // frames dropped because the worker's queue was full
+
+    /**
+     * @brief Worker thread, unprotects frames from its queue
+     *
+     * @param worker    Worker's structure
+     */
+    void workerLoop(Worker *worker);
+
+    /**
+     * @brief Decrypt and verify a frame and pass it to callback
+     *
+     * @param frame     Received frame
+     */
+    void processFrame(Frame &frame);
+
+public:
+    /**
+     * @brief Constructor, starts worker threads
+     *
+     * @param crypto        Crypto used to unprotect messages
+     * @param mac_size      Size of the MAC appended to messages
+     * @param callback      Callback for decrypted messages
+     * @param workers_num   Number of worker threads, at least one is started
+     */
+    ReceivePipeline(Crypto *crypto, uint8_t mac_size, ReceiveCallback callback, unsigned workers_num);
+
+    /**
+     * @brief Destructor, stops the pipeline
+     *
+     */
+    virtual ~ReceivePipeline();
+
+    /**
+     * @brief Pass a single frame to the workers, e.g. from the event loop's frame callback or a replay source
+     *
+     * @param data      Protected message including header
+     * @param len       Size of the message
+     * @return uint8_t  SUCCESS, FAIL if the message is not for BS or its size is invalid or ERR_BUFFSIZE
+     *                  if the worker's queue is full and the frame was dropped
+     */
+    uint8_t submit(const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Let workers process frames that are already queued and stop them, no more frames are accepted
+     *
+     */
+    void stop();
+
+    /**
+     * @brief Get number of messages passed to the callback
+     *
+     * @return uint32_t Number of messages
+     */
+    uint32_t getReceivedCount();
+
+    /**
+     * @brief Get number of messages dropped because of failed decryption or verification
+     *
+     * @return uint32_t Number of messages
+     */
+    uint32_t getFailedCount();
+
+    /**
+     * @brief Get number of frames dropped because the worker's queue was full
+     *
+     * @return uint32_t Number of frames
+     */
+    uint32_t getDroppedCount();
+};
+
+#endif // __linux__
+
+#endif // RECEIVEPIPELINE_H
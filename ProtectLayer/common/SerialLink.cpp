@@ -0,0 +1,153 @@
+/**
+ * @brief Implementation of the serial link framing
+ *
+ * @file    SerialLink.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include "SerialLink.h"
+
+#include <string.h>
+
+// CRC-16/CCITT-FALSE processed by nibbles - small enough for the slave, fast enough for the host
+static const uint16_t crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t linkCRC(const uint8_t *data, uint8_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    for(uint8_t i=0;i<len;i++){
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+
+    return crc;
+}
+
+uint8_t linkEncode(const uint8_t *record, uint8_t len, uint8_t *out)
+{
+    uint8_t raw[LINK_MAX_RECORD + LINK_CRC_SIZE];
+
+    if(!len || len > LINK_MAX_RECORD){
+        return 0;
+    }
+
+    memcpy(raw, record, len);
+    uint16_t crc = linkCRC(record, len);
+    raw[len] = crc >> 8;
+    raw[len + 1] = crc & 0xFF;
+    len += LINK_CRC_SIZE;
+
+    // each code byte tells the distance to the next zero, records are shorter than 254 bytes
+    uint8_t code_pos = 0;
+    uint8_t out_pos = 1;
+    for(uint8_t i=0;i<len;i++){
+        if(raw[i] == LINK_DELIMITER){
+            out[code_pos] = out_pos - code_pos;
+            code_pos = out_pos++;
+        } else {
+            out[out_pos++] = raw[i];
+        }
+    }
+    out[code_pos] = out_pos - code_pos;
+    out[out_pos++] = LINK_DELIMITER;
+
+    return out_pos;
+}
+
+LinkDecoder::LinkDecoder(): m_len(0), m_record_len(0), m_overflow(false), m_errors(0) { }
+
+uint16_t LinkDecoder::feed(const uint8_t *data, uint16_t len)
+{
+    m_record_len = 0;
+
+    const uint8_t *delimiter = (const uint8_t*) memchr(data, LINK_DELIMITER, len);
+    uint16_t copy_len = delimiter ? delimiter - data : len;
+
+    if(copy_len > sizeof(m_buffer) - m_len){
+        m_overflow = true;
+    } else {
+        memcpy(m_buffer + m_len, data, copy_len);
+        m_len += copy_len;
+    }
+
+    if(!delimiter){
+        return len;
+    }
+
+    // empty records between delimiters are ignored, sender may use them to flush garbage
+    if(m_overflow){
+        m_errors++;
+    } else if(m_len){
+        decode();
+    }
+
+    m_len = 0;
+    m_overflow = false;
+
+    return copy_len + 1;
+}
+
+bool LinkDecoder::push(uint8_t byte)
+{
+    feed(&byte, 1);
+
+    return m_record_len > 0;
+}
+
+void LinkDecoder::decode()
+{
+    uint8_t read = 0;
+    uint8_t write = 0;
+
+    // decoded data are never longer than encoded ones, so it is decoded in place
+    while(read < m_len){
+        uint8_t code = m_buffer[read++];
+        if(read + code - 1 > m_len){
+            m_errors++;
+            return;
+        }
+
+        for(uint8_t i=1;i<code;i++){
+            m_buffer[write++] = m_buffer[read++];
+        }
+
+        // zero was replaced by the code, except at the end of the record and after a full block
+        if(code < 0xFF && read < m_len){
+            m_buffer[write++] = LINK_DELIMITER;
+        }
+    }
+
+    if(write < 1 + LINK_CRC_SIZE){
+        m_errors++;
+        return;
+    }
+
+    write -= LINK_CRC_SIZE;
+    uint16_t crc = ((uint16_t) m_buffer[write] << 8) | m_buffer[write + 1];
+    if(crc != linkCRC(m_buffer, write)){
+        m_errors++;
+        return;
+    }
+
+    m_record_len = write;
+}
+
+uint8_t *LinkDecoder::record()
+{
+    return m_buffer;
+}
+
+uint8_t LinkDecoder::recordLen()
+{
+    return m_record_len;
+}
+
+uint32_t LinkDecoder::errorCount()
+{
+    return m_errors;
+}
@@ -0,0 +1,118 @@
+/**
+ * @brief Framing of the serial link between BS host and BS slave. Every record is followed by CRC-16 and encoded
+ * by COBS (Consistent Overhead Byte Stuffing), so it contains no zero byte and is terminated by a zero delimiter.
+ * A receiver resynchronizes at the next delimiter after any corrupted or lost byte.
+ *
+ * @file    SerialLink.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SERIALLINK_H
+#define SERIALLINK_H
+
+#include <stdint.h>
+
+#include "ProtectLayerGlobals.h"
+
+// record types - first byte of every record
+#define LINK_MSG            1       // host to slave: [LINK_MSG][seq][message] to broadcast
+#define LINK_STATUS         2       // slave to host: [LINK_STATUS][ERR_*][seq] when the message was passed to the radio
+#define LINK_FRAME          3       // slave to host: [LINK_FRAME][message] received by the radio
+
+#define LINK_DELIMITER      0x00                            // terminates encoded records
+#define LINK_CRC_SIZE       2                               // CRC-16 appended to each record
+#define LINK_MAX_RECORD     (MAX_MSG_SIZE + 2)              // longest record - LINK_MSG with seq
+#define LINK_MAX_ENCODED    (LINK_MAX_RECORD + LINK_CRC_SIZE + 2)   // COBS adds a byte per 254 bytes, plus delimiter
+
+#if LINK_MAX_RECORD + LINK_CRC_SIZE > 254
+#error "Records longer than 254 bytes need more COBS overhead"
+#endif
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+ *
+ * @param data      Data
+ * @param len       Data length
+ * @return uint16_t CRC
+ */
+uint16_t linkCRC(const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Append CRC to a record and encode it for the serial link
+ *
+ * @param record    Record starting with its type
+ * @param len       Record length, at most LINK_MAX_RECORD
+ * @param out       Encoded record including delimiter, at least LINK_MAX_ENCODED bytes
+ * @return uint8_t  Length of the encoded record or 0 if the record is too long
+ */
+uint8_t linkEncode(const uint8_t *record, uint8_t len, uint8_t *out);
+
+/**
+ * @brief Decoder of records from the serial link. Bytes are copied up to the delimiter, then the record is decoded
+ * in place and its CRC is checked. Corrupted records are dropped.
+ *
+ */
+class LinkDecoder {
+private:
+    uint8_t     m_buffer[LINK_MAX_ENCODED]; // encoded bytes of the current record, decoded record when complete
+    uint8_t     m_len;                      // number of bytes in m_buffer
+    uint8_t     m_record_len;               // length of the decoded record, 0 if there is none
+    bool        m_overflow;                 // current record is too long, it is dropped at the delimiter
+    uint32_t    m_errors;                   // number of dropped records
+
+    /**
+     * @brief Decode COBS in place and check CRC of the buffered record
+     *
+     */
+    void decode();
+
+public:
+    /**
+     * @brief Constructor
+     *
+     */
+    LinkDecoder();
+
+    /**
+     * @brief Process received bytes up to and including the first delimiter. Record completed by the delimiter
+     * is available by record() until the next call.
+     *
+     * @param data      Received bytes
+     * @param len       Number of bytes
+     * @return uint16_t Number of bytes consumed, the rest has to be passed in the next call
+     */
+    uint16_t feed(const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief Process a single received byte
+     *
+     * @param byte      Received byte
+     * @return true     A record is complete
+     * @return false    Otherwise
+     */
+    bool push(uint8_t byte);
+
+    /**
+     * @brief Get the complete record without CRC
+     *
+     * @return uint8_t* Record starting with its type
+     */
+    uint8_t *record();
+
+    /**
+     * @brief Get length of the complete record
+     *
+     * @return uint8_t  Record length, 0 if no record is complete
+     */
+    uint8_t recordLen();
+
+    /**
+     * @brief Get number of records dropped because of CRC, encoding or length errors
+     *
+     * @return uint32_t Number of errors
+     */
+    uint32_t errorCount();
+};
+
+#endif // SERIALLINK_H
@@ -0,0 +1,172 @@
+/**
+ * @brief Implementation of the Trickle timer
+ *
+ * @file    Trickle.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef __linux__
+
+#include "Trickle.h"
+
+#include <RF12.h>
+
+#include "common.h"
+
+TrickleTimer::TrickleTimer(uint32_t imin, uint8_t doublings, uint8_t k):
+m_imin(imin), m_imax(imin << doublings), m_k(k), m_interval(imin), m_start(0), m_fire(0), m_counter(0), m_fired(true)
+{
+
+}
+
+void TrickleTimer::startInterval(uint32_t now)
+{
+    m_start = now;
+    m_fire = m_interval / 2 + random(m_interval / 2);
+    m_counter = 0;
+    m_fired = false;
+}
+
+void TrickleTimer::start(uint32_t now)
+{
+    m_interval = m_imin;
+    startInterval(now);
+}
+
+void TrickleTimer::consistent()
+{
+    if(m_counter < UINT8_MAX){
+        m_counter++;
+    }
+}
+
+void TrickleTimer::reset(uint32_t now)
+{
+    if(m_interval != m_imin){
+        start(now);
+    }
+}
+
+uint8_t TrickleTimer::poll(uint32_t now)
+{
+    // transmit unless enough neighbors did
+    if(!m_fired && now - m_start >= m_fire){
+        m_fired = true;
+        return m_counter < m_k ? TRICKLE_TRANSMIT : TRICKLE_SUPPRESSED;
+    }
+
+    if(now - m_start >= m_interval){
+        bool expired = m_interval >= m_imax;
+        if(!expired){
+            m_interval *= 2;
+        }
+        startInterval(now);
+
+        if(expired){
+            return TRICKLE_EXPIRED;
+        }
+    }
+
+    return TRICKLE_WAIT;
+}
+
+uint32_t TrickleTimer::nextEvent()
+{
+    return m_start + (m_fired ? m_interval : m_fire);
+}
+
+bool TrickleTimer::lastInterval()
+{
+    return m_interval >= m_imax;
+}
+
+FloodScheduler::FloodScheduler(): m_next(0), m_sent(0), m_suppressed(0)
+{
+    for(uint8_t i=0;i<TRICKLE_FLOOD_SLOTS;i++){
+        m_slots[i].size = 0;
+    }
+}
+
+uint8_t FloodScheduler::schedule(const uint8_t *message, uint8_t size)
+{
+    if(size > MAX_MSG_SIZE || size < SPHEADER_SIZE){
+        return FAIL;
+    }
+
+    // free slot or the one scheduled the longest time ago
+    FloodSlot_t *slot = &m_slots[m_next];
+    for(uint8_t i=0;i<TRICKLE_FLOOD_SLOTS;i++){
+        if(!m_slots[i].size){
+            slot = &m_slots[i];
+            break;
+        }
+    }
+    if(slot == &m_slots[m_next]){
+        m_next = (m_next + 1) % TRICKLE_FLOOD_SLOTS;
+    }
+
+    memcpy(slot->data, message, size);
+    slot->size = size;
+    slot->timer.start(millis());
+
+    return SUCCESS;
+}
+
+void FloodScheduler::heard(const uint8_t *message, uint8_t size)
+{
+    for(uint8_t i=0;i<TRICKLE_FLOOD_SLOTS;i++){
+        if(m_slots[i].size == size && !memcmp(m_slots[i].data, message, size)){
+            m_slots[i].timer.consistent();
+        }
+    }
+}
+
+void FloodScheduler::service(uint8_t node_id)
+{
+    for(uint8_t i=0;i<TRICKLE_FLOOD_SLOTS;i++){
+        if(!m_slots[i].size){
+            continue;
+        }
+
+        switch(m_slots[i].timer.poll(millis())){
+        case TRICKLE_TRANSMIT:
+            rf12_sendNow(createHeader(node_id, MODE_SRC, DEFAULT_REQ_ACK), m_slots[i].data, m_slots[i].size);
+            m_sent++;
+            break;
+        case TRICKLE_SUPPRESSED:
+            m_suppressed++;
+            // neighbors covered the last interval as well, the slot is not needed any more
+            if(m_slots[i].timer.lastInterval()){
+                m_slots[i].size = 0;
+            }
+            break;
+        case TRICKLE_EXPIRED:
+            m_slots[i].size = 0;
+            break;
+        }
+    }
+}
+
+uint32_t FloodScheduler::nextEvent(uint32_t end)
+{
+    for(uint8_t i=0;i<TRICKLE_FLOOD_SLOTS;i++){
+        if(m_slots[i].size && (int32_t) (m_slots[i].timer.nextEvent() - end) < 0){
+            end = m_slots[i].timer.nextEvent();
+        }
+    }
+
+    return end;
+}
+
+uint16_t FloodScheduler::getSent()
+{
+    return m_sent;
+}
+
+uint16_t FloodScheduler::getSuppressed()
+{
+    return m_suppressed;
+}
+
+#endif // __linux__
@@ -0,0 +1,183 @@
+/**
+ * @brief Trickle timer (RFC 6206) - suppression of redundant transmissions of floods and beacons
+ *
+ * @file    Trickle.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef TRICKLE_H
+#define TRICKLE_H
+
+#ifndef __linux__
+
+#include <Arduino.h>
+
+#include "ProtectLayerGlobals.h"
+
+// results of TrickleTimer::poll()
+#define TRICKLE_WAIT        0       // nothing to do
+#define TRICKLE_TRANSMIT    1       // transmit now
+#define TRICKLE_EXPIRED     2       // the longest interval ended
+#define TRICKLE_SUPPRESSED  3       // transmission was suppressed by redundant ones
+
+/**
+ * @brief Trickle timer. Interval I starts at Imin, the transmission is planned at a random time in [I/2, I) and
+ * suppressed if k consistent transmissions were heard in the interval. The interval doubles up to Imax and an
+ * inconsistency starts it over from Imin. Polled from the main loop, never blocks.
+ *
+ */
+class TrickleTimer {
+private:
+    uint32_t    m_imin;         // shortest interval in milliseconds
+    uint32_t    m_imax;         // longest interval in milliseconds
+    uint8_t     m_k;            // redundancy constant
+    uint32_t    m_interval;     // current interval
+    uint32_t    m_start;        // start of the current interval
+    uint32_t    m_fire;         // planned transmission, offset from m_start
+    uint8_t     m_counter;      // consistent transmissions heard in the current interval
+    bool        m_fired;        // transmission time of the current interval has passed
+
+    /**
+     * @brief Start a new interval of the current length
+     *
+     * @param now   Current time
+     */
+    void startInterval(uint32_t now);
+
+public:
+    /**
+     * @brief Constructor, defaults are the flood parameters
+     *
+     * @param imin      Shortest interval in milliseconds
+     * @param doublings Number of doublings of the interval, Imax = Imin * 2^doublings
+     * @param k         Redundancy constant
+     */
+    TrickleTimer(uint32_t imin = TRICKLE_FLOOD_IMIN, uint8_t doublings = TRICKLE_FLOOD_DOUBLINGS, uint8_t k = TRICKLE_FLOOD_K);
+
+    /**
+     * @brief Start the timer with the shortest interval
+     *
+     * @param now   Current time
+     */
+    void start(uint32_t now);
+
+    /**
+     * @brief Count a consistent transmission heard from a neighbor
+     *
+     */
+    void consistent();
+
+    /**
+     * @brief Handle inconsistency - start over from the shortest interval unless it is already used
+     *
+     * @param now   Current time
+     */
+    void reset(uint32_t now);
+
+    /**
+     * @brief Advance the timer
+     *
+     * @param now       Current time
+     * @return uint8_t  TRICKLE_TRANSMIT, TRICKLE_SUPPRESSED, TRICKLE_EXPIRED or TRICKLE_WAIT, the timer keeps
+     *                  running with Imax after it expires
+     */
+    uint8_t poll(uint32_t now);
+
+    /**
+     * @brief Get time of the next event - transmission or the end of the interval
+     *
+     * @return uint32_t Time of the next event
+     */
+    uint32_t nextEvent();
+
+    /**
+     * @brief Check whether the current interval is the longest one
+     *
+     * @return true     Interval is Imax, the timer expires at its end
+     * @return false    Otherwise
+     */
+    bool lastInterval();
+};
+
+/**
+ * @brief Flood waiting for rebroadcast
+ *
+ */
+typedef struct FloodSlot {
+    TrickleTimer    timer;                  // schedules rebroadcasts
+    uint8_t         size;                   // message size, 0 if the slot is free
+    uint8_t         data[MAX_MSG_SIZE];     // message
+} FloodSlot_t;
+
+/**
+ * @brief Rebroadcasts of flooded messages (uTESLA) scheduled by Trickle timers. A message is rebroadcasted in each
+ * of its intervals unless TRICKLE_FLOOD_K copies were heard in it. Its slot is freed when the longest interval ends
+ * or as soon as the rebroadcast of the longest interval is suppressed.
+ *
+ */
+class FloodScheduler {
+private:
+    FloodSlot_t m_slots[TRICKLE_FLOOD_SLOTS];   // scheduled messages
+    uint8_t     m_next;                         // slot replaced when all are used
+    uint16_t    m_sent;                         // rebroadcasts sent
+    uint16_t    m_suppressed;                   // rebroadcasts suppressed
+
+public:
+    /**
+     * @brief Constructor
+     *
+     */
+    FloodScheduler();
+
+    /**
+     * @brief Schedule rebroadcast of a message, replaces the oldest one if all slots are used
+     *
+     * @param message   Message including header
+     * @param size      Message size
+     * @return uint8_t  SUCCESS or FAIL if the message is too long
+     */
+    uint8_t schedule(const uint8_t *message, uint8_t size);
+
+    /**
+     * @brief Count a copy of a scheduled message heard from a neighbor. The whole message is compared, a different
+     * message with the same header does not suppress the rebroadcast.
+     *
+     * @param message   Message including header
+     * @param size      Message size
+     */
+    void heard(const uint8_t *message, uint8_t size);
+
+    /**
+     * @brief Send rebroadcasts that are due, called from the receive loop
+     *
+     * @param node_id   Own ID
+     */
+    void service(uint8_t node_id);
+
+    /**
+     * @brief Get time of the next rebroadcast event
+     *
+     * @param end       Time returned if no event comes earlier
+     * @return uint32_t Time of the earliest event of the scheduled messages or end
+     */
+    uint32_t nextEvent(uint32_t end);
+
+    /**
+     * @brief Get number of rebroadcasts sent
+     *
+     * @return uint16_t Number of rebroadcasts
+     */
+    uint16_t getSent();
+
+    /**
+     * @brief Get number of suppressed rebroadcasts
+     *
+     * @return uint16_t Number of suppressed rebroadcasts
+     */
+    uint16_t getSuppressed();
+};
+
+#endif // __linux__
+
+#endif // TRICKLE_H
@@ -7,13 +7,14 @@
  */
 
 #include "common.h"
+#include "ProtectLayerGlobals.h"
 
 #ifndef __linux__
 
 void replyAck()
 {
     if(RF12_WANTS_ACK){
-        rf12_sendStart(RF12_ACK_REPLY,0,0);
+        rf12_sendStart(RF12_ACK_REPLY, (const void*) rf12_data, rf12_len < SPHEADER_SIZE ? 0 : SPHEADER_SIZE);
     }
 }
 
@@ -42,6 +43,7 @@ bool waitReceive(uint32_t end)
         if(millis() >= end){
             return false;
         }
+        idleUntil(end);
         // return true if packet was received
         if(rf12_recvDone() && rf12_crc == 0){
             return true;
@@ -51,6 +53,19 @@ bool waitReceive(uint32_t end)
     return false;   // unreachable
 }
 
+bool waitAck(uint8_t node_id, const uint8_t *packet, uint32_t end)
+{
+    while(waitReceive(end)){
+        // acknowledgement of a message sent to node_id carries node_id as the source and the header of the message
+        if((rf12_hdr & RF12_HDR_CTL) && (rf12_hdr & RF12_HDR_MASK) == node_id && rf12_len >= SPHEADER_SIZE &&
+                !memcmp((const void*) rf12_data, packet, SPHEADER_SIZE)){
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void printError(int err_num)
 {
     Serial.write(err_num);
@@ -60,7 +75,7 @@ void printError(int err_num)
 int freeRam() {
   extern int __heap_start, *__brkval; 
   int v; 
-  return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval); 
+  return (int) ((intptr_t) &v - (__brkval == 0 ? (intptr_t) &__heap_start : (intptr_t) __brkval)); 
 }
 
 
@@ -24,6 +24,11 @@
 #define RADIO_FREQ          RF12_868MHZ // RF12 radio frequency
 #define RADIO_GROUP         10          // RF12 radio group
 
+// baud rate of the link between BS host and BS slave, 500000 is exact for ATmega328 at 16 MHz
+#ifndef SLAVE_BAUD_RATE
+#define SLAVE_BAUD_RATE     500000
+#endif
+
 // EEPROM settings
 #define NODE_ID_LOCATION    0           // node ID EEPROM address
 #define MAX_NODE_NUM        29          // maximum number of nodes
@@ -74,8 +79,17 @@ uint64_t millis();
 
 #else
 
+// nodes wait for packets by polling the radio, in the simulator they sleep in rf12_recvDone() until a packet arrives
+// or the time given here comes, so virtual time can skip the wait
+#ifdef SIMULATOR
+#define idleUntil(end)      simIdleUntil(end)
+#else
+#define idleUntil(end)
+#endif
+
 /**
- * @brief Send acknowledgement if required
+ * @brief Send acknowledgement if required. It carries the header of the acknowledged packet - an acknowledgement
+ * has no destination, so siblings waiting for the same node could take it for their own.
  * 
  */
 void replyAck();
@@ -106,6 +120,16 @@ void printBuffer(const uint8_t *buffer, const uint8_t len);
  */
 bool waitReceive(uint32_t end);
 
+/**
+ * @brief Wait for acknowledgement from a node, other packets received meanwhile are dropped
+ * 
+ * @param node_id   ID of the node that has to acknowledge
+ * @param packet    Sent packet, its header has to be echoed by the acknowledgement
+ * @param end       Termination time
+ * @return true if the acknowledgement was received or false otherwise
+ */
+bool waitAck(uint8_t node_id, const uint8_t *packet, uint32_t end);
+
 /**
  * @brief Send error to a Linux host
  * 
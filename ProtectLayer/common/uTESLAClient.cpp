@@ -26,6 +26,22 @@ uTeslaClient::uTeslaClient(uint8_t *eeprom_address, Hash *hash, MAC *mac): m_has
     m_mac_size = mac->macSize();
 
     memset(m_working_buffer, 0, WORKING_BUFF_SIZE);
+
+    m_pending_head = 0;
+    m_pending_count = 0;
+    m_pending_dups = 0;
+
+#ifdef UTESLA_TWO_LEVEL
+    // key from EEPROM is the commitment of the high-level chain, low-level chain comes with CDMs
+    memcpy(m_high_key, m_current_key, m_hash_size);
+    m_high_index = 0;
+    m_high_synced = false;
+    m_last_high_update = 0;
+    m_low_index = 0;
+    m_low_position = 0;
+    m_low_valid = false;
+    m_cdm_valid = false;
+#endif // UTESLA_TWO_LEVEL
 }
 
 uTeslaClient::~uTeslaClient()
@@ -48,6 +64,152 @@ uint8_t uTeslaClient::getKeySize()
     return m_hash_size;
 }
 
+#ifdef UTESLA_TWO_LEVEL
+uint8_t uTeslaClient::verifyChain(const uint8_t *key, uint32_t steps, const uint8_t *reference)
+{
+    // divide buffer into 2 separate parts for hashes
+    uint8_t *hash_prev = m_working_buffer;
+    uint8_t *hash_next = m_working_buffer + 16;
+
+    memcpy(hash_prev, key, m_hash_size);
+    for(uint32_t i=0;i<steps;i++){
+        m_hash->hash(hash_prev, m_hash_size, hash_next, m_hash_size);
+        memcpy(hash_prev, hash_next, m_hash_size);
+    }
+
+    return memcmp(hash_prev, reference, m_hash_size) ? FAIL : SUCCESS;
+}
+
+uint8_t uTeslaClient::updateHighKey(const uint8_t *key, uint32_t index)
+{
+    uint32_t steps;
+
+    if(m_high_synced){
+        // repeated disclosure of the last key
+        if(index >= m_high_index){
+            return (index == m_high_index && !memcmp(key, m_high_key, m_hash_size)) ? SUCCESS : FAIL;
+        }
+
+        // index tells the number of hashes, a node after a long sleep needs at most UTESLA_MAX_HIGH_SYNC of them
+        steps = m_high_index - index;
+        if(steps > UTESLA_MAX_HIGH_SYNC || steps * UTESLA_HIGH_PERIOD < millis() - m_last_high_update){
+            return FAIL;
+        }
+        if(verifyChain(key, steps, m_high_key) != SUCCESS){
+            return FAIL;
+        }
+    } else {
+        // index of the commitment is not known before the first synchronization
+        uint8_t *hash_prev = m_working_buffer;
+        uint8_t *hash_next = m_working_buffer + 16;
+
+        // the first CDM after a fresh start discloses the commitment itself
+        memcpy(hash_prev, key, m_hash_size);
+        for(steps=0;steps<=UTESLA_MAX_HIGH_SYNC;steps++){
+            if(!memcmp(hash_prev, m_high_key, m_hash_size)){
+                break;
+            }
+            m_hash->hash(hash_prev, m_hash_size, hash_next, m_hash_size);
+            memcpy(hash_prev, hash_next, m_hash_size);
+        }
+        if(steps > UTESLA_MAX_HIGH_SYNC){
+            return FAIL;
+        }
+    }
+
+    memcpy(m_high_key, key, m_hash_size);
+    m_high_index = index;
+    m_high_synced = true;
+    m_last_high_update = millis();
+
+    return SUCCESS;
+}
+
+uint8_t uTeslaClient::processCommitment(const uint8_t *cdm)
+{
+    uint32_t index;
+    memcpy(&index, cdm, UTESLA_INDEX_SIZE);
+    const uint8_t *commitment = cdm + UTESLA_INDEX_SIZE;
+    const uint8_t *mac = commitment + m_hash_size;
+    const uint8_t *disclosed = mac + m_mac_size;
+
+    // rebroadcasted or forwarded copy - nobody else could create the CDM before its disclosed key was known
+    if(m_cdm_valid && index == m_cdm_index){
+        return FAIL;
+    }
+
+    uint32_t last_high_update = m_last_high_update;
+    bool was_synced = m_high_synced;
+    if(updateHighKey(disclosed, index + 1) != SUCCESS){
+        return FAIL;
+    }
+
+    // the disclosed key authenticates the waiting CDM, which commits to the low-level chain of this round. It had
+    // to arrive before the disclosure - in the round that started with the previous disclosure.
+    if(m_cdm_valid && m_cdm_index == index + 1 && (!was_synced || m_cdm_time - last_high_update <= UTESLA_HIGH_PERIOD)){
+        uint8_t input[UTESLA_INDEX_SIZE + MAX_KEY_SIZE];
+        memcpy(input, &m_cdm_index, UTESLA_INDEX_SIZE);
+        memcpy(input + UTESLA_INDEX_SIZE, m_cdm_commitment, m_hash_size);
+
+        memset(m_working_buffer, 0, WORKING_BUFF_SIZE);
+        m_mac->computeMAC(disclosed, m_mac_key_size, input, UTESLA_INDEX_SIZE + m_hash_size, m_working_buffer, m_mac_size);
+        if(!memcmp(m_working_buffer, m_cdm_mac, m_mac_size)){
+            memcpy(m_current_key, m_cdm_commitment, m_hash_size);
+            m_low_index = index;
+            m_low_position = UTESLA_LOW_ROUNDS;
+            m_low_valid = true;
+            m_last_key_update = millis();
+        }
+    }
+
+    // keep this CDM until the next one discloses its key
+    m_cdm_index = index;
+    memcpy(m_cdm_commitment, commitment, m_hash_size);
+    memcpy(m_cdm_mac, mac, m_mac_size);
+    m_cdm_time = millis();
+    m_cdm_valid = true;
+
+    return SUCCESS;
+}
+
+uint8_t uTeslaClient::getCommitmentSize()
+{
+    return UTESLA_INDEX_SIZE + 2 * m_hash_size + m_mac_size;
+}
+
+uint8_t uTeslaClient::updateKey(const uint8_t* new_key)
+{
+    uint32_t index;
+    memcpy(&index, new_key, UTESLA_INDEX_SIZE);
+    uint8_t position = new_key[UTESLA_INDEX_SIZE];
+    const uint8_t *key = new_key + UTESLA_INDEX_SIZE + 1;
+
+    // position in the low-level chain tells the number of hashes, at most UTESLA_LOW_ROUNDS
+    if(!m_low_valid || index != m_low_index || position >= m_low_position){
+        return FAIL;
+    }
+    uint8_t steps = m_low_position - position;
+
+    // return fail if the key arrived after expected time of key arrival
+    if(steps * UTESLA_KEY_VALID_PERIOD < millis() - m_last_key_update){
+        return FAIL;
+    }
+    if(verifyChain(key, steps, m_current_key) != SUCCESS){
+        return FAIL;
+    }
+
+    m_round += steps;
+    memcpy(m_current_key, key, m_hash_size);
+    m_low_position = position;
+    m_last_key_update = millis();
+
+    verifyPending();
+
+    return SUCCESS;
+}
+
+#else
+
 // TODO optimize!
 uint8_t uTeslaClient::updateKey(const uint8_t* new_key)
 {
@@ -61,7 +223,7 @@ uint8_t uTeslaClient::updateKey(const uint8_t* new_key)
 		m_hash->hash(hash_prev, m_hash_size, hash_next, m_hash_size);
 		if(!memcmp(m_current_key, hash_next, m_hash_size)){
             // return fail if the key arrived after expected time of key arrival
-            if((i+1) * UTESLA_KEY_VALID_PERIOD < millis() - m_last_key_update){
+            if((uint32_t) (i+1) * UTESLA_KEY_VALID_PERIOD < millis() - m_last_key_update){
                 return FAIL;
             }
 
@@ -69,6 +231,8 @@ uint8_t uTeslaClient::updateKey(const uint8_t* new_key)
             memcpy(m_current_key, new_key, m_hash_size);
             m_last_key_update = millis();
 
+            verifyPending();
+
 			return SUCCESS;
 		}
 
@@ -78,6 +242,129 @@ uint8_t uTeslaClient::updateKey(const uint8_t* new_key)
 	return FAIL;
 }
 
+#endif // UTESLA_TWO_LEVEL
+
+void uTeslaClient::verifyPending()
+{
+    uint8_t key[MAX_KEY_SIZE];
+
+    // keys of older rounds are hashes of the current key - within the current low-level chain for two-level uTESLA
+#ifdef UTESLA_TWO_LEVEL
+    uint32_t max_steps = UTESLA_LOW_ROUNDS - 1 - m_low_position;
+#else
+    uint32_t max_steps = MAX_NUM_MISSED_ROUNDS;
+#endif
+
+    for(uint8_t i=0;i<m_pending_count;i++){
+        uTeslaPending_t *pending = &m_pending[(m_pending_head + i) % UTESLA_PENDING_SLOTS];
+
+        // messages are received in order, the rest waits for later keys
+        if(pending->state != PENDING_WAITING){
+            continue;
+        }
+        if(pending->round >= m_round){
+            break;
+        }
+
+        // message received in round r is authenticated by the key disclosed in round r + 1
+        uint32_t steps = m_round - 1 - pending->round;
+        if(steps > max_steps){
+            pending->state = PENDING_EMPTY;
+            continue;
+        }
+
+        memcpy(key, m_current_key, m_hash_size);
+        for(uint32_t s=0;s<steps;s++){
+            m_hash->hash(key, m_hash_size, m_working_buffer, m_hash_size);
+            memcpy(key, m_working_buffer, m_hash_size);
+        }
+
+        pending->state = verifyMessageKey(key, pending->data, pending->size) == SUCCESS ? PENDING_VERIFIED : PENDING_EMPTY;
+    }
+
+    memset(key, 0, MAX_KEY_SIZE);
+}
+
+uint8_t uTeslaClient::bufferMessage(const uint8_t *data, const uint8_t data_size)
+{
+    if(data_size > MAX_MSG_SIZE || data_size < SPHEADER_SIZE + m_mac_size){
+        return FAIL;
+    }
+
+    // drop the oldest message
+    if(m_pending_count == UTESLA_PENDING_SLOTS){
+        m_pending_head = (m_pending_head + 1) % UTESLA_PENDING_SLOTS;
+        m_pending_count--;
+    }
+
+    uTeslaPending_t *pending = &m_pending[(m_pending_head + m_pending_count) % UTESLA_PENDING_SLOTS];
+    pending->round = m_round;
+    pending->state = PENDING_WAITING;
+    pending->size = data_size;
+    memcpy(pending->data, data, data_size);
+    m_pending_count++;
+
+    return SUCCESS;
+}
+
+bool uTeslaClient::isBuffered(const uint8_t *data, const uint8_t data_size)
+{
+    for(uint8_t i=0;i<m_pending_count;i++){
+        uTeslaPending_t *pending = &m_pending[(m_pending_head + i) % UTESLA_PENDING_SLOTS];
+        if(pending->state != PENDING_EMPTY && pending->size == data_size && !memcmp(pending->data, data, data_size)){
+            m_pending_dups++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint16_t uTeslaClient::getBufferedDuplicates()
+{
+    return m_pending_dups;
+}
+
+uint8_t uTeslaClient::getVerifiedMessage(uint8_t *buffer, const uint8_t buff_size, uint8_t *data_size)
+{
+    // free slots of dropped messages at the start of the ring
+    while(m_pending_count && m_pending[m_pending_head].state == PENDING_EMPTY){
+        m_pending_head = (m_pending_head + 1) % UTESLA_PENDING_SLOTS;
+        m_pending_count--;
+    }
+
+    if(!m_pending_count || m_pending[m_pending_head].state != PENDING_VERIFIED){
+        return FAIL;
+    }
+
+    uTeslaPending_t *pending = &m_pending[m_pending_head];
+    if(buff_size < pending->size){
+        return FAIL;
+    }
+
+    memcpy(buffer, pending->data, pending->size);
+    *data_size = pending->size;
+
+    pending->state = PENDING_EMPTY;
+    m_pending_head = (m_pending_head + 1) % UTESLA_PENDING_SLOTS;
+    m_pending_count--;
+
+    return SUCCESS;
+}
+
+uint8_t uTeslaClient::verifyMessageKey(const uint8_t *key, const uint8_t *data, const uint8_t data_size)
+{
+    memset(m_working_buffer, 0, WORKING_BUFF_SIZE);
+
+    m_mac->computeMAC(key, m_mac_key_size, data, data_size - m_mac_size, m_working_buffer, m_mac_size);
+
+    if(!memcmp(m_working_buffer, data + data_size - m_mac_size, m_mac_size)){
+        return SUCCESS;
+    }
+
+    return FAIL;
+}
+
 uint8_t uTeslaClient::verifyMAC(const uint8_t* data, const uint16_t data_len, const uint8_t* mac)
 {
     memset(m_working_buffer, 0, WORKING_BUFF_SIZE);
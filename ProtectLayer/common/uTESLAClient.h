@@ -23,6 +23,26 @@
 
 #define MAX_NUM_MISSED_ROUNDS   5
 
+// broadcasts waiting for their key, every slot takes MAX_MSG_SIZE + 6 bytes of RAM
+#ifndef UTESLA_PENDING_SLOTS
+#define UTESLA_PENDING_SLOTS    4
+#endif
+
+#define PENDING_EMPTY           0   // slot is free or its message failed verification
+#define PENDING_WAITING         1   // message waits for the key of its round
+#define PENDING_VERIFIED        2   // message is authenticated and waits for the application
+
+/**
+ * @brief Broadcast received before its key was disclosed
+ * 
+ */
+typedef struct uTeslaPending {
+    uint32_t    round;                  // round when the message was received
+    uint8_t     state;                  // one of PENDING_*
+    uint8_t     size;                   // message size including header and MAC
+    uint8_t     data[MAX_MSG_SIZE];     // message
+} uTeslaPending_t;
+
 
 /**
  * @brief Class providing uTESLA features for common (non-BS) nodes
@@ -40,6 +60,65 @@ private:
     uint8_t         m_working_buffer[WORKING_BUFF_SIZE];// buffer for different computations
     uint32_t        m_last_key_update;
 
+    uTeslaPending_t m_pending[UTESLA_PENDING_SLOTS];    // ring of received broadcasts, oldest at m_pending_head
+    uint8_t         m_pending_head;                     // index of the oldest message
+    uint8_t         m_pending_count;                    // number of used slots
+    uint16_t        m_pending_dups;                     // copies of buffered messages detected by isBuffered()
+
+    /**
+     * @brief Verify MAC of the message with the given key
+     * 
+     * @param key       Key
+     * @param data      Message including header and MAC
+     * @param data_size Message size
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t verifyMessageKey(const uint8_t *key, const uint8_t *data, const uint8_t data_size);
+
+    /**
+     * @brief Verify waiting messages whose keys are known after the key update. Keys of missed rounds are computed
+     * from the current key, messages from rounds that cannot be reached are dropped.
+     * 
+     */
+    void verifyPending();
+
+#ifdef UTESLA_TWO_LEVEL
+    // m_current_key is the last verified element of the low-level chain of m_low_index high-level round
+    uint8_t         m_high_key[MAX_KEY_SIZE];           // last verified high-level key
+    uint32_t        m_high_index;                       // index of m_high_key, valid if m_high_synced
+    bool            m_high_synced;                      // index of m_high_key is known
+    uint32_t        m_last_high_update;                 // time of the last high-level key update
+    uint32_t        m_low_index;                        // high-level round of the low-level chain
+    uint8_t         m_low_position;                     // position of m_current_key in the low-level chain
+    bool            m_low_valid;                        // low-level chain is authenticated
+
+    // CDM waiting for its high-level key
+    uint32_t        m_cdm_index;                        // high-level round of the CDM
+    uint8_t         m_cdm_commitment[MAX_KEY_SIZE];     // commitment to the low-level chain of the next round
+    uint8_t         m_cdm_mac[MAX_MAC_SIZE];            // MAC by the high-level key of m_cdm_index
+    uint32_t        m_cdm_time;                         // time of receiving
+    bool            m_cdm_valid;                        // a CDM is waiting
+
+    /**
+     * @brief Hash the key repeatedly and compare it with the reference
+     * 
+     * @param key           Key
+     * @param steps         Number of hashes
+     * @param reference     Expected result
+     * @return uint8_t      SUCCESS if the result matches or FAIL
+     */
+    uint8_t verifyChain(const uint8_t *key, uint32_t steps, const uint8_t *reference);
+
+    /**
+     * @brief Verify disclosed high-level key against the last verified one and update it
+     * 
+     * @param key       High-level key
+     * @param index     Index of the key
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t updateHighKey(const uint8_t *key, uint32_t index);
+#endif // UTESLA_TWO_LEVEL
+
 public:
     /**
      * @brief Constructor
@@ -80,11 +159,29 @@ public:
     /**
      * @brief Update key
      * 
-     * @param new_key   New key to be verified and set
+     * @param new_key   New key to be verified and set, [high-level index][low-level index][key] for two-level uTESLA
      * @return uint8_t  SUCCESS or FAIL
      */
     uint8_t updateKey(const uint8_t* new_key);
 
+#ifdef UTESLA_TWO_LEVEL
+    /**
+     * @brief Process commitment distribution message - verify the disclosed high-level key, authenticate the
+     * low-level chain committed by the previous CDM and keep this CDM until its key is disclosed
+     * 
+     * @param cdm       Payload of MSG_UTESLA_CDM
+     * @return uint8_t  SUCCESS or FAIL if the CDM is invalid or already known
+     */
+    uint8_t processCommitment(const uint8_t *cdm);
+
+    /**
+     * @brief Get size of CDM payload
+     * 
+     * @return uint8_t  Size of the payload
+     */
+    uint8_t getCommitmentSize();
+#endif // UTESLA_TWO_LEVEL
+
     /**
      * @brief Verify MAC of the data with current key
      * 
@@ -104,6 +201,43 @@ public:
      */
     uint8_t verifyMessage(const uint8_t *data, const uint8_t data_size);
 
+    /**
+     * @brief Store a broadcast until its key is disclosed, the oldest message is dropped if all slots are used
+     * 
+     * @param data      Message including header and MAC
+     * @param data_size Message size
+     * @return uint8_t  SUCCESS or FAIL if the message size is invalid
+     */
+    uint8_t bufferMessage(const uint8_t *data, const uint8_t data_size);
+
+    /**
+     * @brief Check whether the same message, MAC included, is buffered, counts duplicates. A forged message with
+     * the header of a buffered one is not a copy of it.
+     * 
+     * @param data      Message including header and MAC
+     * @param data_size Message size
+     * @return true     Message is buffered
+     * @return false    Otherwise
+     */
+    bool isBuffered(const uint8_t *data, const uint8_t data_size);
+
+    /**
+     * @brief Get number of copies detected by isBuffered()
+     * 
+     * @return uint16_t Number of copies
+     */
+    uint16_t getBufferedDuplicates();
+
+    /**
+     * @brief Take the oldest authenticated broadcast, messages are returned in the order of receiving
+     * 
+     * @param buffer        Buffer for the message including header and MAC
+     * @param buff_size     Size of the buffer
+     * @param data_size     Size of the message
+     * @return uint8_t      SUCCESS or FAIL if there is no authenticated message
+     */
+    uint8_t getVerifiedMessage(uint8_t *buffer, const uint8_t buff_size, uint8_t *data_size);
+
     /**
      * @brief Get time of the last key update
      * 
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <random>
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -24,93 +25,233 @@
 #include "ProtectLayerGlobals.h"
 
 
-uTeslaMaster::uTeslaMaster(const int32_t device_fd, const uint8_t *initial_key, const uint32_t rounds_num, Hash *hash, MAC *mac): m_hash(hash), m_mac(mac)
+uTeslaMaster::uTeslaMaster(EventLoop *loop, const uint8_t device, const uint8_t *initial_key, const uint32_t rounds_num, Hash *hash, MAC *mac,
+                           const std::string &checkpoint_path, const uint32_t low_rounds): 
+m_hash(hash), m_mac(mac), m_hash_chain(hash), m_loop(loop), m_device(device), m_low_rounds(low_rounds), m_low_chain(hash),
+m_high_index(0), m_cdm_len(0), m_cdm_sent(false), m_bootstrap(false)
 {
+    // random start, after a quick restart the sequence most likely does not fall into windows kept by nodes
+    std::random_device random;
+    m_seq = random();
+
     // set attributes
-    m_dev_fd = device_fd;
     m_rounds_num = rounds_num;
-    m_current_key_index = m_rounds_num - 1;
     m_hash_size = hash->hashSize();
     m_mac_size = mac->macSize();
     m_mac_key_size = mac->keySize();
-    m_hash_chain.resize(rounds_num + 2);
-
-    m_hash_chain[0] = new uint8_t[m_hash_size];
-    memcpy(m_hash_chain[0], initial_key, m_hash_size);
-
-    // compute the hash chain
-// #ifdef DEBUG
-//    std::cout << "Hash chain:" << std::endl;
-// #endif
-    for(uint32_t i=1;i<rounds_num + 1;i++){
-        m_hash_chain[i] = new uint8_t[m_hash_size];
-        if(!m_hash->hash(m_hash_chain[i-1], m_hash_size, m_hash_chain[i], m_hash_size)){
-            // std::cerr << "Failed to initialize hash chain" << std::endl;
+
+    if(m_low_rounds && (m_low_rounds >= UINT8_MAX || m_hash_size > HASH_CHAIN_MAX_HASH_SIZE || m_mac_size < m_hash_size
+                        || SPHEADER_SIZE + UTESLA_INDEX_SIZE + 2 * m_hash_size + m_mac_size > MAX_MSG_SIZE)){
+        uTeslaMasterException ex("Unsupported parameters of two-level uTESLA");
+        throw ex;
+    }
+
+    // compute the hash chain, only its checkpoints are kept
+    if(checkpoint_path.empty()){
+        if(m_hash_chain.init(initial_key, rounds_num) != SUCCESS){
             uTeslaMasterException ex("Failed to initialize hash chain");
             throw ex;
         }
-// #ifdef DEBUG
-//        printBufferHex(m_hash_chain[i], m_hash_size);// << std::endl;
-// #endif
+    } else if(m_hash_chain.open(checkpoint_path, initial_key, rounds_num) != SUCCESS){
+        // continue from the round stored in the checkpoint file
+        uTeslaMasterException ex("Failed to open hash chain checkpoint file");
+        throw ex;
     }
 
-}
+    if(!m_low_rounds){
+        return;
+    }
 
-uTeslaMaster::~uTeslaMaster()
-{
-    // destroy the hash chain
-    for(uint32_t i=0;i<m_rounds_num + 1;i++){
-        delete[] m_hash_chain[i];
+    // the first CDM discloses the commitment, after a restart it discloses the next key and the round continues
+    // after it - the key might have been used for the commitment to a low-level chain
+    if(m_hash_chain.index() == (int32_t) rounds_num - 1){
+        m_high_index = rounds_num;
+        memcpy(m_high_key, m_hash_chain.last(), m_hash_size);
+        m_bootstrap = true;
+    } else if(m_hash_chain.index() >= 0){
+        m_high_index = m_hash_chain.index();
+        memcpy(m_high_key, m_hash_chain.current(), m_hash_size);
+        m_hash_chain.next();
+    }
+
+    if(startHighRound() != SUCCESS){
+        uTeslaMasterException ex("Failed to start high-level uTESLA round");
+        throw ex;
     }
 }
 
+uTeslaMaster::~uTeslaMaster() { }
+
 void uTeslaMaster::printLastElementHex()
 {
-    printBufferHex(m_hash_chain[m_rounds_num], m_hash_size);
+    printBufferHex(m_hash_chain.last(), m_hash_size);
 }
 
-uint8_t uTeslaMaster::broadcastKey()
+uint8_t uTeslaMaster::broadcast(msg_type_t type, const uint8_t *payload, uint8_t len)
 {
-    // buffer size is hash size + length twice + header size
-    int32_t buffer_size = m_hash_size + 2 + SPHEADER_SIZE;
     uint8_t buffer[MAX_MSG_SIZE];
 
-    // set length for serial communication
-    buffer[0] = buffer_size - 2;
-    buffer[1] = buffer_size - 2;
+    if(len > MAX_MSG_SIZE - SPHEADER_SIZE){
+        return FAIL;
+    }
 
     // set header
-    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(buffer + 2);
-    spheader->msgType = MSG_UTESLA_KEY;
+    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(buffer);
+    spheader->msgType = type;
     spheader->sender = BS_NODE_ID;
     spheader->receiver = 0;
+    spheader->seq = m_seq++;
+
+    memcpy(buffer + SPHEADER_SIZE, payload, len);
+
+    // send through the slave device
+    return m_loop->sendAndWait(m_device, buffer, len + SPHEADER_SIZE);
+}
+
+uint8_t uTeslaMaster::broadcastKey(const uint8_t *key, uint8_t low_index)
+{
+    if(!m_low_rounds){
+        return broadcast(MSG_UTESLA_KEY, key, m_hash_size);
+    }
+
+    // low-level key is identified by the high-level round and its position in the low-level chain
+    uint8_t payload[MAX_MSG_SIZE];
+    memcpy(payload, &m_high_index, UTESLA_INDEX_SIZE);
+    payload[UTESLA_INDEX_SIZE] = low_index;
+    memcpy(payload + UTESLA_INDEX_SIZE + 1, key, m_hash_size);
+
+    return broadcast(MSG_UTESLA_KEY, payload, UTESLA_INDEX_SIZE + 1 + m_hash_size);
+}
+
+uint8_t uTeslaMaster::broadcastCommitment()
+{
+    if(!m_low_rounds || !m_cdm_len){
+        return FAIL;
+    }
+
+    if(broadcast(MSG_UTESLA_CDM, m_cdm, m_cdm_len) != SUCCESS){
+        return FAIL;
+    }
+    m_cdm_sent = true;
+
+    return SUCCESS;
+}
+
+const uint8_t *uTeslaMaster::currentKey()
+{
+    if(m_bootstrap){
+        return NULL;
+    }
+
+    return m_low_rounds ? m_low_chain.current() : m_hash_chain.current();
+}
 
-    // compy key to buffer
-    memcpy(buffer + 2 + SPHEADER_SIZE, m_hash_chain[m_current_key_index], m_hash_size);
+uint8_t uTeslaMaster::deriveLowSeed(const uint8_t *high_key, uint8_t *seed)
+{
+    uint8_t mac[MAX_MSG_SIZE];
+    const uint8_t label = UTESLA_LOW_SEED_LABEL;
 
-    // send to serial port
-    if(write(m_dev_fd, buffer, buffer_size) < buffer_size){
+    // MAC as a PRF keyed by the high-level key, low-level keys are known only after the high-level key is disclosed
+    if(!m_mac->computeMAC(high_key, m_mac_key_size, &label, 1, mac, m_mac_size)){
         return FAIL;
     }
+    memcpy(seed, mac, m_hash_size);
+
+    return SUCCESS;
+}
+
+uint8_t uTeslaMaster::startHighRound()
+{
+    uint8_t seed[HASH_CHAIN_MAX_HASH_SIZE];
+
+    if(m_hash_chain.index() < 0){
+        printDebug("Out of high-level uTESLA rounds", true);
+        return FAIL;
+    }
+
+    // the key is never used again after a restart, the checkpoint is stored before the key is used
+    memcpy(m_prev_high_key, m_high_key, m_hash_size);
+    m_high_index = m_hash_chain.index();
+    memcpy(m_high_key, m_hash_chain.current(), m_hash_size);
+    if(m_hash_chain.next() != SUCCESS){
+        return FAIL;
+    }
+
+    if(deriveLowSeed(m_high_key, seed) != SUCCESS || m_low_chain.init(seed, m_low_rounds) != SUCCESS){
+        return FAIL;
+    }
+
+    // CDM - [index][commitment][MAC][previous high-level key], no commitment after the last high-level round
+    uint8_t *commitment = m_cdm + UTESLA_INDEX_SIZE;
+    uint8_t *mac = commitment + m_hash_size;
+    memcpy(m_cdm, &m_high_index, UTESLA_INDEX_SIZE);
+    if(m_hash_chain.index() >= 0){
+        HashChain next_chain(m_hash);
+        if(deriveLowSeed(m_hash_chain.current(), seed) != SUCCESS || next_chain.init(seed, m_low_rounds) != SUCCESS){
+            return FAIL;
+        }
+        memcpy(commitment, next_chain.last(), m_hash_size);
+    } else {
+        memset(commitment, 0, m_hash_size);
+    }
+
+    if(!m_mac->computeMAC(m_high_key, m_mac_key_size, m_cdm, UTESLA_INDEX_SIZE + m_hash_size, mac, m_mac_size)){
+        return FAIL;
+    }
+    memcpy(mac + m_mac_size, m_prev_high_key, m_hash_size);
+
+    m_cdm_len = UTESLA_INDEX_SIZE + 2 * m_hash_size + m_mac_size;
+    m_cdm_sent = false;
 
     return SUCCESS;
 }
 
 uint8_t uTeslaMaster::newRound()
 {
+    // nodes need the commitment before the first low-level key
+    if(m_low_rounds && !m_cdm_sent && broadcastCommitment() != SUCCESS){
+        return FAIL;
+    }
+
+    // nothing commits to the low-level chain of the first round, only its CDM is sent and the next round starts
+    if(m_bootstrap){
+        m_bootstrap = false;
+        if(startHighRound() != SUCCESS){
+            return FAIL;
+        }
+        return broadcastCommitment();
+    }
+
     // return FAIL if there are no keys left
-    if(m_current_key_index < 0){
+    if(!currentKey()){
         std::cerr << "Key index"  << std::endl; // TODO REMOVE!
         return FAIL;
     }
 
+    // key has to fit to a message anyway
+    uint8_t key[MAX_MSG_SIZE];
+    memcpy(key, currentKey(), m_hash_size);
+    uint8_t low_index = m_low_chain.index();
+
+    // move to the next round first, after a restart the disclosed key must not be used for MACs
+    if((m_low_rounds ? m_low_chain.next() : m_hash_chain.next()) != SUCCESS){
+        printDebug("Failed to compute key for the next round", true);
+        return FAIL;
+    }
+
     // broadcast the key
-    if(broadcastKey() != SUCCESS){
+    if(broadcastKey(key, low_index) != SUCCESS){
         std::cerr << "broadcast"  << std::endl; // TODO REMOVE!
         return FAIL;
     }
 
-    m_current_key_index--;
+    // the last low-level key was disclosed, the next high-level round starts if there is any
+    if(m_low_rounds && m_low_chain.index() < 0 && m_hash_chain.index() >= 0){
+        if(startHighRound() != SUCCESS){
+            return FAIL;
+        }
+        return broadcastCommitment();
+    }
 
     return SUCCESS;
 }
@@ -122,7 +263,8 @@ uint8_t uTeslaMaster::broadcastMessage(const uint8_t* data, const uint16_t data_
         return FAIL;
     }
 
-    if(m_current_key_index < 0){
+    const uint8_t *key = currentKey();
+    if(!key){
         printDebug("Out of uTESLA rounds", true);
         return FAIL;
     }
@@ -132,30 +274,29 @@ uint8_t uTeslaMaster::broadcastMessage(const uint8_t* data, const uint16_t data_
         return FAIL;
     }
 
-    // set packet size to size of the message, MAC, HEADER and 2 bytes for serial communication
-    int packet_size = data_len + m_mac_size + 2 + SPHEADER_SIZE;
+    // set packet size to size of the message, MAC and HEADER
+    uint8_t packet_size = data_len + m_mac_size + SPHEADER_SIZE;
 
     uint8_t buffer[MAX_MSG_SIZE];
-    buffer[0] = packet_size - 2;
-    buffer[1] = packet_size - 2;
     
     // set the header
-    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(buffer + 2);
+    SPHeader_t *spheader = reinterpret_cast<SPHeader_t*>(buffer);
     spheader->msgType = MSG_UTESLA;
     spheader->sender = BS_NODE_ID;
     spheader->receiver = 0;
+    spheader->seq = m_seq++;
 
     // copy yo buffer
-    memcpy(buffer + 2 + SPHEADER_SIZE, data, data_len);
+    memcpy(buffer + SPHEADER_SIZE, data, data_len);
 
     // compute MAC
-    if(!m_mac->computeMAC(m_hash_chain[m_current_key_index], m_mac_key_size, buffer + 2, data_len + SPHEADER_SIZE, buffer + 2 + SPHEADER_SIZE + data_len, m_mac_size)){
+    if(!m_mac->computeMAC(key, m_mac_key_size, buffer, data_len + SPHEADER_SIZE, buffer + SPHEADER_SIZE + data_len, m_mac_size)){
         printDebug("Failed to compute MAC", true);
         return FAIL;
     }
 
-    // send to serial port
-    if(write(m_dev_fd, buffer, packet_size) < packet_size){
+    // send through the slave device
+    if(m_loop->sendAndWait(m_device, buffer, packet_size) != SUCCESS){
         printDebug("Failed to broadcast message", true);
         return FAIL;
     }
@@ -11,12 +11,16 @@
 
 #ifdef __linux__
 
-#include <vector>
 #include <string>
 
 #include <stdint.h>
 
 #include "ProtectLayerGlobals.h"
+#include "EventLoop.h"
+#include "HashChain.h"
+
+// checkpoint file of the hash chain is the key file path with this suffix
+#define UTESLA_CHECKPOINT_SUFFIX ".utesla"
 
 // sync window for uTESLA keys
 #define MAX_NUM_MISSED_ROUNDS   5
@@ -27,33 +31,86 @@ private:
     MAC                     *m_mac;                 // class providing MAC computation
 
     uint32_t                m_rounds_num;           // number of uTESLA rounds
-    int32_t                 m_current_key_index;    // index of current key used
-    std::vector<uint8_t*>   m_hash_chain;           // hash chain
+    HashChain               m_hash_chain;           // hash chain, current element is the current key
 
     uint32_t                m_hash_size;            // hash size
     uint32_t                m_mac_size;             // MAC size
     uint32_t                m_mac_key_size;         // MAC key size
 
-    int32_t                 m_dev_fd;               // file descriptor of slave device
+    EventLoop               *m_loop;                // event loop serving the slave device
+    uint8_t                 m_device;               // slave device in m_loop
+
+    // two-level uTESLA, m_hash_chain is the high-level chain
+    uint32_t                m_low_rounds;                               // low-level rounds in a high-level round, 0 for single-level
+    HashChain               m_low_chain;                                // low-level chain of the current high-level round
+    uint32_t                m_high_index;                               // index of the current high-level key
+    uint8_t                 m_high_key[HASH_CHAIN_MAX_HASH_SIZE];       // current high-level key
+    uint8_t                 m_prev_high_key[HASH_CHAIN_MAX_HASH_SIZE];  // previous high-level key, disclosed by the CDM
+    uint8_t                 m_cdm[MAX_MSG_SIZE];                        // commitment distribution message of the current round
+    uint8_t                 m_cdm_len;                                  // size of m_cdm
+    bool                    m_cdm_sent;                                 // m_cdm was broadcasted at least once
+    bool                    m_bootstrap;                                // first round after a fresh start, nodes have no low-level commitment
+    uint8_t                 m_seq;                                      // sequence number of the next broadcast, nodes suppress duplicates by it
+
+    /**
+     * @brief Broadcast message from BS with a payload
+     * 
+     * @param type      Message type
+     * @param payload   Payload
+     * @param len       Payload size
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t broadcast(msg_type_t type, const uint8_t *payload, uint8_t len);
 
     /**
      * @brief Broadcast uTESLA key for previous round
      * 
+     * @param key       Key to be broadcasted
+     * @param low_index Index of the key in the low-level chain, ignored by single-level uTESLA
      * @return uint8_t SUCCESS or FAIL
      */
-    uint8_t broadcastKey();
+    uint8_t broadcastKey(const uint8_t *key, uint8_t low_index);
+
+    /**
+     * @brief Get key authenticating messages in the current round
+     * 
+     * @return const uint8_t*   Current key, NULL if there are no keys left
+     */
+    const uint8_t *currentKey();
+
+    /**
+     * @brief Derive the first element of a low-level chain from a high-level key
+     * 
+     * @param high_key  High-level key
+     * @param seed      Output, hash size bytes
+     * @return uint8_t  SUCCESS or FAIL
+     */
+    uint8_t deriveLowSeed(const uint8_t *high_key, uint8_t *seed);
+
+    /**
+     * @brief Move to the next high-level key, compute its low-level chain and prepare the CDM with the commitment
+     * to the low-level chain of the following high-level round
+     * 
+     * @return uint8_t  SUCCESS or FAIL if there are no high-level keys left
+     */
+    uint8_t startHighRound();
     
 public:
     /**
      * @brief Constructor
      * 
-     * @param device_fd     Open file descriptor of slave device
+     * @param loop          Event loop serving the slave device
+     * @param device        Slave device in the loop
      * @param initial_key   First element of the hash chain
      * @param rounds_num    Number of uTESLA rounds
      * @param hash          Class providing hash interface
      * @param mac           Class providing MAC interface
+     * @param checkpoint_path   File where the hash chain state is kept across restarts, empty to start from the
+     *                          first round every time
+     * @param low_rounds    Low-level rounds in each of rounds_num high-level rounds for two-level uTESLA, 0 for single-level
      */
-    uTeslaMaster(const int32_t device_fd, const uint8_t *initial_key, const uint32_t rounds_num, Hash *hash, MAC *mac);
+    uTeslaMaster(EventLoop *loop, const uint8_t device, const uint8_t *initial_key, const uint32_t rounds_num, Hash *hash, MAC *mac,
+                 const std::string &checkpoint_path = "", const uint32_t low_rounds = 0);
 
     /**
      * @brief Destructor
@@ -62,12 +119,23 @@ public:
     virtual ~uTeslaMaster();
 
     /**
-     * @brief Broadcast key and start a new round
+     * @brief Broadcast key and start a new round. The new round is persisted before the key is broadcasted,
+     * a failed broadcast skips the round. With two-level uTESLA the low-level key is broadcasted and the CDM follows
+     * when a new high-level round starts. The first round after a fresh start lasts a single low-level round, no
+     * messages can be broadcasted in it - nodes learn the first low-level commitment from its CDM.
      * 
      * @return uint8_t SUCCESS or FAIL
      */
     uint8_t newRound();
 
+    /**
+     * @brief Broadcast commitment distribution message of the current high-level round, two-level uTESLA only.
+     * Can be repeated to reach nodes that missed it.
+     * 
+     * @return uint8_t SUCCESS or FAIL
+     */
+    uint8_t broadcastCommitment();
+
     /**
      * @brief Print the last hash chain element - usefull for debug purposses
      * 
@@ -15,7 +15,6 @@
 uint8_t node_id     = 2;        // TODO use ProtectLayer::getNodeID()
 uint8_t rcvd_buffer[BUFFER_SIZE];
 uint8_t uTESLA_buffer[BUFFER_SIZE];
-uint8_t uTESLA_size = 0;
 
 ProtectLayer protect_layer;
 
@@ -49,19 +48,15 @@ void loop()
         Serial.println(" rcvd:");
         printBuffer(rcvd_buffer, rcvd_len);
 
-        if(spheader->msgType == MSG_UTESLA){
-            memcpy(uTESLA_buffer, rcvd_buffer, rcvd_len);
-            uTESLA_size = rcvd_len;
-        }
-
         // break;
     } else if(rval == FORWARD){
         Serial.println("fwd");
         if(spheader->msgType == MSG_UTESLA_KEY){
-            if(protect_layer.verifyMessage(uTESLA_buffer, uTESLA_size) == SUCCESS){
+            // broadcasts authenticated by the new key
+            uint8_t uTESLA_size = 0;
+            while(protect_layer.receiveBroadcast(uTESLA_buffer, BUFFER_SIZE, &uTESLA_size) == SUCCESS){
                 Serial.println("msg ok");
-            } else {
-                Serial.println("msg nok");
+                printBuffer(uTESLA_buffer, uTESLA_size);
             }
         }
     }
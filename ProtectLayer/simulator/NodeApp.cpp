@@ -0,0 +1,106 @@
+/**
+ * @brief Application of simulated nodes - the CTP demo node that also takes uTESLA broadcasts and reports its
+ * counters to the simulator. Compiled with the shim headers like the rest of the node code.
+ *
+ * @file    NodeApp.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <RF12.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+#include "ProtectLayer.h"
+#include "common.h"
+
+#define BUFFER_SIZE         MAX_MSG_SIZE
+#define APP_PAYLOAD_SIZE    4       // size of the application message
+#define APP_PERIOD_MS       20000   // average period of application messages
+#define CTP_RETRY_DELAY_MS  5000    // delay before a node that failed to join the tree tries again
+#define RECV_TIMEOUT_MAX_MS 60000   // longest receive() timeout, it is 16 bits
+
+SimSerial Serial;
+
+// heap bounds of avr-libc used by freeRam()
+int __heap_start;
+int *__brkval = NULL;
+
+/**
+ * @brief Copy counters of ProtectLayer to the simulator
+ *
+ * @param protect_layer ProtectLayer of the node
+ */
+static void updateStats(ProtectLayer *protect_layer)
+{
+    SimNodeStats_t *stats = simStats();
+    PLCounters_t counters;
+
+    CTP *ctp = protect_layer->getCTP();
+    stats->parent = ctp->getParentID();
+    stats->distance = ctp->getDistance();
+    stats->etx = ctp->getPathETX();
+    stats->beacons = ctp->getBeaconCount();
+    stats->convergence_time = ctp->getConvergenceTime();
+    stats->repairs = ctp->getRepairCount();
+
+    protect_layer->getCounters(&counters);
+    stats->forward_dups = counters.forward_dups;
+    stats->utesla_dups = counters.utesla_dups;
+    stats->floods_sent = counters.floods_sent;
+    stats->floods_suppressed = counters.floods_suppressed;
+}
+
+void simNodeMain()
+{
+    // every node has its own ProtectLayer, the coroutine stack holds it
+    ProtectLayer protect_layer;
+    SimNodeStats_t *stats = simStats();
+    uint8_t msg_buffer[BUFFER_SIZE];
+    uint8_t rcvd_len;
+    uint8_t rval;
+
+    randomSeed(analogRead(0) * protect_layer.getNodeID());
+
+    // CTP demo node sleeps forever if it does not join the tree, here it keeps trying
+    stats->ctp_result = FAIL;
+    while((stats->ctp_result = protect_layer.startCTP()) != SUCCESS){
+        stats->ctp_attempts++;
+        updateStats(&protect_layer);
+        delay(CTP_RETRY_DELAY_MS + random(CTP_RETRY_DELAY_MS));
+    }
+    stats->ctp_attempts++;
+    updateStats(&protect_layer);
+
+    uint32_t next_send = millis() + random(APP_PERIOD_MS);
+    while(1){
+        // wait until the next application message, in virtual time a node that has nothing to do costs nothing
+        int32_t timeout = (int32_t) (next_send - millis());
+        timeout = timeout < 1 ? 1 : (timeout > RECV_TIMEOUT_MAX_MS ? RECV_TIMEOUT_MAX_MS : timeout);
+
+        // forwarded messages are not copied to the buffer
+        rcvd_len = 0;
+        rval = protect_layer.receive(msg_buffer, BUFFER_SIZE, &rcvd_len, timeout);
+        if(rval == FORWARD && !rcvd_len){
+            stats->forwarded++;
+        } else if(rval == FORWARD && ((SPHeader_t*) msg_buffer)->msgType == MSG_UTESLA_KEY){
+            // the key authenticates broadcasts of the previous round
+            while(protect_layer.receiveBroadcast(msg_buffer, BUFFER_SIZE, &rcvd_len) == SUCCESS){
+                stats->broadcasts++;
+            }
+        }
+
+        if((int32_t) (millis() - next_send) >= 0){
+            memset(msg_buffer, protect_layer.getNodeID(), APP_PAYLOAD_SIZE);
+            stats->app_sent++;
+            if(protect_layer.sendToBS(MSG_FORWARD, msg_buffer, APP_PAYLOAD_SIZE) != SUCCESS){
+                stats->app_failed++;
+            }
+            next_send = millis() + APP_PERIOD_MS / 2 + random(APP_PERIOD_MS);
+        }
+
+        updateStats(&protect_layer);
+    }
+}
@@ -0,0 +1,144 @@
+/**
+ * @brief Interface between node code running in the simulator and the simulated world. Shim headers
+ * (shim directory) map Arduino, RF12 and EEPROM calls of the node code to these functions.
+ * 
+ * @file    SimShim.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIMSHIM_H
+#define SIMSHIM_H
+
+#include <stdint.h>
+
+#define SIM_RF12_MAXDATA    66      // RF12 payload limit, same as MAX_MSG_SIZE
+#define SIM_EEPROM_SIZE     1024    // EEPROM of ATmega328
+
+/**
+ * @brief Receive buffer of RF12 driver - rf12_hdr, rf12_len, rf12_data and rf12_crc of the running node
+ * 
+ */
+typedef struct _SimRadio {
+    volatile uint8_t    hdr;                        // header of the received packet
+    volatile uint8_t    len;                        // payload length
+    volatile uint8_t    data[SIM_RF12_MAXDATA];     // payload
+    volatile uint16_t   crc;                        // 0 if the packet is valid
+} SimRadio_t;
+
+/**
+ * @brief Counters of the node application and ProtectLayer, filled by the node itself and printed by the simulator
+ * 
+ */
+typedef struct _SimNodeStats {
+    uint8_t     ctp_result;         // SUCCESS if the node joined the CTP tree
+    uint8_t     ctp_attempts;       // number of CTP establishments the node ran
+    uint8_t     parent;             // CTP parent
+    uint8_t     distance;           // hops to BS
+    uint16_t    etx;                // route cost in CTP_ETX_UNIT
+    uint16_t    beacons;            // beacons sent in the last establishment
+    uint32_t    convergence_time;   // time to converge in the last establishment, 0 if it did not
+    uint16_t    repairs;            // local parent repairs
+    uint16_t    forward_dups;       // duplicate messages dropped instead of forwarding
+    uint16_t    utesla_dups;        // duplicate uTESLA floods
+    uint16_t    floods_sent;        // uTESLA rebroadcasts sent
+    uint16_t    floods_suppressed;  // uTESLA rebroadcasts suppressed by Trickle
+    uint32_t    app_sent;           // application messages sent to BS
+    uint32_t    app_failed;         // application messages no parent acknowledged
+    uint32_t    forwarded;          // messages of other nodes forwarded to BS
+    uint32_t    broadcasts;         // authenticated uTESLA broadcasts delivered to the application
+} SimNodeStats_t;
+
+/**
+ * @brief Get receive buffer of the running node
+ * 
+ * @return SimRadio_t*  Receive buffer
+ */
+SimRadio_t *simRadio();
+
+/**
+ * @brief Get EEPROM of the running node
+ * 
+ * @return uint8_t* SIM_EEPROM_SIZE bytes
+ */
+uint8_t *simEeprom();
+
+/**
+ * @brief Get statistics of the running node
+ * 
+ * @return SimNodeStats_t*  Statistics
+ */
+SimNodeStats_t *simStats();
+
+/**
+ * @brief Simulation time of the running node
+ * 
+ * @return uint32_t Milliseconds since the node booted
+ */
+uint32_t simMillis();
+
+/**
+ * @brief Let other nodes run
+ * 
+ */
+void simYield();
+
+/**
+ * @brief Suspend the running node
+ * 
+ * @param ms    Milliseconds
+ */
+void simDelay(uint32_t ms);
+
+/**
+ * @brief Suspend the running node forever (power-down sleep)
+ * 
+ */
+void simHalt();
+
+/**
+ * @brief Tell the simulator until when the running node only waits for packets, the next rf12_recvDone() without
+ * a packet suspends the node until a packet arrives or until that time
+ * 
+ * @param end   Time the node stops waiting
+ */
+void simIdleUntil(uint32_t end);
+
+/**
+ * @brief Move the next received packet of the running node to its receive buffer
+ * 
+ * @return true     Packet was received
+ * @return false    No packet is waiting
+ */
+bool simReceive();
+
+/**
+ * @brief Transmit packet from the running node
+ * 
+ * @param hdr   RF12 header as passed to rf12_sendStart()
+ * @param data  Payload, can be NULL if len is 0
+ * @param len   Payload length
+ */
+void simSend(uint8_t hdr, const void *data, uint8_t len);
+
+/**
+ * @brief Next number of the running node's pseudo-random generator
+ * 
+ * @return uint32_t Random number
+ */
+uint32_t simRandom();
+
+/**
+ * @brief Seed the running node's pseudo-random generator
+ * 
+ * @param seed  Seed
+ */
+void simRandomSeed(uint32_t seed);
+
+/**
+ * @brief Application of a simulated node, runs until the end of the simulation
+ * 
+ */
+void simNodeMain();
+
+#endif // SIMSHIM_H
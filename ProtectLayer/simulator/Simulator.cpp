@@ -0,0 +1,1001 @@
+/**
+ * @brief Simulator of RF12 networks running the node code on Linux
+ *
+ * @file    Simulator.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include "Simulator.h"
+#include "common.h"
+#include "RF12.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// every worker thread schedules its own nodes
+static Simulator                *sim_instance = NULL;   // simulator running the nodes
+static thread_local SimNode     *sim_current = NULL;    // node whose coroutine runs, NULL in the scheduler
+static thread_local SimNetwork  *sim_network = NULL;    // network the worker runs in virtual time
+static thread_local jmp_buf     sim_scheduler;          // scheduler position, nodes jump back to it when they yield
+
+/**
+ * @brief Next number of a xorshift generator
+ *
+ * @param state     Generator state, never 0
+ * @return uint32_t Random number
+ */
+static uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *state = x;
+}
+
+/**
+ * @brief Mix numbers into a generator seed
+ *
+ * @param a         First number
+ * @param b         Second number
+ * @return uint32_t Seed, never 0
+ */
+static uint32_t mixSeed(uint32_t a, uint32_t b)
+{
+    uint32_t x = a * 0x9E3779B1 ^ (b + 0x7F4A7C15 + (a << 6) + (a >> 2));
+
+    x ^= x >> 16;
+    x *= 0x85EBCA6B;
+    x ^= x >> 13;
+
+    return x ? x : 1;
+}
+
+/**
+ * @brief Return from the running node to the scheduler. Coroutines are switched by _setjmp()/_longjmp(),
+ * swapcontext() would save the signal mask by a system call on every switch.
+ *
+ */
+static void switchToScheduler()
+{
+    if(!_setjmp(sim_current->jump)){
+        _longjmp(sim_scheduler, 1);
+    }
+}
+
+/**
+ * @brief Coroutine entry of a node
+ *
+ */
+static void nodeEntry()
+{
+    simNodeMain();
+
+    // the coroutine must not return, its context was only used to start it
+    sim_current->state = SIM_NODE_FINISHED;
+    _longjmp(sim_scheduler, 1);
+}
+
+// interface of the node code, see SimShim.h
+
+SimRadio_t *simRadio()
+{
+    return &sim_current->radio;
+}
+
+uint8_t *simEeprom()
+{
+    return sim_current->eeprom;
+}
+
+SimNodeStats_t *simStats()
+{
+    return &sim_current->stats;
+}
+
+uint32_t simMillis()
+{
+    // a node that never waits would stop virtual time
+    if(sim_instance->isVirtual() && ++sim_current->spins > SIM_SPIN_LIMIT){
+        sim_instance->suspend(sim_current, sim_instance->now() + 1, SIM_NODE_DELAYED);
+    }
+
+    return (uint32_t) sim_instance->now();
+}
+
+void simYield()
+{
+    switchToScheduler();
+}
+
+void simDelay(uint32_t ms)
+{
+    sim_instance->suspend(sim_current, sim_instance->now() + ms, SIM_NODE_DELAYED);
+}
+
+void simHalt()
+{
+    sim_instance->suspend(sim_current, 0, SIM_NODE_HALTED);
+}
+
+void simIdleUntil(uint32_t end)
+{
+    sim_current->idle_until = end;
+}
+
+bool simReceive()
+{
+    SimNode *node = sim_current;
+
+    // in wall-clock time nodes poll the radio, the others run meanwhile
+    if(!sim_instance->isVirtual()){
+        simYield();
+    }
+
+    // like rf12_recvDone(), the call after a received packet only turns the receiver on again
+    if(!node->listening){
+        node->listening = true;
+        return false;
+    }
+
+    // in virtual time the node sleeps until a packet arrives or it stops waiting, without a hint it checks in 1 ms
+    if(!node->rx_count && sim_instance->isVirtual()){
+        uint32_t now = (uint32_t) sim_instance->now();
+        int32_t idle = (int32_t) (node->idle_until - now);
+
+        node->idle_until = 0;
+        sim_instance->suspend(node, sim_instance->now() + (idle > 0 ? idle : 1), SIM_NODE_WAITING);
+    }
+
+    if(!node->rx_count){
+        return false;
+    }
+
+    SimPacket_t *packet = &node->rx[node->rx_head];
+    node->radio.hdr = packet->hdr;
+    node->radio.len = packet->len;
+    memcpy((void*) node->radio.data, packet->data, packet->len);
+    node->radio.crc = 0;
+
+    node->rx_head = (node->rx_head + 1) % SIM_RX_QUEUE_MAX;
+    node->rx_count--;
+    node->listening = false;
+    node->packets_received++;
+
+    return true;
+}
+
+void simSend(uint8_t hdr, const void *data, uint8_t len)
+{
+    SimNode *node = sim_current;
+
+    // rf12_sendStart() builds the packet in the receive buffer, the data may already be there
+    if(len > SIM_RF12_MAXDATA){
+        len = SIM_RF12_MAXDATA;
+    }
+    if(len){
+        memmove((void*) node->radio.data, data, len);
+    }
+    node->radio.len = len;
+    node->radio.hdr = hdr & RF12_HDR_DST ? hdr : (hdr & ~RF12_HDR_MASK) | node->id;
+    node->listening = false;
+
+    sim_instance->transmit(node, hdr, (const void*) node->radio.data, len);
+}
+
+uint32_t simRandom()
+{
+    return xorshift(&sim_current->rng);
+}
+
+void simRandomSeed(uint32_t seed)
+{
+    sim_current->rng = mixSeed(seed, sim_current->id);
+}
+
+// SlaveBridge
+
+SlaveBridge::SlaveBridge():
+m_master_fd(-1), m_slave_fd(-1), m_queue_head(0), m_queue_count(0), m_connected(false)
+{
+    m_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(m_master_fd < 0 || grantpt(m_master_fd) || unlockpt(m_master_fd)){
+        if(m_master_fd >= 0){
+            close(m_master_fd);
+        }
+        throw std::runtime_error("Failed to create pseudo-terminal");
+    }
+
+    const char *path = ptsname(m_master_fd);
+    if(!path || (m_slave_fd = open(path, O_RDWR | O_NOCTTY)) < 0){
+        close(m_master_fd);
+        throw std::runtime_error("Failed to open pseudo-terminal");
+    }
+    m_path = path;
+
+    // raw bytes in both directions, the BS sets its own attributes when it opens the device
+    struct termios tty;
+    if(!tcgetattr(m_slave_fd, &tty)){
+        cfmakeraw(&tty);
+        tcsetattr(m_slave_fd, TCSANOW, &tty);
+    }
+
+    fcntl(m_master_fd, F_SETFL, fcntl(m_master_fd, F_GETFL) | O_NONBLOCK);
+}
+
+SlaveBridge::~SlaveBridge()
+{
+    close(m_slave_fd);
+    close(m_master_fd);
+}
+
+const std::string &SlaveBridge::getPath()
+{
+    return m_path;
+}
+
+void SlaveBridge::sendRecord(const uint8_t *record, uint8_t len)
+{
+    uint8_t encoded[LINK_MAX_ENCODED];
+    uint8_t encoded_len = linkEncode(record, len, encoded);
+
+    m_output.insert(m_output.end(), encoded, encoded + encoded_len);
+}
+
+void SlaveBridge::serviceHost()
+{
+    uint8_t buffer[256];
+    ssize_t len;
+
+    while((len = read(m_master_fd, buffer, sizeof(buffer))) > 0){
+        for(ssize_t i = 0; i < len; i++){
+            if(!m_decoder.push(buffer[i])){
+                continue;
+            }
+            m_connected = true;
+
+            uint8_t *record = m_decoder.record();
+            uint8_t record_len = m_decoder.recordLen();
+            if(record[0] != LINK_MSG || record_len < 3){
+                continue;
+            }
+
+            // the host keeps at most SLAVE_QUEUE_LEN messages in flight, same as BS_slave
+            if(m_queue_count >= SLAVE_QUEUE_LEN){
+                uint8_t status[3] = { LINK_STATUS, ERR_MSG_ADD, record[1] };
+                sendRecord(status, sizeof(status));
+                continue;
+            }
+
+            uint8_t tail = (m_queue_head + m_queue_count) % SLAVE_QUEUE_LEN;
+            m_queue[tail].hdr = BS_NODE_ID;
+            m_queue[tail].len = record_len - 2;
+            memcpy(m_queue[tail].data, record + 2, record_len - 2);
+            m_queue_seq[tail] = record[1];
+            m_queue_count++;
+        }
+    }
+
+    // the host may be slow to read, the rest is written next time
+    if(!m_output.empty()){
+        ssize_t written = write(m_master_fd, m_output.data(), m_output.size());
+        if(written > 0){
+            m_output.erase(m_output.begin(), m_output.begin() + written);
+        }
+    }
+}
+
+bool SlaveBridge::nextMessage(SimPacket_t *packet)
+{
+    if(!m_queue_count){
+        return false;
+    }
+
+    *packet = m_queue[m_queue_head];
+
+    uint8_t status[3] = { LINK_STATUS, ERR_OK, m_queue_seq[m_queue_head] };
+    sendRecord(status, sizeof(status));
+
+    m_queue_head = (m_queue_head + 1) % SLAVE_QUEUE_LEN;
+    m_queue_count--;
+
+    return true;
+}
+
+void SlaveBridge::radioReceive(const SimPacket_t *packet)
+{
+    uint8_t record[MAX_MSG_SIZE + 1];
+
+    // BS_slave drops frames longer than any protected message
+    if(packet->len > MAX_MSG_SIZE){
+        return;
+    }
+
+    record[0] = LINK_FRAME;
+    memcpy(record + 1, packet->data, packet->len);
+
+    sendRecord(record, packet->len + 1);
+}
+
+bool SlaveBridge::isConnected()
+{
+    return m_connected;
+}
+
+// Simulator
+
+Simulator::Simulator(uint32_t seed, uint8_t rx_queue, bool virtual_time, uint32_t threads):
+m_start(0), m_virtual(virtual_time), m_threads(threads), m_rx_queue(rx_queue), m_seed(seed)
+{
+    // BS hosts are served by a single thread in wall-clock time
+    if(!m_virtual || !m_threads){
+        m_threads = 1;
+    }
+    if(m_threads > SIM_MAX_THREADS){
+        m_threads = SIM_MAX_THREADS;
+    }
+
+    if(!m_rx_queue){
+        m_rx_queue = 1;
+    }
+    if(m_rx_queue > SIM_RX_QUEUE_MAX){
+        m_rx_queue = SIM_RX_QUEUE_MAX;
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+Simulator::~Simulator()
+{
+    if(sim_instance == this){
+        sim_instance = NULL;
+    }
+}
+
+/**
+ * @brief Read a value from key file
+ *
+ * @param input     Key file
+ * @param buffer    Output
+ * @param size      Size of the value
+ */
+static void readValue(std::ifstream &input, void *buffer, size_t size)
+{
+    if(!input.read(reinterpret_cast<char*>(buffer), size)){
+        throw std::runtime_error("Key file is corrupted");
+    }
+}
+
+uint32_t Simulator::addNetwork(const std::string &key_file)
+{
+    // same format as Configurator::saveToFile() writes
+    std::ifstream input(key_file, std::ios::binary);
+    if(!input.is_open()){
+        throw std::runtime_error("Failed to open key file " + key_file);
+    }
+
+    int nodes_num;
+    int key_size;
+    readValue(input, &nodes_num, sizeof(nodes_num));
+    readValue(input, &key_size, sizeof(key_size));
+    if(nodes_num < 1 || nodes_num > MAX_NODE_NUM || key_size != AES_KEY_SIZE){
+        throw std::runtime_error("Unsupported key file " + key_file);
+    }
+
+    std::vector<uint8_t> ids(nodes_num);
+    std::vector<std::vector<uint8_t>> bs_keys(nodes_num, std::vector<uint8_t>(key_size));
+    for(int i = 0; i < nodes_num; i++){
+        int name_len;
+        readValue(input, &name_len, sizeof(name_len));
+        if(name_len < 0 || name_len > 256){
+            throw std::runtime_error("Key file is corrupted");
+        }
+        input.ignore(name_len);
+        readValue(input, &ids[i], sizeof(ids[i]));
+        readValue(input, bs_keys[i].data(), key_size);
+
+        if(ids[i] < MIN_NODE_ID || ids[i] > MAX_NODE_NUM){
+            throw std::runtime_error("Invalid node ID in key file " + key_file);
+        }
+    }
+
+    // pairwise keys of nodes i and j < i
+    std::vector<std::vector<std::vector<uint8_t>>> pairwise(nodes_num);
+    for(int i = 0; i < nodes_num; i++){
+        for(int j = 0; j < i; j++){
+            pairwise[i].push_back(std::vector<uint8_t>(key_size));
+            readValue(input, pairwise[i][j].data(), key_size);
+        }
+    }
+
+    int rounds;
+    uint8_t first_key[AES_KEY_SIZE];
+    uint8_t last_element[AES_KEY_SIZE];
+    readValue(input, &rounds, sizeof(rounds));
+    readValue(input, first_key, key_size);
+    readValue(input, last_element, key_size);
+
+    uint32_t nodes_list = 0;
+    for(int i = 0; i < nodes_num; i++){
+        setBit(nodes_list, ids[i]);
+    }
+
+    SimNetwork network;
+    uint32_t network_index = m_networks.size();
+    network.key_file = key_file;
+    network.bs = m_nodes.size();
+    network.size = nodes_num + 1;
+    network.beacons_sent = 0;
+    network.frames = 0;
+    network.reports = 0;
+    network.report_repeats = 0;
+    network.order = 0;
+    network.now = 0;
+    network.rng = mixSeed(mixSeed(m_seed, network_index), 0);
+    memset(&network.stats, 0, sizeof(network.stats));
+
+    // BS is a host on a pseudo-terminal, it cannot follow virtual time - built-in BS sends CTP beacons instead
+    if(!m_virtual){
+        network.bridge.reset(new SlaveBridge());
+    }
+
+    SPHeader_t *header = reinterpret_cast<SPHeader_t*>(network.beacon);
+    header->msgType = MSG_CTP;
+    header->sender = BS_NODE_ID;
+    header->receiver = 0;
+    header->seq = 0;
+    memset(network.beacon + SPHEADER_SIZE, 0, CTP_BEACON_SIZE - SPHEADER_SIZE);
+
+    // BS radio first, nodes follow on a line
+    for(int i = -1; i < nodes_num; i++){
+        std::unique_ptr<SimNode> node(new SimNode());
+
+        node->index = m_nodes.size();
+        node->id = i < 0 ? BS_NODE_ID : ids[i];
+        node->network = network_index;
+        node->x = i + 1;
+        node->y = 0;
+        node->bridge = i < 0 ? network.bridge.get() : NULL;
+        node->rx_head = 0;
+        node->rx_count = 0;
+        node->listening = true;
+        node->rng = mixSeed(mixSeed(m_seed, network_index), node->id);
+        node->state = SIM_NODE_READY;
+        node->wake = 0;
+        node->timer = SIM_NO_TIMER;
+        node->idle_until = 0;
+        node->spins = 0;
+        node->packets_sent = 0;
+        node->packets_received = 0;
+        node->overruns = 0;
+        node->bs_frames = 0;
+        node->report_seq = -1;
+        memset(&node->radio, 0, sizeof(node->radio));
+        memset(&node->stats, 0, sizeof(node->stats));
+        memset(node->eeprom, 0xFF, SIM_EEPROM_SIZE);
+
+        // EEPROM content as written by the configurator node
+        if(i >= 0){
+            uint8_t *eeprom = node->eeprom;
+
+            eeprom[NODE_ID_LOCATION] = node->id;
+            memcpy(eeprom + (uintptr_t) KEYS_START_ADDRESS + (BS_NODE_ID - 1) * AES_KEY_SIZE, bs_keys[i].data(), key_size);
+            for(int j = 0; j < nodes_num; j++){
+                if(j != i){
+                    const std::vector<uint8_t> &key = i > j ? pairwise[i][j] : pairwise[j][i];
+                    memcpy(eeprom + (uintptr_t) KEYS_START_ADDRESS + (ids[j] - 1) * AES_KEY_SIZE, key.data(), key_size);
+                }
+            }
+            memcpy(eeprom + (uintptr_t) UTESLA_KEY_ADDRESS, last_element, key_size);
+            memcpy(eeprom + (uintptr_t) NODES_LIST_ADDRESS, &nodes_list, sizeof(nodes_list));
+        }
+
+        m_nodes.push_back(std::move(node));
+    }
+
+    m_networks.push_back(std::move(network));
+
+    connect(network_index, SIM_DEFAULT_RANGE, SIM_DEFAULT_LOSS, SIM_DEFAULT_LATENCY);
+
+    return network_index;
+}
+
+SimNode *Simulator::getNode(uint32_t network, uint8_t id)
+{
+    if(network >= m_networks.size()){
+        return NULL;
+    }
+
+    // radios of a network are stored together
+    for(uint32_t i = m_networks[network].bs; i < m_networks[network].bs + m_networks[network].size; i++){
+        if(m_nodes[i]->id == id){
+            return m_nodes[i].get();
+        }
+    }
+
+    return NULL;
+}
+
+const std::vector<std::unique_ptr<SimNode>> &Simulator::getNodes()
+{
+    return m_nodes;
+}
+
+std::vector<SimNetwork> &Simulator::getNetworks()
+{
+    return m_networks;
+}
+
+void Simulator::connect(uint32_t network, double range, double loss, uint32_t latency)
+{
+    uint32_t first = m_networks[network].bs;
+    uint32_t last = first + m_networks[network].size;
+
+    for(uint32_t i = first; i < last; i++){
+        SimNode *a = m_nodes[i].get();
+
+        a->links.clear();
+        for(uint32_t j = first; j < last; j++){
+            SimNode *b = m_nodes[j].get();
+            if(i == j){
+                continue;
+            }
+
+            if(std::hypot(a->x - b->x, a->y - b->y) <= range){
+                a->links.push_back(SimLink{ j, loss, latency });
+            }
+        }
+    }
+}
+
+/**
+ * @brief Set or remove one-way link
+ *
+ * @param from      Transmitting radio
+ * @param to        Index of receiving radio
+ * @param loss      Loss probability, 1 removes the link
+ * @param latency   Latency
+ */
+static void setOneWay(SimNode *from, uint32_t to, double loss, uint32_t latency)
+{
+    for(std::vector<SimLink>::iterator it = from->links.begin(); it != from->links.end(); it++){
+        if(it->to == to){
+            from->links.erase(it);
+            break;
+        }
+    }
+
+    if(loss < 1){
+        from->links.push_back(SimLink{ to, loss, latency });
+    }
+}
+
+bool Simulator::setLink(uint32_t network, uint8_t a, uint8_t b, double loss, uint32_t latency)
+{
+    SimNode *node_a = getNode(network, a);
+    SimNode *node_b = getNode(network, b);
+
+    if(!node_a || !node_b || node_a == node_b){
+        return false;
+    }
+
+    setOneWay(node_a, node_b->index, loss, latency);
+    setOneWay(node_b, node_a->index, loss, latency);
+
+    return true;
+}
+
+uint64_t Simulator::now()
+{
+    if(m_virtual){
+        return sim_network ? sim_network->now : 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000 - m_start;
+}
+
+bool Simulator::isVirtual()
+{
+    return m_virtual;
+}
+
+void Simulator::suspend(SimNode *node, uint64_t until, uint8_t state)
+{
+    node->state = state;
+    node->wake = until;
+    node->spins = 0;
+
+    // an earlier wake event is kept, it plans a new one if the node still sleeps - the queue holds few events per node
+    if(m_virtual && state != SIM_NODE_HALTED && until < node->timer){
+        node->timer = until;
+        schedule(m_networks[node->network], until, SIM_EVENT_WAKE, node->index, 0);
+    }
+
+    switchToScheduler();
+}
+
+void Simulator::wake(SimNode *node)
+{
+    node->state = SIM_NODE_READY;
+
+    if(m_virtual){
+        m_networks[node->network].ready.push_back(node->index);
+    }
+}
+
+double Simulator::uniform(SimNetwork &network)
+{
+    return xorshift(&network.rng) / 4294967296.0;
+}
+
+void Simulator::transmit(SimNode *from, uint8_t hdr, const void *data, uint8_t len)
+{
+    SimPacket_t packet;
+
+    // JeeLib puts the sender's ID to packets without a destination
+    packet.hdr = hdr & RF12_HDR_DST ? hdr : (hdr & ~RF12_HDR_MASK) | from->id;
+    packet.len = len > SIM_RF12_MAXDATA ? SIM_RF12_MAXDATA : len;
+    memcpy(packet.data, data, packet.len);
+
+    // links never leave the network, the packet stays in its medium
+    SimNetwork &network = m_networks[from->network];
+
+    from->packets_sent++;
+    network.stats.transmissions++;
+    network.stats.bytes += packet.len;
+
+    // receivers share one copy of the packet
+    uint32_t index;
+    if(network.free_packets.empty()){
+        index = network.packets.size();
+        network.packets.push_back(packet);
+        network.packet_refs.push_back(0);
+    } else {
+        index = network.free_packets.back();
+        network.free_packets.pop_back();
+        network.packets[index] = packet;
+    }
+
+    uint64_t time = now();
+    for(const SimLink &link: from->links){
+        if(link.loss > 0 && uniform(network) < link.loss){
+            network.stats.losses++;
+            continue;
+        }
+
+        network.packet_refs[index]++;
+        schedule(network, time + link.latency, SIM_EVENT_PACKET, link.to, index);
+    }
+
+    if(!network.packet_refs[index]){
+        network.free_packets.push_back(index);
+    }
+}
+
+void Simulator::schedule(SimNetwork &network, uint64_t time, uint8_t type, uint32_t to, uint32_t packet)
+{
+    SimEvent event;
+    event.time = time;
+    event.order = network.order++;
+    event.to = to;
+    event.packet = packet;
+    event.type = type;
+
+    network.events.push(event);
+}
+
+void Simulator::deliverEvent(SimNetwork &network, const SimEvent &event)
+{
+    receive(m_nodes[event.to].get(), &network.packets[event.packet]);
+
+    if(!--network.packet_refs[event.packet]){
+        network.free_packets.push_back(event.packet);
+    }
+}
+
+void Simulator::deliver(SimNetwork &network, uint64_t now)
+{
+    while(!network.events.empty() && network.events.top().time <= now){
+        SimEvent event = network.events.top();
+        network.events.pop();
+
+        deliverEvent(network, event);
+    }
+}
+
+void Simulator::receive(SimNode *node, const SimPacket_t *packet)
+{
+    // the radio drops packets addressed to other nodes
+    if((packet->hdr & RF12_HDR_DST) && (packet->hdr & RF12_HDR_MASK) != node->id){
+        return;
+    }
+
+    // BS slave - radio is always on, it passes packets for BS to the host and acknowledges them
+    if(node->id == BS_NODE_ID){
+        if(packet->hdr & RF12_HDR_CTL || (packet->hdr & RF12_HDR_MASK) != BS_NODE_ID){
+            return;
+        }
+        m_networks[node->network].stats.deliveries++;
+
+        if((packet->hdr & RF12_HDR_ACK)){
+            uint8_t ack_hdr = packet->hdr & RF12_HDR_DST ? RF12_HDR_CTL : RF12_HDR_CTL | RF12_HDR_DST | (packet->hdr & RF12_HDR_MASK);
+            transmit(node, ack_hdr, packet->data, packet->len < SPHEADER_SIZE ? 0 : SPHEADER_SIZE);
+        }
+
+        // targeted beacons only check the link
+        if(packet->len < SPHEADER_SIZE || packet->data[0] == MSG_CTP){
+            return;
+        }
+
+        // the original sender stays in the header of forwarded messages
+        const SPHeader_t *header = reinterpret_cast<const SPHeader_t*>(packet->data);
+        SimNode *sender = getNode(node->network, header->sender);
+        if(sender){
+            sender->bs_frames++;
+        }
+        m_networks[node->network].frames++;
+        if(header->msgType == MSG_CTP_DONE){
+            // retransmission after a lost acknowledgement carries the same sequence number
+            if(sender && sender->report_seq == header->seq){
+                m_networks[node->network].report_repeats++;
+            }
+            else {
+                m_networks[node->network].reports++;
+            }
+            if(sender){
+                sender->report_seq = header->seq;
+            }
+        }
+
+        if(node->bridge){
+            node->bridge->radioReceive(packet);
+        }
+        return;
+    }
+
+    // RF12 holds a single packet and only while the receiver is on, longer queues hide delays of the scheduler
+    if(node->rx_count >= m_rx_queue || (m_rx_queue == 1 && !node->listening) || node->state >= SIM_NODE_HALTED){
+        node->overruns++;
+        m_networks[node->network].stats.overruns++;
+        return;
+    }
+
+    node->rx[(node->rx_head + node->rx_count) % SIM_RX_QUEUE_MAX] = *packet;
+    node->rx_count++;
+    m_networks[node->network].stats.deliveries++;
+
+    if(node->state == SIM_NODE_WAITING){
+        wake(node);
+    }
+}
+
+void Simulator::resume(SimNode *node)
+{
+    sim_current = node;
+    if(!_setjmp(sim_scheduler)){
+        if(node->started){
+            _longjmp(node->jump, 1);
+        }
+
+        // the first run starts the coroutine on its stack
+        node->started = true;
+        setcontext(&node->context);
+    }
+    sim_current = NULL;
+}
+
+void Simulator::sendBeacon(uint32_t network)
+{
+    SimNetwork &net = m_networks[network];
+
+    // nodes estimate the link quality from lost beacons
+    reinterpret_cast<SPHeader_t*>(net.beacon)->seq++;
+    transmit(m_nodes[net.bs].get(), BS_NODE_ID, net.beacon, CTP_BEACON_SIZE);
+
+    if(++net.beacons_sent < CTP_REBROADCASTS_NUM){
+        schedule(net, net.now + CTP_REBROADCASTS_DELAY, SIM_EVENT_BEACON, network, 0);
+    }
+}
+
+void Simulator::runRealTime(uint64_t duration, volatile bool *stop)
+{
+    m_start = 0;
+    m_start = now();
+
+    while(!*stop){
+        uint64_t time = now();
+        if(time >= duration){
+            break;
+        }
+
+        // messages from BS hosts go to the air
+        for(SimNetwork &network: m_networks){
+            SimPacket_t packet;
+
+            deliver(network, time);
+
+            network.bridge->serviceHost();
+            while(network.bridge->nextMessage(&packet)){
+                transmit(m_nodes[network.bs].get(), packet.hdr, packet.data, packet.len);
+            }
+        }
+
+        bool active = false;
+        for(std::unique_ptr<SimNode> &node: m_nodes){
+            if(node->id == BS_NODE_ID){
+                continue;
+            }
+
+            if((node->state == SIM_NODE_DELAYED || node->state == SIM_NODE_WAITING) && node->wake <= time){
+                node->state = SIM_NODE_READY;
+            }
+
+            if(node->state == SIM_NODE_READY){
+                resume(node.get());
+                active = true;
+            }
+        }
+
+        // everybody sleeps - wait for the next millisecond
+        if(!active){
+            usleep(500);
+        }
+    }
+
+    // flush records for the hosts
+    for(SimNetwork &network: m_networks){
+        network.bridge->serviceHost();
+    }
+}
+
+void Simulator::runNetwork(SimNetwork &network, uint64_t end)
+{
+    sim_network = &network;
+
+    while(1){
+        // nodes run until they wait, no time passes meanwhile
+        while(!network.ready.empty()){
+            SimNode *node = m_nodes[network.ready.front()].get();
+            network.ready.pop_front();
+
+            if(node->state == SIM_NODE_READY){
+                resume(node);
+            }
+        }
+
+        if(network.events.empty() || network.events.top().time >= end){
+            network.now = end;
+            break;
+        }
+
+        SimEvent event = network.events.top();
+        network.events.pop();
+        network.now = event.time;
+
+        SimNode *node;
+        switch(event.type){
+        case SIM_EVENT_PACKET:
+            deliverEvent(network, event);
+            break;
+        case SIM_EVENT_WAKE:
+            node = m_nodes[event.to].get();
+            if(event.time == node->timer){
+                node->timer = SIM_NO_TIMER;
+            }
+            if(node->state != SIM_NODE_DELAYED && node->state != SIM_NODE_WAITING){
+                break;
+            }
+
+            // a packet woke the node earlier and it sleeps again, possibly longer
+            if(node->wake <= network.now){
+                wake(node);
+            } else if(node->timer == SIM_NO_TIMER){
+                node->timer = node->wake;
+                schedule(network, node->wake, SIM_EVENT_WAKE, node->index, 0);
+            }
+            break;
+        case SIM_EVENT_BEACON:
+            sendBeacon(event.to);
+            break;
+        }
+    }
+
+    sim_network = NULL;
+}
+
+void Simulator::runWorker(uint32_t worker, uint64_t duration, volatile bool *stop)
+{
+    // radios of different networks never hear each other and a network never leaves its worker, so no event crosses
+    // workers and they run independently - the window only limits how long a stop request waits
+    for(uint64_t end = 0; end < duration && !*stop;){
+        end = std::min(end + SIM_WINDOW_MS, duration);
+
+        for(uint32_t i = worker; i < m_networks.size(); i += m_threads){
+            runNetwork(m_networks[i], end);
+        }
+    }
+}
+
+void Simulator::runVirtualTime(uint64_t duration, volatile bool *stop)
+{
+    // nodes boot in the order they were added, BS starts CTP at once
+    for(uint32_t i = 0; i < m_networks.size(); i++){
+        SimNetwork &network = m_networks[i];
+
+        network.now = 0;
+        for(uint32_t j = network.bs; j < network.bs + network.size; j++){
+            if(m_nodes[j]->id != BS_NODE_ID){
+                network.ready.push_back(j);
+            }
+        }
+        schedule(network, 0, SIM_EVENT_BEACON, i, 0);
+    }
+
+    // the calling thread is the first worker
+    std::vector<std::thread> workers;
+    for(uint32_t i = 1; i < m_threads; i++){
+        workers.push_back(std::thread(&Simulator::runWorker, this, i, duration, stop));
+    }
+    runWorker(0, duration, stop);
+
+    for(std::thread &worker: workers){
+        worker.join();
+    }
+}
+
+void Simulator::run(uint64_t duration, volatile bool *stop)
+{
+    sim_instance = this;
+
+    // coroutines of the nodes, BS radios are served by the scheduler
+    for(std::unique_ptr<SimNode> &node: m_nodes){
+        if(node->id == BS_NODE_ID){
+            continue;
+        }
+
+        node->stack.reset(new uint8_t[SIM_STACK_SIZE]);
+        getcontext(&node->context);
+        node->context.uc_stack.ss_sp = node->stack.get();
+        node->context.uc_stack.ss_size = SIM_STACK_SIZE;
+        node->context.uc_link = NULL;
+        makecontext(&node->context, nodeEntry, 0);
+        node->started = false;
+        node->state = SIM_NODE_READY;
+    }
+
+    if(m_virtual){
+        runVirtualTime(duration, stop);
+    } else {
+        runRealTime(duration, stop);
+    }
+}
+
+const SimMediumStats &Simulator::getStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    for(SimNetwork &network: m_networks){
+        m_stats.transmissions += network.stats.transmissions;
+        m_stats.bytes += network.stats.bytes;
+        m_stats.deliveries += network.stats.deliveries;
+        m_stats.losses += network.stats.losses;
+        m_stats.overruns += network.stats.overruns;
+    }
+
+    return m_stats;
+}
@@ -0,0 +1,487 @@
+/**
+ * @brief Simulator of RF12 networks running the node code on Linux. Nodes are coroutines scheduled by a single
+ * thread, they talk over a simulated radio medium and a real Linux base station is connected to each network over
+ * a pseudo-terminal that behaves like the BS slave device. In virtual time the simulation is a deterministic
+ * discrete-event simulation - the clock jumps to the next event and a built-in BS starts CTP in every network.
+ * Every network has its own event queue and clock, so networks can be shared out between worker threads.
+ *
+ * @file    Simulator.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+#include <deque>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "ProtectLayerGlobals.h"
+#include "SerialLink.h"
+#include "SimShim.h"
+
+#define SIM_STACK_SIZE          (64 * 1024)     // stack of a node coroutine
+#define SIM_RX_QUEUE_MAX        16              // longest receive queue of a node
+#define SIM_RX_QUEUE            4               // default receive queue, hides delays of the scheduler
+#define SIM_SPIN_LIMIT          100000          // millis() calls after which a node that never waits is suspended for 1 ms
+#define SIM_WINDOW_MS           1000            // virtual time a worker runs its networks before it checks for a stop
+#define SIM_MAX_THREADS         256             // most worker threads
+
+// default radio parameters, topology file can change them
+#define SIM_DEFAULT_RANGE       1.5             // nodes closer than this hear each other
+#define SIM_DEFAULT_LOSS        0.0             // probability that a packet is lost on a link
+#define SIM_DEFAULT_LATENCY     2               // delay between transmission and reception in milliseconds
+
+// state of a node coroutine
+#define SIM_NODE_READY          0               // runs whenever the scheduler gets to it
+#define SIM_NODE_DELAYED        1               // waits until its wake time
+#define SIM_NODE_WAITING        2               // waits in rf12_recvDone() for a packet or its wake time
+#define SIM_NODE_HALTED         3               // sleeps forever
+#define SIM_NODE_FINISHED       4               // application returned
+
+// events of the virtual time scheduler
+#define SIM_EVENT_PACKET        0               // packet arrives to a radio
+#define SIM_EVENT_WAKE          1               // delayed or waiting node wakes up
+#define SIM_EVENT_BEACON        2               // built-in BS sends a CTP beacon
+#define SIM_NO_TIMER            UINT64_MAX      // node has no wake event in the queue
+
+/**
+ * @brief Packet in the air
+ *
+ */
+typedef struct _SimPacket {
+    uint8_t hdr;                                // header as transmitted - destination ID for DST packets, source otherwise
+    uint8_t len;                                // payload length
+    uint8_t data[SIM_RF12_MAXDATA];             // payload
+} SimPacket_t;
+
+/**
+ * @brief One-way link between two radios
+ *
+ */
+struct SimLink {
+    uint32_t    to;                             // receiving node, index into Simulator::m_nodes
+    double      loss;                           // loss probability
+    uint32_t    latency;                        // delay in milliseconds
+};
+
+class SlaveBridge;
+
+/**
+ * @brief Simulated device - a node running the node code, or the radio of a BS slave
+ *
+ */
+struct SimNode {
+    uint32_t                    index;                  // index into Simulator::m_nodes
+    uint8_t                     id;                     // node ID
+    uint32_t                    network;                // index of the network
+    double                      x;                      // position
+    double                      y;
+    std::vector<SimLink>        links;                  // radios that hear this one
+    SlaveBridge                 *bridge;                // BS slave, NULL for ordinary nodes
+
+    SimRadio_t                  radio;                  // RF12 receive buffer
+    SimPacket_t                 rx[SIM_RX_QUEUE_MAX];   // received packets not yet taken by rf12_recvDone()
+    uint8_t                     rx_head;                // oldest packet in rx
+    uint8_t                     rx_count;               // number of packets in rx
+    bool                        listening;              // receiver is on - off while the application holds a packet
+    uint8_t                     eeprom[SIM_EEPROM_SIZE];// EEPROM content
+    uint32_t                    rng;                    // state of the pseudo-random generator
+    SimNodeStats_t              stats;                  // statistics reported by the node
+
+    ucontext_t                  context;                // coroutine start
+    jmp_buf                     jump;                   // position of the suspended coroutine
+    bool                        started;                // coroutine runs, it continues from jump
+    std::unique_ptr<uint8_t[]>  stack;                  // coroutine stack
+    uint8_t                     state;                  // SIM_NODE_*
+    uint64_t                    wake;                   // time a delayed node continues
+    uint64_t                    timer;                  // earliest wake event of the node in the queue, SIM_NO_TIMER if none
+    uint32_t                    idle_until;             // time given by simIdleUntil(), 0 if not given
+    uint32_t                    spins;                  // millis() calls since the node waited last time
+
+    uint32_t                    packets_sent;           // packets transmitted
+    uint32_t                    packets_received;       // packets taken by the node
+    uint32_t                    overruns;               // packets lost because the receiver was off or full
+    uint32_t                    bs_frames;              // packets from this node that reached BS
+    int16_t                     report_seq;             // sequence number of the last CTP_DONE report BS got, -1 if none
+};
+
+/**
+ * @brief Base station slave emulated on a pseudo-terminal. Speaks the same protocol as BS_slave - LINK_MSG records are
+ * transmitted by the BS radio and confirmed by LINK_STATUS, packets for the BS are passed as LINK_FRAME.
+ *
+ */
+class SlaveBridge {
+private:
+    int                         m_master_fd;            // master side of the pseudo-terminal
+    int                         m_slave_fd;             // slave side kept open so the master never sees a hangup
+    std::string                 m_path;                 // path to the slave side, opened by the BS
+    LinkDecoder                 m_decoder;              // records from the host
+    std::vector<uint8_t>        m_output;               // encoded records not yet written to the host
+    SimPacket_t                 m_queue[SLAVE_QUEUE_LEN];   // messages from the host waiting for the radio
+    uint8_t                     m_queue_seq[SLAVE_QUEUE_LEN];
+    uint8_t                     m_queue_head;
+    uint8_t                     m_queue_count;
+    bool                        m_connected;            // host sent at least one record
+
+    /**
+     * @brief Encode record and queue it for the host
+     *
+     * @param record    Record starting with its type
+     * @param len       Record length
+     */
+    void sendRecord(const uint8_t *record, uint8_t len);
+
+public:
+    /**
+     * @brief Constructor, creates the pseudo-terminal
+     *
+     */
+    SlaveBridge();
+
+    /**
+     * @brief Destructor, closes the pseudo-terminal
+     *
+     */
+    ~SlaveBridge();
+
+    /**
+     * @brief Get path to the device the BS has to open
+     *
+     * @return const std::string&   Path
+     */
+    const std::string &getPath();
+
+    /**
+     * @brief Read records from the host and write queued ones, never blocks
+     *
+     */
+    void serviceHost();
+
+    /**
+     * @brief Take the oldest message from the host waiting for the radio and confirm it to the host
+     *
+     * @param packet    Output, header is the BS header
+     * @return true     Message was taken
+     * @return false    No message is waiting
+     */
+    bool nextMessage(SimPacket_t *packet);
+
+    /**
+     * @brief Handle packet received by the BS radio, it is passed to the host if it is addressed to BS
+     *
+     * @param packet    Received packet
+     */
+    void radioReceive(const SimPacket_t *packet);
+
+    /**
+     * @brief Check whether the BS has connected
+     *
+     * @return true     BS sent at least one record
+     * @return false    Otherwise
+     */
+    bool isConnected();
+};
+
+/**
+ * @brief Counters of the radio medium
+ *
+ */
+struct SimMediumStats {
+    uint64_t    transmissions;      // packets transmitted
+    uint64_t    bytes;              // payload bytes transmitted
+    uint64_t    deliveries;         // packets that reached a listening receiver
+    uint64_t    losses;             // packets lost on links
+    uint64_t    overruns;           // packets lost at receivers that were not listening
+};
+
+/**
+ * @brief Packet on its way to a receiver, or a timer of virtual time
+ *
+ */
+struct SimEvent {
+    uint64_t        time;       // time of the event
+    uint64_t        order;      // creation order in the network, keeps events at the same time ordered
+    uint32_t        to;         // receiving radio, woken node or network of the built-in BS
+    uint32_t        packet;     // packet of SIM_EVENT_PACKET, index into SimNetwork::packets
+    uint8_t         type;       // SIM_EVENT_*
+
+    bool operator>(const SimEvent &other) const
+    {
+        return time != other.time ? time > other.time : order > other.order;
+    }
+};
+
+/**
+ * @brief Network with its own BS - nodes from a single key file. Radios of different networks never hear each other,
+ * so every network has its own medium - events, clock and loss generator - and it runs independently of the others.
+ *
+ */
+struct SimNetwork {
+    std::string                     key_file;       // configurator key file of the network
+    uint32_t                        bs;             // index of BS radio in Simulator::m_nodes, nodes follow it
+    uint32_t                        size;           // number of radios including BS
+    std::unique_ptr<SlaveBridge>    bridge;         // BS slave, NULL with virtual time - built-in BS is used
+    uint8_t                         beacon[CTP_BEACON_SIZE];    // CTP beacon of the built-in BS
+    uint8_t                         beacons_sent;   // beacons the built-in BS sent
+    uint32_t                        frames;         // packets for BS received by its radio
+    uint32_t                        reports;        // CTP_DONE reports among them, each counted once
+    uint32_t                        report_repeats; // reports sent again because BS acknowledgement was lost
+
+    std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> events;   // packets in the air and timers
+    std::deque<uint32_t>            ready;          // nodes to run at the current virtual time
+    std::vector<SimPacket_t>        packets;        // packets in the air, shared by their receivers
+    std::vector<uint32_t>           packet_refs;    // receivers that did not get the packet yet
+    std::vector<uint32_t>           free_packets;   // unused entries of packets
+    uint64_t                        order;          // events so far
+    uint64_t                        now;            // virtual time of the network
+    uint32_t                        rng;            // generator deciding losses
+    SimMediumStats                  stats;          // medium counters
+};
+
+/**
+ * @brief The simulator - radio medium and scheduler of node coroutines
+ *
+ */
+class Simulator {
+private:
+    std::vector<std::unique_ptr<SimNode>>   m_nodes;        // all radios - nodes and BS slaves
+    std::vector<SimNetwork>                 m_networks;     // networks
+    uint64_t                                m_start;        // wall-clock time the simulation started
+    bool                                    m_virtual;      // discrete-event mode with virtual time
+    uint32_t                                m_threads;      // worker threads of virtual time
+    uint8_t                                 m_rx_queue;     // receive queue length of nodes
+    uint32_t                                m_seed;         // seed of the node generators
+    SimMediumStats                          m_stats;        // medium counters of all networks
+
+    /**
+     * @brief Add event to the queue of a network
+     *
+     * @param network   Network
+     * @param time      Time of the event
+     * @param type      SIM_EVENT_*
+     * @param to        Receiving radio, woken node or network of the built-in BS
+     * @param packet    Index into SimNetwork::packets for SIM_EVENT_PACKET
+     */
+    void schedule(SimNetwork &network, uint64_t time, uint8_t type, uint32_t to, uint32_t packet);
+
+    /**
+     * @brief Pass packet of an event to its receiver and release the packet after the last one
+     *
+     * @param network   Network of the receiver
+     * @param event     SIM_EVENT_PACKET event
+     */
+    void deliverEvent(SimNetwork &network, const SimEvent &event);
+
+    /**
+     * @brief Deliver packets of a network whose arrival time has come
+     *
+     * @param network   Network
+     * @param now       Current time
+     */
+    void deliver(SimNetwork &network, uint64_t now);
+
+    /**
+     * @brief Pass received packet to the receiver
+     *
+     * @param node      Receiver
+     * @param packet    Packet
+     */
+    void receive(SimNode *node, const SimPacket_t *packet);
+
+    /**
+     * @brief Run node coroutine until it yields
+     *
+     * @param node  Node
+     */
+    void resume(SimNode *node);
+
+    /**
+     * @brief Make suspended node ready to run at the current virtual time
+     *
+     * @param node  Node
+     */
+    void wake(SimNode *node);
+
+    /**
+     * @brief Send beacon of the built-in BS and plan the next one, like BS CTP::startCTP()
+     *
+     * @param network   Network index
+     */
+    void sendBeacon(uint32_t network);
+
+    /**
+     * @brief Run nodes in wall-clock time, BS hosts are connected over pseudo-terminals
+     *
+     * @param duration  Duration in milliseconds
+     * @param stop      Simulation ends early when it becomes true
+     */
+    void runRealTime(uint64_t duration, volatile bool *stop);
+
+    /**
+     * @brief Run nodes in virtual time on worker threads
+     *
+     * @param duration  Duration in milliseconds
+     * @param stop      Simulation ends early when it becomes true
+     */
+    void runVirtualTime(uint64_t duration, volatile bool *stop);
+
+    /**
+     * @brief Run networks of a worker window by window, a network always runs on the same worker because node
+     * coroutines cannot move between threads
+     *
+     * @param worker    Worker index, it runs networks worker, worker + m_threads, ...
+     * @param duration  Duration in milliseconds
+     * @param stop      Simulation ends early when it becomes true
+     */
+    void runWorker(uint32_t worker, uint64_t duration, volatile bool *stop);
+
+    /**
+     * @brief Run network in virtual time - nodes run one at a time until they wait and the time jumps to the next
+     * event
+     *
+     * @param network   Network
+     * @param end       Events before this time are handled
+     */
+    void runNetwork(SimNetwork &network, uint64_t end);
+
+    /**
+     * @brief Uniformly distributed number from [0, 1)
+     *
+     * @param network   Network whose generator is used
+     * @return double   Random number
+     */
+    double uniform(SimNetwork &network);
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param seed          Seed of the generators deciding losses and seeding nodes
+     * @param rx_queue      Receive queue length of nodes, 1 behaves like RF12 hardware
+     * @param virtual_time  Discrete-event simulation in virtual time with the built-in BS, results depend only on
+     *                      the seed and the topology. Wall-clock time with BS hosts on pseudo-terminals otherwise.
+     * @param threads       Worker threads of virtual time, networks are shared out between them and the results do
+     *                      not depend on their number
+     */
+    Simulator(uint32_t seed, uint8_t rx_queue = SIM_RX_QUEUE, bool virtual_time = false, uint32_t threads = 1);
+
+    /**
+     * @brief Destructor
+     *
+     */
+    ~Simulator();
+
+    /**
+     * @brief Add network configured by a key file from configurator, the nodes get EEPROM content as if they were
+     * configured by the configurator. BS has ID BS_NODE_ID. Several networks can use the same key file.
+     *
+     * @param key_file  Key file
+     * @return uint32_t Index of the network, throws runtime_error if the file cannot be loaded
+     */
+    uint32_t addNetwork(const std::string &key_file);
+
+    /**
+     * @brief Find a radio
+     *
+     * @param network   Network index
+     * @param id        Node ID, BS_NODE_ID for the BS
+     * @return SimNode* Radio or NULL if there is no such node
+     */
+    SimNode *getNode(uint32_t network, uint8_t id);
+
+    /**
+     * @brief Get all radios
+     *
+     * @return const std::vector<std::unique_ptr<SimNode>>& Nodes and BS slaves
+     */
+    const std::vector<std::unique_ptr<SimNode>> &getNodes();
+
+    /**
+     * @brief Get all networks
+     *
+     * @return std::vector<SimNetwork>& Networks
+     */
+    std::vector<SimNetwork> &getNetworks();
+
+    /**
+     * @brief Connect radios of a network by their positions, replaces existing links
+     *
+     * @param network   Network index
+     * @param range     Radios closer than range hear each other
+     * @param loss      Loss probability of the links
+     * @param latency   Latency of the links
+     */
+    void connect(uint32_t network, double range, double loss, uint32_t latency);
+
+    /**
+     * @brief Set or remove link between two radios in both directions
+     *
+     * @param network   Network index
+     * @param a         ID of the first node
+     * @param b         ID of the second node
+     * @param loss      Loss probability, 1 removes the link
+     * @param latency   Latency
+     * @return true     Link was set
+     * @return false    There is no such node
+     */
+    bool setLink(uint32_t network, uint8_t a, uint8_t b, double loss, uint32_t latency);
+
+    /**
+     * @brief Current simulation time, in virtual time the time of the network the calling thread runs
+     *
+     * @return uint64_t Milliseconds since the start
+     */
+    uint64_t now();
+
+    /**
+     * @brief Check whether the simulation runs in virtual time
+     *
+     * @return true     Virtual time
+     * @return false    Wall-clock time
+     */
+    bool isVirtual();
+
+    /**
+     * @brief Suspend the running node
+     *
+     * @param node      Running node
+     * @param until     Wake time
+     * @param state     SIM_NODE_DELAYED, SIM_NODE_WAITING (packet wakes it too) or SIM_NODE_HALTED
+     */
+    void suspend(SimNode *node, uint64_t until, uint8_t state);
+
+    /**
+     * @brief Transmit packet by a radio, receivers get it after the link latency
+     *
+     * @param from      Transmitting radio
+     * @param hdr       Header passed to rf12_sendStart()
+     * @param data      Payload
+     * @param len       Payload length
+     */
+    void transmit(SimNode *from, uint8_t hdr, const void *data, uint8_t len);
+
+    /**
+     * @brief Run the simulation
+     *
+     * @param duration  Duration in milliseconds
+     * @param stop      Simulation ends early when it becomes true
+     */
+    void run(uint64_t duration, volatile bool *stop);
+
+    /**
+     * @brief Get medium counters summed over all networks
+     *
+     * @return const SimMediumStats&    Counters
+     */
+    const SimMediumStats &getStats();
+};
+
+#endif // SIMULATOR_H
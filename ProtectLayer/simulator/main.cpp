@@ -0,0 +1,435 @@
+/**
+ * @brief Simulator command line - loads topology, runs the nodes and prints their statistics
+ *
+ * @file    main.cpp
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#include "Simulator.h"
+#include "common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define SIM_DEFAULT_DURATION    120     // seconds
+
+static volatile bool stop_simulation = false;
+
+/**
+ * @brief Link set explicitly by the topology file
+ *
+ */
+struct LinkConfig {
+    uint8_t     a;
+    uint8_t     b;
+    double      loss;
+    uint32_t    latency;
+};
+
+/**
+ * @brief Radio parameters of a network, applied when the whole network is read
+ *
+ */
+struct NetworkConfig {
+    double                  range;
+    double                  loss;
+    uint32_t                latency;
+    vector<LinkConfig>      links;
+};
+
+static void handleSignal(int)
+{
+    stop_simulation = true;
+}
+
+static void printUsage(const char *name)
+{
+    cerr << "Usage:" << endl
+         << name << " [-d seconds] [-s seed] [-q rx_queue] [-b bs_command | -v [-j threads]] [-n] topology_file" << endl
+         << "  -d  simulation duration, default " << SIM_DEFAULT_DURATION << " s" << endl
+         << "  -s  seed of losses and node generators" << endl
+         << "  -q  receive queue of nodes, 1 behaves like RF12, default " << SIM_RX_QUEUE << endl
+         << "  -b  BS started for every network as 'bs_command device_path key_file'" << endl
+         << "  -v  virtual time with built-in BS, results depend only on the seed and the topology" << endl
+         << "  -j  worker threads of virtual time, networks are shared out between them, default 1" << endl
+         << "  -n  print only the summary, not every node" << endl;
+}
+
+/**
+ * @brief Place nodes of a network
+ *
+ * @param sim       Simulator
+ * @param network   Network index
+ * @param layout    line, grid or random
+ * @param input     Rest of the line - spacing for line and grid, width and height for random
+ * @param seed      Seed of random layout
+ * @return true     Success
+ * @return false    Unknown layout
+ */
+static bool applyLayout(Simulator &sim, uint32_t network, const string &layout, istringstream &input, uint32_t seed)
+{
+    vector<SimNode*> nodes;
+    for(const unique_ptr<SimNode> &node: sim.getNodes()){
+        if(node->network == network){
+            nodes.push_back(node.get());
+        }
+    }
+
+    if(layout == "line" || layout == "grid"){
+        double spacing = 1;
+        input >> spacing;
+
+        uint32_t columns = layout == "line" ? nodes.size() : (uint32_t) ceil(sqrt(nodes.size()));
+        for(uint32_t i = 0; i < nodes.size(); i++){
+            nodes[i]->x = (i % columns) * spacing;
+            nodes[i]->y = (i / columns) * spacing;
+        }
+        return true;
+    }
+
+    if(layout == "random"){
+        double width = 1;
+        double height = 1;
+        input >> width >> height;
+
+        // BS stays in the corner, nodes are spread over the area
+        srand(seed ^ (network * 7919));
+        for(uint32_t i = 1; i < nodes.size(); i++){
+            nodes[i]->x = width * rand() / RAND_MAX;
+            nodes[i]->y = height * rand() / RAND_MAX;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Connect radios of the last group of networks and set their explicit links
+ *
+ * @param sim       Simulator
+ * @param first     Index of the first network of the group
+ * @param last      Index after the last network of the group
+ * @param config    Radio parameters
+ */
+static void finishNetworks(Simulator &sim, uint32_t first, uint32_t last, NetworkConfig &config)
+{
+    for(uint32_t network = first; network < last; network++){
+        sim.connect(network, config.range, config.loss, config.latency);
+
+        for(const LinkConfig &link: config.links){
+            if(!sim.setLink(network, link.a, link.b, link.loss, link.latency)){
+                cerr << "Link " << (int) link.a << " - " << (int) link.b << " has no such node" << endl;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Load topology file, 'network key_file count' adds count copies of a network and the following lines apply to
+ * all of them
+ *
+ * @param sim       Simulator
+ * @param path      Topology file
+ * @param seed      Seed of random layouts
+ * @return true     Success
+ * @return false    Failure
+ */
+static bool loadTopology(Simulator &sim, const string &path, uint32_t seed)
+{
+    ifstream file(path);
+    if(!file.is_open()){
+        cerr << "Failed to open topology file " << path << endl;
+        return false;
+    }
+
+    NetworkConfig config = { SIM_DEFAULT_RANGE, SIM_DEFAULT_LOSS, SIM_DEFAULT_LATENCY, {} };
+    int32_t network = -1;   // first network of the group
+    uint32_t count = 0;     // networks in the group
+    string line;
+    uint32_t line_num = 0;
+
+    while(getline(file, line)){
+        line_num++;
+
+        istringstream input(line.substr(0, line.find('#')));
+        string command;
+        if(!(input >> command)){
+            continue;
+        }
+
+        if(command == "network"){
+            string key_file;
+            uint32_t copies = 1;
+            input >> key_file;
+            if(!(input >> copies)){
+                copies = 1;
+            }
+            if(!copies){
+                cerr << path << ":" << line_num << ": invalid line '" << line << "'" << endl;
+                return false;
+            }
+
+            if(network >= 0){
+                finishNetworks(sim, network, network + count, config);
+            }
+            network = sim.addNetwork(key_file);
+            for(count = 1; count < copies; count++){
+                sim.addNetwork(key_file);
+            }
+            config = { SIM_DEFAULT_RANGE, SIM_DEFAULT_LOSS, SIM_DEFAULT_LATENCY, {} };
+            continue;
+        }
+
+        if(network < 0){
+            cerr << path << ":" << line_num << ": 'network' has to come first" << endl;
+            return false;
+        }
+
+        bool valid = true;
+        if(command == "range"){
+            valid = (bool) (input >> config.range);
+        } else if(command == "loss"){
+            valid = (bool) (input >> config.loss);
+        } else if(command == "latency"){
+            valid = (bool) (input >> config.latency);
+        } else if(command == "layout"){
+            string layout;
+            valid = (bool) (input >> layout);
+            streampos arguments = input.tellg();
+            for(uint32_t i = 0; valid && i < count; i++){
+                input.clear();
+                input.seekg(arguments);
+                valid = applyLayout(sim, network + i, layout, input, seed);
+            }
+        } else if(command == "node"){
+            int id;
+            double x;
+            double y;
+            valid = (bool) (input >> id >> x >> y);
+            for(uint32_t i = 0; valid && i < count; i++){
+                SimNode *node = sim.getNode(network + i, id);
+                if((valid = node != NULL)){
+                    node->x = x;
+                    node->y = y;
+                }
+            }
+        } else if(command == "link"){
+            int a;
+            int b;
+            LinkConfig link;
+            link.latency = config.latency;
+            valid = (bool) (input >> a >> b >> link.loss);
+            input >> link.latency;
+            link.a = a;
+            link.b = b;
+            config.links.push_back(link);
+        } else {
+            valid = false;
+        }
+
+        if(!valid){
+            cerr << path << ":" << line_num << ": invalid line '" << line << "'" << endl;
+            return false;
+        }
+    }
+
+    if(network < 0){
+        cerr << "No network in " << path << endl;
+        return false;
+    }
+    finishNetworks(sim, network, network + count, config);
+
+    return true;
+}
+
+/**
+ * @brief Add a value to FNV-1a hash
+ *
+ * @param hash      Hash
+ * @param value     Value
+ */
+static void hashValue(uint64_t *hash, uint64_t value)
+{
+    for(int i = 0; i < 8; i++){
+        *hash ^= (value >> (i * 8)) & 0xFF;
+        *hash *= 0x100000001B3ULL;
+    }
+}
+
+/**
+ * @brief Print statistics of all nodes and the medium
+ *
+ * @param sim       Simulator
+ * @param summary   Print only the summary
+ * @param seconds   Wall-clock time of the simulation
+ */
+static void printStats(Simulator &sim, bool summary, double seconds)
+{
+    uint32_t joined = 0;
+    uint32_t nodes = 0;
+    uint64_t app_sent = 0;
+    uint64_t app_failed = 0;
+    uint64_t digest = 0xCBF29CE484222325ULL;
+
+    if(!summary){
+        printf("net node parent dist  etx beacons conv_ms repairs  sent failed fwd fwd_dups bcasts utesla_dups floods supp tx rx overruns bs_rcvd\n");
+    }
+    for(const unique_ptr<SimNode> &node: sim.getNodes()){
+        if(node->id == BS_NODE_ID){
+            continue;
+        }
+
+        const SimNodeStats_t &s = node->stats;
+        if(!summary){
+            printf("%3u %4u %6u %4u %4u %7u %7u %7u %5u %6u %3u %8u %6u %11u %6u %4u %u %u %u %u\n",
+                   node->network, node->id, s.parent, s.distance, s.etx, s.beacons, s.convergence_time, s.repairs,
+                   s.app_sent, s.app_failed, s.forwarded, s.forward_dups, s.broadcasts, s.utesla_dups, s.floods_sent,
+                   s.floods_suppressed, node->packets_sent, node->packets_received, node->overruns, node->bs_frames);
+        }
+
+        // identical runs give identical digests
+        const uint64_t values[] = { node->network, node->id, s.ctp_result, s.parent, s.distance, s.etx, s.beacons,
+                                    s.convergence_time, s.repairs, s.app_sent, s.app_failed, s.forwarded,
+                                    s.forward_dups, s.broadcasts, s.utesla_dups, s.floods_sent, s.floods_suppressed,
+                                    node->packets_sent, node->packets_received, node->overruns, node->bs_frames };
+        for(uint64_t value: values){
+            hashValue(&digest, value);
+        }
+
+        nodes++;
+        joined += s.ctp_result == SUCCESS;
+        app_sent += s.app_sent;
+        app_failed += s.app_failed;
+    }
+
+    uint64_t frames = 0;
+    uint64_t reports = 0;
+    uint64_t report_repeats = 0;
+    for(SimNetwork &network: sim.getNetworks()){
+        frames += network.frames;
+        reports += network.reports;
+        report_repeats += network.report_repeats;
+    }
+
+    const SimMediumStats &medium = sim.getStats();
+    hashValue(&digest, medium.transmissions);
+    hashValue(&digest, medium.bytes);
+    hashValue(&digest, medium.deliveries);
+    hashValue(&digest, medium.losses);
+    hashValue(&digest, medium.overruns);
+
+    printf("\nnodes in CTP tree: %u/%u, application messages: %llu sent, %llu not acknowledged\n", joined, nodes,
+           (unsigned long long) app_sent, (unsigned long long) app_failed);
+    printf("BS: %llu frames received, %llu CTP reports, %llu repeated\n", (unsigned long long) frames, (unsigned long long) reports,
+           (unsigned long long) report_repeats);
+    printf("medium: %llu transmissions, %llu bytes, %llu deliveries, %llu losses, %llu overruns\n",
+           (unsigned long long) medium.transmissions, (unsigned long long) medium.bytes,
+           (unsigned long long) medium.deliveries, (unsigned long long) medium.losses,
+           (unsigned long long) medium.overruns);
+    printf("digest: %016llx\n", (unsigned long long) digest);
+    printf("run time: %.2f s, %.0f transmissions per second\n", seconds,
+           seconds > 0 ? medium.transmissions / seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t duration = SIM_DEFAULT_DURATION;
+    uint32_t seed = 1;
+    uint32_t rx_queue = SIM_RX_QUEUE;
+    string bs_command;
+    bool virtual_time = false;
+    bool summary = false;
+    uint32_t threads = 1;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:s:q:b:vj:nh")) != -1){
+        switch(opt){
+            case 'd':   duration = strtoul(optarg, NULL, 10);   break;
+            case 's':   seed = strtoul(optarg, NULL, 10);       break;
+            case 'q':   rx_queue = strtoul(optarg, NULL, 10);   break;
+            case 'b':   bs_command = optarg;                    break;
+            case 'v':   virtual_time = true;                    break;
+            case 'j':   threads = strtoul(optarg, NULL, 10);    break;
+            case 'n':   summary = true;                         break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    // BS hosts run in wall-clock time
+    if(optind != argc - 1 || (virtual_time && !bs_command.empty())){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    vector<pid_t> children;
+
+    try {
+        Simulator sim(seed, rx_queue, virtual_time, threads);
+        if(!loadTopology(sim, argv[optind], seed)){
+            return 2;
+        }
+
+        for(SimNetwork &network: sim.getNetworks()){
+            if(virtual_time){
+                break;
+            }
+            cout << "network " << network.key_file << ": BS device " << network.bridge->getPath() << endl;
+
+            if(bs_command.empty()){
+                continue;
+            }
+
+            pid_t pid = fork();
+            if(pid == 0){
+                string command = "exec " + bs_command + " " + network.bridge->getPath() + " " + network.key_file;
+                execl("/bin/sh", "sh", "-c", command.c_str(), (char*) NULL);
+                _exit(127);
+            }
+            if(pid > 0){
+                children.push_back(pid);
+            }
+        }
+        cout.flush();
+
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sim.run((uint64_t) duration * 1000, &stop_simulation);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        for(pid_t pid: children){
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+        }
+
+        printStats(sim, summary, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    } catch(runtime_error &ex){
+        cerr << ex.what() << endl;
+        for(pid_t pid: children){
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+        }
+        return 15;
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @brief Arduino core functions for node code running in the simulator
+ * 
+ * @file    Arduino.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "SimShim.h"
+
+#define HEX 16
+#define DEC 10
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+inline unsigned long millis()
+{
+    return simMillis();
+}
+
+inline void delay(unsigned long ms)
+{
+    simDelay(ms);
+}
+
+inline long random(long max)
+{
+    return max > 0 ? simRandom() % max : 0;
+}
+
+inline long random(long min, long max)
+{
+    return max > min ? min + random(max - min) : min;
+}
+
+inline void randomSeed(unsigned long seed)
+{
+    simRandomSeed(seed);
+}
+
+inline int analogRead(uint8_t)
+{
+    // floating pin
+    return simRandom() % 1024;
+}
+
+/**
+ * @brief Serial port of a node, output is discarded and nothing is ever received
+ * 
+ */
+class SimSerial {
+public:
+    void begin(long) {}
+    void flush() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t len) { return len; }
+    template<class T> size_t print(T) { return 0; }
+    template<class T> size_t print(T, int) { return 0; }
+    template<class T> size_t println(T) { return 0; }
+    template<class T> size_t println(T, int) { return 0; }
+    size_t println() { return 0; }
+};
+
+extern SimSerial Serial;
+
+#endif // SIM_ARDUINO_H
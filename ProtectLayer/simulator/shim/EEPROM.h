@@ -0,0 +1,14 @@
+/**
+ * @brief Arduino EEPROM library for node code running in the simulator, only avr/eeprom.h functions are used
+ * 
+ * @file    EEPROM.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include "avr/eeprom.h"
+
+#endif // SIM_EEPROM_H
@@ -0,0 +1,67 @@
+/**
+ * @brief RF12 driver for node code running in the simulator. Follows JeeLib semantics, packets go through
+ * the simulated radio medium.
+ * 
+ * @file    RF12.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIM_RF12_H
+#define SIM_RF12_H
+
+#include <stdint.h>
+
+#include "SimShim.h"
+
+#define RF12_433MHZ     1
+#define RF12_868MHZ     2
+#define RF12_915MHZ     3
+
+#define RF12_MAXDATA    SIM_RF12_MAXDATA
+
+#define RF12_HDR_CTL    0x80
+#define RF12_HDR_DST    0x40
+#define RF12_HDR_ACK    0x20
+#define RF12_HDR_MASK   0x1F
+
+// receive buffer of the running node
+#define rf12_hdr        (simRadio()->hdr)
+#define rf12_len        (simRadio()->len)
+#define rf12_data       (simRadio()->data)
+#define rf12_crc        (simRadio()->crc)
+
+#define RF12_WANTS_ACK  ((rf12_hdr & RF12_HDR_ACK) && !(rf12_hdr & RF12_HDR_CTL))
+#define RF12_ACK_REPLY  (rf12_hdr & RF12_HDR_DST ? RF12_HDR_CTL : RF12_HDR_CTL | RF12_HDR_DST | (rf12_hdr & RF12_HDR_MASK))
+
+// the simulator decides which nodes hear each other, frequency and group are ignored
+inline uint8_t rf12_initialize(uint8_t id, uint8_t, uint8_t = 0xD4, uint16_t = 1600)
+{
+    return id;
+}
+
+inline uint8_t rf12_recvDone()
+{
+    return simReceive();
+}
+
+inline uint8_t rf12_canSend()
+{
+    return 1;
+}
+
+inline void rf12_sendStart(uint8_t hdr, const void *ptr, uint8_t len)
+{
+    simSend(hdr, ptr, len);
+}
+
+inline void rf12_sendNow(uint8_t hdr, const void *ptr, uint8_t len)
+{
+    simSend(hdr, ptr, len);
+}
+
+inline void rf12_sendWait(uint8_t)
+{
+}
+
+#endif // SIM_RF12_H
@@ -0,0 +1,47 @@
+/**
+ * @brief AVR EEPROM functions for node code running in the simulator, each node has its own EEPROM
+ * 
+ * @file    eeprom.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SimShim.h"
+
+inline uint8_t eeprom_read_byte(const uint8_t *address)
+{
+    return simEeprom()[(uintptr_t) address % SIM_EEPROM_SIZE];
+}
+
+inline void eeprom_write_byte(uint8_t *address, uint8_t value)
+{
+    simEeprom()[(uintptr_t) address % SIM_EEPROM_SIZE] = value;
+}
+
+inline void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+    eeprom_write_byte(address, value);
+}
+
+inline void eeprom_read_block(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, simEeprom() + (uintptr_t) src, len);
+}
+
+inline void eeprom_write_block(const void *src, void *dst, size_t len)
+{
+    memcpy(simEeprom() + (uintptr_t) dst, src, len);
+}
+
+inline void eeprom_update_block(const void *src, void *dst, size_t len)
+{
+    eeprom_write_block(src, dst, len);
+}
+
+#endif // SIM_AVR_EEPROM_H
@@ -0,0 +1,30 @@
+/**
+ * @brief AVR sleep functions for node code running in the simulator, sleeping node never wakes up
+ * 
+ * @file    sleep.h
+ * @author  Martin Sarkany
+ * @date    10/2026
+ */
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#include "SimShim.h"
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_PWR_DOWN     2
+
+inline void set_sleep_mode(uint8_t)
+{
+}
+
+inline void sleep_enable()
+{
+}
+
+inline void sleep_mode()
+{
+    simHalt();
+}
+
+#endif // SIM_AVR_SLEEP_H
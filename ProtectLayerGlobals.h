@@ -21,6 +21,28 @@
 #define CTP_DURATION_MS         10000   // CTP establishement duration
 #define CTP_REBROADCASTS_NUM    5       // number of distance rebroadcasts from BS
 #define CTP_REBROADCASTS_DELAY  500     // delay between rebroadcasts
+#define CTP_TRICKLE_IMIN        125     // shortest interval of node's distance beacons
+#define CTP_TRICKLE_DOUBLINGS   4       // longest interval is 2 s
+#define CTP_TRICKLE_K           2       // beacon is suppressed after hearing 2 beacons with the same distance
+#define CTP_CANDIDATES          4       // neighbors remembered as possible parents
+#define CTP_ACK_TIMEOUT         30      // time to wait for parent's acknowledgement
+#define CTP_SEND_RETRIES        3       // unacknowledged attempts before the parent is considered lost
+#define CTP_RETRY_BACKOFF       40      // longest random delay before a retry, siblings do not retry in lockstep
+#define CTP_QUALITY_INIT        128     // link quality of a newly heard neighbor, 0-255
+#define CTP_QUALITY_MIN         32      // neighbors with worse link quality are not used as parents
+#define CTP_MAX_MISSED_BEACONS  16      // longer gaps in neighbor's beacon sequence numbers are not counted as losses
+#define CTP_ETX_UNIT            10      // route cost is in tenths of expected transmissions
+#define CTP_ETX_HYSTERESIS      15      // parent is replaced only by a route cheaper by 1.5 transmissions
+#define CTP_INVALID_ETX         0xFFFF  // no route
+
+// MSG_CTP: [distance][route cost, 2 bytes little-endian], seq in header is the beacon sequence number
+#define CTP_BEACON_SIZE         (SPHEADER_SIZE + 3)
+
+// Trickle suppression of uTESLA floods - a node rebroadcasts unless it heard the message from a neighbor first
+#define TRICKLE_FLOOD_IMIN      100     // first interval of a flood rebroadcast
+#define TRICKLE_FLOOD_DOUBLINGS 1       // the message is advertised in 2 intervals
+#define TRICKLE_FLOOD_K         1       // a single copy heard suppresses the rebroadcast
+#define TRICKLE_FLOOD_SLOTS     2       // floods scheduled at once, each takes MAX_MSG_SIZE bytes of RAM
 
 // neighbor-discovery-related constants
 #define DISC_REBROADCASRS_NUM   3       // number of neighbor discovery announcements from node
@@ -30,15 +52,38 @@
 
 #define UTESLA_KEY_VALID_PERIOD 10000   // time that the uTESLA key is valid
 
+// two-level uTESLA - keys of a long high-level chain authenticate commitments to short low-level chains, one for each
+// high-level round, messages are authenticated by low-level keys valid for UTESLA_KEY_VALID_PERIOD
+// #define UTESLA_TWO_LEVEL        1
+#define UTESLA_LOW_ROUNDS       10      // low-level rounds in a high-level round
+#define UTESLA_HIGH_PERIOD      ((uint32_t) UTESLA_LOW_ROUNDS * UTESLA_KEY_VALID_PERIOD)   // high-level round duration
+#define UTESLA_MAX_HIGH_SYNC    64      // high-level rounds a node may miss and still synchronize
+#define UTESLA_LOW_SEED_LABEL   0x4C    // input of the MAC deriving a low-level chain from a high-level key
+
+// two-level uTESLA payloads, indices are little-endian
+// MSG_UTESLA_CDM: [high-level index][commitment of the next low-level chain][MAC by the high-level key][previous high-level key]
+// MSG_UTESLA_KEY: [high-level index][low-level index][low-level key]
+#define UTESLA_INDEX_SIZE       4       // size of the high-level index in messages
+
 #define DEFAULT_REQ_ACK         0       // 1 if acknowledgements are required, 0 otherwise
 
 #define NODE_RECV_TIMEOUT_MS    100     // timeout for receive() ProtectLayer::receuive() method
+#define BS_RECV_TIMEOUT_MS      3000    // timeout for BS's ProtectLayer::receive() method
+
+// BS host sends messages to its slave as LINK_MSG records (see SerialLink.h), slave replies with LINK_STATUS when it
+// passes the message to the radio. Host keeps up to SLAVE_QUEUE_LEN messages in flight, the slave buffers them.
+#define SLAVE_QUEUE_LEN         4       // messages buffered by BS slave device
 
 // ID and distance constants
 #define BS_NODE_ID              1       // base station node ID
 #define MIN_NODE_ID             2       // lowest ID for a regular node
 #define INVALID_DISTANCE        50      // invalid distance indicator
 
+// IDs of keys that do not belong to any node, used to cache expanded keys (node keys use node's ID)
+#define KEY_ID_HASH             0       // all-zero key of AES-based hash
+#define KEY_ID_UTESLA           30      // uTESLA hash chain elements and other keys without ID
+#define KEY_ID_TEMP             31      // short-lived keys, e.g. intermediate AES-based hash values
+
 // TODO! enum or defines for all return values
 #define FORWARD                 5       // return value for ProtectLayer::receuive() method
 #define HANDSHAKE               10      // return value for ProtectLayer::receuive() method
@@ -60,10 +105,11 @@
 typedef uint8_t node_id_t;              // node ID
 typedef uint8_t msg_type_t;             // message type
 
-// TODO maybe add index of a current node so it does not need to be reread from EEPROM in case it's still the same
 typedef struct _key {
     uint8_t   keyValue[AES_KEY_SIZE];   // key
     uint32_t  *counter;                 // key counter
+    uint8_t   keyID;                    // node's ID or one of KEY_ID_* - identifies cached expanded key
+    uint8_t   *expKey;                  // precomputed expanded key, NULL if it has to be taken from the cache
 } PL_key_t;
 
 /**
@@ -79,6 +125,8 @@ typedef enum _MSG_TYPE {
     MSG_UTESLA,                         // uTESLA broadcast message
     MSG_UTESLA_KEY,                     // uTESLA key announcement message
     MSG_DISC,                           // neighbor discovery message
+    MSG_UTESLA_CDM,                     // two-level uTESLA commitment distribution message
+    MSG_CTP_DONE,                       // node's report of CTP convergence, forwarded to BS
     MSG_COUNT                           //  number of message types
 } MSG_TYPE;
 
@@ -91,6 +139,7 @@ typedef struct SPHeader {
     msg_type_t  msgType;                // type of message
     uint8_t     sender;                 // sender ID
     uint8_t     receiver;               // receiver ID
+    uint8_t     seq;                    // sender's key counter hint set by Crypto (0 if unprotected), BS sequence number in uTESLA broadcasts
 } SPHeader_t;
 
 #pragma pack(pop)
@@ -112,6 +161,23 @@ public:
     virtual bool encrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block) = 0;
 
     virtual bool decrypt(const uint8_t *in_block, uint8_t *expkey, uint8_t *out_block) = 0;
+
+    /**
+     * @brief Encrypt two independent blocks with the same key. Implementations able to process
+     * both blocks at once (e.g. pipelined AES-NI) override it, others just encrypt them one after another.
+     *
+     * @param in_block1     First input block
+     * @param in_block2     Second input block
+     * @param expkey        Expanded key
+     * @param out_block1    First output block, can be the same as in_block1
+     * @param out_block2    Second output block, can be the same as in_block2
+     * @return true         Success
+     * @return false        Failure
+     */
+    virtual bool encrypt2(const uint8_t *in_block1, const uint8_t *in_block2, uint8_t *expkey, uint8_t *out_block1, uint8_t *out_block2)
+    {
+        return encrypt(in_block1, expkey, out_block1) && encrypt(in_block2, expkey, out_block2);
+    }
 };
 
 /**
@@ -132,7 +198,7 @@ public:
  */
 class MAC {
 public:
-    virtual uint8_t macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac) = 0;  // TODO remove
+    virtual uint8_t macBuffer(const uint8_t* key, const uint8_t* buffer, uint8_t offset, uint8_t* pLen, uint8_t* mac, uint8_t key_id = KEY_ID_UTESLA) = 0;  // TODO remove
     virtual bool computeMAC(const uint8_t *key, const uint8_t key_size, const uint8_t *input, const uint16_t input_size, uint8_t *output, const uint16_t output_buffer_size) = 0;
     virtual uint8_t keySize() = 0;
     virtual uint8_t macSize() = 0;